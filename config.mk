@@ -46,5 +46,8 @@ CXXFLAGS += ${KENTINC} ${CXXDEBUG}
 
 BINDIR = ${ROOT}/bin
 OBJDIR = ${ROOT}/objs
+LIBDIR = ${ROOT}/lib
 gencode_backmap = ${BINDIR}/gencode-backmap
+libgencodebackmap = ${LIBDIR}/libgencodebackmap.a
+libgencodebackmap_so = ${LIBDIR}/libgencodebackmap.so
 gencodeAttrsStats = ${BINDIR}/gencodeAttrsStats
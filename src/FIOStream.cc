@@ -1,6 +1,7 @@
 #include "FIOStream.hh"
 #include "gzstream.hh"
 #include <unistd.h>
+#include <vector>
 
 // FIXME: drop file name of "-" convention
 
@@ -67,6 +68,20 @@ void FIOStream::close() {
     }
 }
 
+/**
+ * Read the rest of the file into a string.
+ */
+void FIOStream::readAll(string& text) {
+    static const size_t READ_SIZE = 1 << 20;
+    vector<char> buf(READ_SIZE);
+    while (read(&(buf[0]), buf.size()) or (gcount() > 0)) {
+        text.append(&(buf[0]), gcount());
+    }
+    if (bad()) {
+        throw ios_base::failure("I/O error on " + getFileName());
+    }
+}
+
 /**
  * Destructor.
  */
@@ -78,6 +78,9 @@ class FIOStream: public iostream {
         }
         return true;
     }
+
+    /** read the rest of the file into a string */
+    void readAll(string& text);
 };
 
 #endif
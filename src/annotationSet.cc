@@ -116,6 +116,7 @@ Feature* AnnotationSet::getFeatureByName(const string& name,
 FeatureVector AnnotationSet::findOverlappingFeatures(const string& seqid,
                                                      int start,
                                                      int end) {
+    std::lock_guard<std::mutex> lock(fLocationMapMutex);
     if (fLocationMap == NULL) {
         buildLocationMap();
     }
@@ -158,10 +159,31 @@ FeatureVector AnnotationSet::findOverlappingGenes(const Feature* gene,
 
 /* constructor, load gene and transcript objects from a GxF */
 AnnotationSet::AnnotationSet(const string& gxfFile,
+                             const GenomeSizeMap* genomeSizes,
+                             int numThreads):
+    fLocationMap(NULL),
+    fGenomeSizes(genomeSizes) {
+    if (numThreads > 1) {
+        FeatureVector genes = loadGxfGenes(gxfFile, numThreads);
+        for (size_t i = 0; i < genes.size(); i++) {
+            addGene(genes[i]);
+        }
+    } else {
+        FeatureParser parser(gxfFile);
+        Feature* gene;
+        while ((gene = parser.nextGene()) != NULL) {
+            addGene(gene);
+        }
+    }
+}
+
+/* constructor, load gene and transcript objects from a GxF stream */
+AnnotationSet::AnnotationSet(istream& gxfIn,
+                             GxfFormat gxfFormat,
                              const GenomeSizeMap* genomeSizes):
     fLocationMap(NULL),
     fGenomeSizes(genomeSizes) {
-    FeatureParser parser(gxfFile);
+    FeatureParser parser(gxfIn, gxfFormat);
     Feature* gene;
     while ((gene = parser.nextGene()) != NULL) {
         addGene(gene);
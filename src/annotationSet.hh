@@ -7,11 +7,12 @@
 
 #include "gxfRecord.hh"
 #include <map>
+#include <mutex>
 #include <stdexcept>
 #include "feature.hh"
+#include "gxfIO.hh"
 struct genomeRangeTree;
 class GenomeSizeMap;
-class GxfWriter;
 
 /*
  * Locations in target genome of old transcripts, by base id
@@ -42,6 +43,7 @@ class AnnotationSet {
 
     // map of location to feature
     struct genomeRangeTree* fLocationMap;
+    std::mutex fLocationMapMutex;  // range tree queries modify the tree
 
     // mapped sequence ids that have been written
     StringSet fSeqRegionsWritten;
@@ -81,8 +83,15 @@ class AnnotationSet {
                        GxfWriter& gxfFh) const;
 
     public:
-    /* constructor, load gene and transcript objects from a GxF */
+    /* constructor, load gene and transcript objects from a GxF.  If
+     * numThreads is greater than one, the file is parsed in parallel. */
     AnnotationSet(const string& gxfFile,
+                  const GenomeSizeMap* genomeSizes=NULL,
+                  int numThreads=1);
+
+    /* constructor, load gene and transcript objects from a GxF stream */
+    AnnotationSet(istream& gxfIn,
+                  GxfFormat gxfFormat,
                   const GenomeSizeMap* genomeSizes=NULL);
 
     /* constructor, empty set */
@@ -107,7 +116,8 @@ class AnnotationSet {
     Feature* getFeatureByName(const string& name,
                               const string& seqIdForParCheck) const;
 
-    /* find overlapping features */
+    /* find overlapping features.  This and findOverlappingGenes may be
+     * called from multiple threads, but not while genes are being added. */
     FeatureVector findOverlappingFeatures(const string& seqid,
                                           int start,
                                           int end);
@@ -0,0 +1,172 @@
+/*
+ * Output streams that are written by a dedicated thread.
+ */
+#include "asyncOutput.hh"
+#include <stdexcept>
+
+/* constructor, starts writer thread */
+AsyncStreamBuf::AsyncStreamBuf(ostream& out,
+                               size_t chunkSize,
+                               size_t maxQueuedChunks):
+    fOut(out),
+    fChunkSize((chunkSize < 1) ? 1 : chunkSize),
+    fChunk(new string()),
+    fQueue(maxQueuedChunks),
+    fClosed(false) {
+    fChunk->reserve(fChunkSize);
+    fThread = std::thread(&AsyncStreamBuf::writeChunks, this);
+}
+
+/* destructor, closes if not already closed, ignoring errors */
+AsyncStreamBuf::~AsyncStreamBuf() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+/* Writer thread.  After an error, chunks are still removed from the queue
+ * so that the producer doesn't block. */
+void AsyncStreamBuf::writeChunks() {
+    string* chunk;
+    while (fQueue.pop(chunk)) {
+        if (fError == NULL) {
+            try {
+                fOut.write(chunk->data(), chunk->size());
+                if (fOut.fail()) {
+                    throw ios_base::failure("write of output stream failed");
+                }
+            } catch (...) {
+                fError = current_exception();
+            }
+        }
+        delete chunk;
+    }
+}
+
+/* pass the current chunk to the writer */
+void AsyncStreamBuf::queueChunk() {
+    if (fChunk->size() > 0) {
+        fQueue.push(fChunk);
+        fChunk = new string();
+        fChunk->reserve(fChunkSize);
+    }
+}
+
+/* add a character */
+AsyncStreamBuf::int_type AsyncStreamBuf::overflow(int_type ch) {
+    if (fClosed) {
+        return traits_type::eof();
+    }
+    if (ch != traits_type::eof()) {
+        fChunk->push_back(traits_type::to_char_type(ch));
+        if (fChunk->size() >= fChunkSize) {
+            queueChunk();
+        }
+    }
+    return traits_type::not_eof(ch);
+}
+
+/* add characters */
+streamsize AsyncStreamBuf::xsputn(const char* s,
+                                  streamsize n) {
+    if (fClosed) {
+        return 0;
+    }
+    fChunk->append(s, n);
+    if (fChunk->size() >= fChunkSize) {
+        queueChunk();
+    }
+    return n;
+}
+
+/* write remaining data, wait for the writer thread and flush the output
+ * stream. */
+void AsyncStreamBuf::close() {
+    if (fClosed) {
+        return;
+    }
+    fClosed = true;
+    queueChunk();
+    delete fChunk;
+    fChunk = NULL;
+    fQueue.close();
+    fThread.join();
+    if (fError != NULL) {
+        rethrow_exception(fError);
+    }
+    fOut.flush();
+}
+
+/* constructor, starts writer thread */
+AsyncMappingInfoWriter::AsyncMappingInfoWriter(MappingInfoWriter& writer,
+                                               size_t batchSize,
+                                               size_t maxQueuedBatches):
+    fWriter(writer),
+    fBatchSize((batchSize < 1) ? 1 : batchSize),
+    fBatch(new MappingInfoVector()),
+    fQueue(maxQueuedBatches),
+    fClosed(false) {
+    fThread = std::thread(&AsyncMappingInfoWriter::writeBatches, this);
+}
+
+/* destructor, closes if not already closed, ignoring errors */
+AsyncMappingInfoWriter::~AsyncMappingInfoWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+/* Writer thread.  After an error, batches are still removed from the queue
+ * so that the producer doesn't block. */
+void AsyncMappingInfoWriter::writeBatches() {
+    MappingInfoVector* batch;
+    while (fQueue.pop(batch)) {
+        if (fError == NULL) {
+            try {
+                for (size_t i = 0; i < batch->size(); i++) {
+                    fWriter.write((*batch)[i]);
+                }
+            } catch (...) {
+                fError = current_exception();
+            }
+        }
+        delete batch;
+    }
+}
+
+/* pass the current batch to the writer */
+void AsyncMappingInfoWriter::queueBatch() {
+    if (fBatch->size() > 0) {
+        fQueue.push(fBatch);
+        fBatch = new MappingInfoVector();
+    }
+}
+
+/* queue a record */
+void AsyncMappingInfoWriter::write(const MappingInfo& mappingInfo) {
+    if (fClosed) {
+        throw logic_error("AsyncMappingInfoWriter::write called after close");
+    }
+    fBatch->push_back(mappingInfo);
+    if (fBatch->size() >= fBatchSize) {
+        queueBatch();
+    }
+}
+
+/* write remaining records and wait for the writer thread */
+void AsyncMappingInfoWriter::close() {
+    if (fClosed) {
+        return;
+    }
+    fClosed = true;
+    queueBatch();
+    delete fBatch;
+    fBatch = NULL;
+    fQueue.close();
+    fThread.join();
+    if (fError != NULL) {
+        rethrow_exception(fError);
+    }
+}
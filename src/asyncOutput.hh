@@ -0,0 +1,172 @@
+/*
+ * Output streams that are written by a dedicated thread.
+ */
+#ifndef asyncOutput_hh
+#define asyncOutput_hh
+#include "mappingInfo.hh"
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+
+/*
+ * Queue with a maximum size between a producer and consumer thread.  Push
+ * blocks when the queue is full and pop blocks when it is empty.
+ */
+template<class T> class BoundedQueue {
+    private:
+    size_t fMaxSize;
+    deque<T> fEntries;
+    bool fClosed;
+    mutex fMutex;
+    condition_variable fNotFull;
+    condition_variable fNotEmpty;
+
+    public:
+    /* constructor */
+    BoundedQueue(size_t maxSize):
+        fMaxSize((maxSize < 1) ? 1 : maxSize),
+        fClosed(false) {
+    }
+
+    /* add an entry, waiting if the queue is full */
+    void push(const T& entry) {
+        unique_lock<mutex> lock(fMutex);
+        fNotFull.wait(lock, [this]() {return fEntries.size() < fMaxSize;});
+        fEntries.push_back(entry);
+        fNotEmpty.notify_one();
+    }
+
+    /* get the next entry, waiting if the queue is empty.  Returns false
+     * when the queue is closed and all entries have been removed. */
+    bool pop(T& entry) {
+        unique_lock<mutex> lock(fMutex);
+        fNotEmpty.wait(lock, [this]() {return fClosed or (fEntries.size() > 0);});
+        if (fEntries.size() == 0) {
+            return false;
+        }
+        entry = fEntries.front();
+        fEntries.pop_front();
+        fNotFull.notify_one();
+        return true;
+    }
+
+    /* indicate that no more entries will be added */
+    void close() {
+        lock_guard<mutex> lock(fMutex);
+        fClosed = true;
+        fNotEmpty.notify_all();
+    }
+};
+
+/*
+ * Stream buffer that collects output into chunks that are written to
+ * another stream by a writer thread.  Compression of gzipped output and the
+ * write system calls happen on the writer thread.  Flushing the stream
+ * doesn't pass a partial chunk to the writer, so line-by-line use of endl
+ * is not a performance problem; all output is written on close.
+ */
+class AsyncStreamBuf: public streambuf {
+    private:
+    ostream& fOut;
+    size_t fChunkSize;
+    string* fChunk;
+    BoundedQueue<string*> fQueue;
+    std::thread fThread;
+    exception_ptr fError;
+    bool fClosed;
+
+    void writeChunks();
+    void queueChunk();
+
+    protected:
+    virtual int_type overflow(int_type ch);
+    virtual streamsize xsputn(const char* s,
+                              streamsize n);
+
+    public:
+    /* constructor, starts writer thread, output stream is not owned */
+    AsyncStreamBuf(ostream& out,
+                   size_t chunkSize,
+                   size_t maxQueuedChunks);
+
+    /* destructor, closes if not already closed, ignoring errors */
+    virtual ~AsyncStreamBuf();
+
+    /* write remaining data, wait for the writer thread and flush the output
+     * stream.  An exception from the writer is rethrown. */
+    void close();
+};
+
+/*
+ * Output stream that is written by a dedicated thread.
+ */
+class AsyncOStream: public ostream {
+    private:
+    AsyncStreamBuf fBuf;
+
+    public:
+    /* default size of chunks passed to the writer */
+    static const size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+    /* default maximum number of chunks queued for the writer */
+    static const size_t DEFAULT_MAX_QUEUED = 64;
+
+    /* constructor, output stream is not owned */
+    AsyncOStream(ostream& out,
+                 size_t chunkSize = DEFAULT_CHUNK_SIZE,
+                 size_t maxQueuedChunks = DEFAULT_MAX_QUEUED):
+        ostream(NULL),
+        fBuf(out, chunkSize, maxQueuedChunks) {
+        rdbuf(&fBuf);
+    }
+
+    /* write all output and wait for the writer */
+    void close() {
+        fBuf.close();
+    }
+};
+
+/*
+ * Mapping info writer that passes records to another writer on a
+ * dedicated thread, so formatting and encoding are not done by the
+ * mapping thread.  Records are queued in batches.
+ */
+class AsyncMappingInfoWriter: public MappingInfoWriter {
+    private:
+    MappingInfoWriter& fWriter;
+    size_t fBatchSize;
+    MappingInfoVector* fBatch;
+    BoundedQueue<MappingInfoVector*> fQueue;
+    std::thread fThread;
+    exception_ptr fError;
+    bool fClosed;
+
+    void writeBatches();
+    void queueBatch();
+
+    public:
+    /* default number of records in a batch */
+    static const size_t DEFAULT_BATCH_SIZE = 1024;
+
+    /* default maximum number of batches queued for the writer */
+    static const size_t DEFAULT_MAX_QUEUED = 64;
+
+    /* constructor, starts writer thread, writer is not owned */
+    AsyncMappingInfoWriter(MappingInfoWriter& writer,
+                           size_t batchSize = DEFAULT_BATCH_SIZE,
+                           size_t maxQueuedBatches = DEFAULT_MAX_QUEUED);
+
+    /* destructor, closes if not already closed, ignoring errors */
+    virtual ~AsyncMappingInfoWriter();
+
+    /* queue a record */
+    virtual void write(const MappingInfo& mappingInfo);
+
+    /* write remaining records and wait for the writer thread.  An
+     * exception from the writer is rethrown. */
+    void close();
+};
+
+#endif
@@ -30,6 +30,7 @@ BedMap::~BedMap() {
 bool BedMap::anyOverlap(const string& seqid,
                         int start,
                         int end) const {
-    struct range *overs = genomeRangeTreeAllOverlapping(fLocationMap, toCharStr(seqid), start, end);
-    return (overs != NULL);
+    // doesn't modify the tree, unlike genomeRangeTreeAllOverlapping, so it
+    // can be called from multiple threads
+    return genomeRangeTreeOverlaps(fLocationMap, toCharStr(seqid), start, end);
 }
@@ -21,7 +21,7 @@ class BedMap {
     /* destructor */
     ~BedMap();
 
-    /* check for overlap on a range */
+    /* check for overlap on a range, may be called from multiple threads */
     bool anyOverlap(const string& seqid,
                     int start,
                     int end) const;
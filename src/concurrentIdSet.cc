@@ -0,0 +1,42 @@
+/*
+ * Set of ids and names that can be used from multiple threads.
+ */
+#include "concurrentIdSet.hh"
+#include <string.h>
+
+/* find a string in a shard, which must be locked */
+const string* ConcurrentIdSet::find(Shard& shard,
+                                    HashVal hv,
+                                    const char* str,
+                                    size_t len) {
+    pair<unordered_multimap<HashVal, string>::const_iterator,
+         unordered_multimap<HashVal, string>::const_iterator> range = shard.entries.equal_range(hv);
+    for (unordered_multimap<HashVal, string>::const_iterator it = range.first; it != range.second; it++) {
+        if ((it->second.size() == len) and (memcmp(it->second.c_str(), str, len) == 0)) {
+            return &(it->second);
+        }
+    }
+    return NULL;
+}
+
+/* add a string if it is not in the set, returning the stored string */
+const string* ConcurrentIdSet::intern(const char* str,
+                                      size_t len) {
+    HashVal hv = hashBytes(str, len);
+    Shard& shard = getShard(hv);
+    lock_guard<mutex> lock(shard.entriesMutex);
+    const string* entry = find(shard, hv, str, len);
+    if (entry == NULL) {
+        entry = &(shard.entries.insert(make_pair(hv, string(str, len)))->second);
+    }
+    return entry;
+}
+
+/* check if a string is in the set */
+bool ConcurrentIdSet::contains(const char* str,
+                               size_t len) const {
+    HashVal hv = hashBytes(str, len);
+    Shard& shard = getShard(hv);
+    lock_guard<mutex> lock(shard.entriesMutex);
+    return find(shard, hv, str, len) != NULL;
+}
@@ -0,0 +1,72 @@
+/*
+ * Set of ids and names that can be used from multiple threads.
+ */
+#ifndef concurrentIdSet_hh
+#define concurrentIdSet_hh
+#include "hashOps.hh"
+#include <string>
+#include <unordered_map>
+#include <mutex>
+using namespace std;
+
+/*
+ * Set of gene and transcript ids and names.  Ids are usually stored and
+ * looked up as base ids, with the version removed, which is done without
+ * allocating a substring.  Entries are kept in shards selected by the hash of
+ * the string, each with its own lock, so inserts and lookups from multiple
+ * threads don't contend.  Each string is stored once; the returned handles
+ * remain valid for the life of the set.
+ */
+class ConcurrentIdSet {
+    private:
+    static const int NUM_SHARDS = 64;
+
+    /* strings indexed by hash */
+    class Shard {
+        public:
+        unordered_multimap<HashVal, string> entries;
+        mutex entriesMutex;
+    };
+    Shard fShards[NUM_SHARDS];
+
+    /* length of an id without the version */
+    static size_t baseIdLength(const string& id) {
+        size_t idot = id.find_last_of('.');
+        return (idot == string::npos) ? id.size() : idot;
+    }
+
+    Shard& getShard(HashVal hv) const {
+        return const_cast<Shard&>(fShards[hv % NUM_SHARDS]);
+    }
+    static const string* find(Shard& shard,
+                              HashVal hv,
+                              const char* str,
+                              size_t len);
+    const string* intern(const char* str,
+                         size_t len);
+    bool contains(const char* str,
+                  size_t len) const;
+
+    public:
+    /* add an id or name as is, returning the stored string */
+    const string* insert(const string& id) {
+        return intern(id.c_str(), id.size());
+    }
+
+    /* add an id with the version removed, returning the stored string */
+    const string* insertBaseId(const string& id) {
+        return intern(id.c_str(), baseIdLength(id));
+    }
+
+    /* check if an id or name is in the set */
+    bool contains(const string& id) const {
+        return contains(id.c_str(), id.size());
+    }
+
+    /* check if an id with the version removed is in the set */
+    bool containsBaseId(const string& id) const {
+        return contains(id.c_str(), baseIdLength(id));
+    }
+};
+
+#endif
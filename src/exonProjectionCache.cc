@@ -0,0 +1,49 @@
+/*
+ * Cache of the projections of exon blocks through mapping alignments.
+ */
+#include "exonProjectionCache.hh"
+#include "hashOps.hh"
+
+/* hash function for key */
+size_t ExonProjectionCache::KeyHash::operator()(const Key& key) const {
+    HashVal hv = hashInt(key.mapAlnId);
+    hv = hashInt(key.tStart, hv);
+    hv = hashInt(key.size, hv);
+    return hashMix(hashInt(key.rcInPsl, hv));
+}
+
+/* look up the projection of an input block */
+bool ExonProjectionCache::get(unsigned mapAlnId,
+                              bool rcInPsl,
+                              unsigned qStart,
+                              unsigned tStart,
+                              unsigned size,
+                              PslProjector::BlockVector& blocks) const {
+    Key key = {mapAlnId, tStart, size, rcInPsl};
+    unordered_map<Key, Entry, KeyHash>::const_iterator it = fEntries.find(key);
+    if (it == fEntries.end()) {
+        return false;
+    }
+    const Entry& entry = it->second;
+    for (unsigned i = entry.firstBlock; i < entry.firstBlock + entry.blockCount; i++) {
+        const PslProjector::Block& block = fBlocks[i];
+        blocks.push_back(PslProjector::Block(qStart + block.qStart, block.tStart, block.size));
+    }
+    return true;
+}
+
+/* save the projection of an input block */
+void ExonProjectionCache::add(unsigned mapAlnId,
+                              bool rcInPsl,
+                              unsigned qStart,
+                              unsigned tStart,
+                              unsigned size,
+                              const PslProjector::BlockVector& blocks,
+                              size_t firstBlock) {
+    Key key = {mapAlnId, tStart, size, rcInPsl};
+    Entry entry = {unsigned(fBlocks.size()), unsigned(blocks.size() - firstBlock)};
+    for (size_t i = firstBlock; i < blocks.size(); i++) {
+        fBlocks.push_back(PslProjector::Block(blocks[i].qStart - qStart, blocks[i].tStart, blocks[i].size));
+    }
+    fEntries[key] = entry;
+}
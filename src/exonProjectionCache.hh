@@ -0,0 +1,86 @@
+/*
+ * Cache of the projections of exon blocks through mapping alignments.
+ */
+#ifndef exonProjectionCache_hh
+#define exonProjectionCache_hh
+#include <unordered_map>
+#include "pslProjector.hh"
+using namespace std;
+
+/*
+ * Memoizes the projection of single input blocks through the mapping
+ * alignments of one TransMap.  The alternative transcripts of a gene share
+ * most of their exons, so the projection of a shared exon is computed once
+ * and the blocks of each transcript's exons PSL are assembled from the
+ * cache.  Entries are keyed by the mapping alignment, the strand the block
+ * is traversed on and its range on the mapping query, with the query
+ * coordinates of the projected blocks kept relative to the start of the
+ * input block, so they can be reused at a different position in another
+ * transcript.
+ *
+ * An object must only be used with a single TransMap, as alignments are
+ * identified by their index in its store.  It is not thread-safe; each
+ * thread mapping transcripts uses its own cache.
+ */
+class ExonProjectionCache {
+    private:
+    /* input block through a mapping alignment */
+    struct Key {
+        unsigned mapAlnId;
+        unsigned tStart;  // in the orientation of the mapping query
+        unsigned size;
+        bool rcInPsl;
+
+        bool operator==(const Key& other) const {
+            return (mapAlnId == other.mapAlnId) and (tStart == other.tStart)
+                and (size == other.size) and (rcInPsl == other.rcInPsl);
+        }
+    };
+
+    /* hash function for key */
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    /* range of projected blocks */
+    struct Entry {
+        unsigned firstBlock;  // index in fBlocks
+        unsigned blockCount;
+    };
+
+    unordered_map<Key, Entry, KeyHash> fEntries;
+    PslProjector::BlockVector fBlocks;  // qStart relative to the input block
+
+    public:
+    /* constructor */
+    ExonProjectionCache() {
+    }
+
+    /* Look up the projection of an input block, appending the projected
+     * blocks, offset to qStart, if found.  Returns false if the block
+     * hasn't been projected through the alignment. */
+    bool get(unsigned mapAlnId,
+             bool rcInPsl,
+             unsigned qStart,
+             unsigned tStart,
+             unsigned size,
+             PslProjector::BlockVector& blocks) const;
+
+    /* Save the projection of an input block, which is the blocks from
+     * firstBlock to the end of blocks.  A block that doesn't project at all
+     * is saved with no blocks. */
+    void add(unsigned mapAlnId,
+             bool rcInPsl,
+             unsigned qStart,
+             unsigned tStart,
+             unsigned size,
+             const PslProjector::BlockVector& blocks,
+             size_t firstBlock);
+
+    /* number of cached input blocks */
+    size_t size() const {
+        return fEntries.size();
+    }
+};
+
+#endif
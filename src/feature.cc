@@ -114,6 +114,46 @@ void Feature::rsetRemapStatusAttr() {
     }
 }
 
+/* recursively restore remap status, target status, and number of mappings
+ * from attributes */
+void Feature::rsetStatusFromAttrs() {
+    const AttrVal* attr = findAttr(ATTR_REMAP_STATUS);
+    fRemapStatus = (attr != NULL) ? strToRemapStatus(attr->getVal()) : REMAP_STATUS_NONE;
+    attr = findAttr(ATTR_REMAP_TARGET_STATUS);
+    fTargetStatus = (attr != NULL) ? strToTargetStatus(attr->getVal()) : TARGET_STATUS_NA;
+    attr = findAttr(ATTR_REMAP_NUM_MAPPINGS);
+    fNumMappings = (attr != NULL) ? stringToInt(attr->getVal()) : 0;
+    for (size_t i = 0; i < fChildren.size(); i++) {
+        fChildren[i]->rsetStatusFromAttrs();
+    }
+}
+
+/* content fingerprint of this feature and all descendants */
+HashVal Feature::fingerprint() const {
+    HashVal hv = hashString(fSeqid);
+    hv = hashString(fSource, hv);
+    hv = hashString(fType, hv);
+    hv = hashInt(fStart, hv);
+    hv = hashInt(fEnd, hv);
+    hv = hashString(fScore, hv);
+    hv = hashString(fStrand, hv);
+    hv = hashString(fPhase, hv);
+    hv = hashInt(fAttrs.size(), hv);
+    for (size_t i = 0; i < fAttrs.size(); i++) {
+        const AttrVal* attr = fAttrs[i];
+        hv = hashString(attr->getName(), hv);
+        hv = hashInt(attr->getVals().size(), hv);
+        for (size_t j = 0; j < attr->getVals().size(); j++) {
+            hv = hashString(attr->getVal(j), hv);
+        }
+    }
+    hv = hashInt(fChildren.size(), hv);
+    for (size_t i = 0; i < fChildren.size(); i++) {
+        hv = hashCombine(hv, fChildren[i]->fingerprint());
+    }
+    return hv;
+}
+
 /* recursively set the target status attribute */
 void Feature::rsetTargetStatusAttr() {
     if (isGeneOrTranscript()) {
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include "gxfRecord.hh"
 #include "remapStatus.hh"
+#include "hashOps.hh"
 
 
 
@@ -211,6 +212,15 @@ class Feature: public GxfFeature {
     /* recursively set the remap status attribute */
     void rsetRemapStatusAttr();
 
+    /* recursively restore remap status, target status, and number of
+     * mappings from attributes.  Used on features read from a previous
+     * mapping. */
+    void rsetStatusFromAttrs();
+
+    /* content fingerprint of this feature and all descendants.  All columns
+     * and attributes are included, in order. */
+    HashVal fingerprint() const;
+
     /* depth-first output */
     void write(ostream& fh) const;
 };
@@ -4,7 +4,10 @@
 #include "featureIO.hh"
 #include <iostream>
 #include <algorithm>
+#include <thread>
+#include <exception>
 #include "gxfIO.hh"
+#include "FIOStream.hh"
 
 
 /* Constructor */
@@ -13,6 +16,13 @@ FeatureParser::FeatureParser(const string& gxfFile):
     fNextGene(NULL) {
 }
 
+/* Constructor to read from a stream */
+FeatureParser::FeatureParser(istream& gxfIn,
+                             GxfFormat gxfFormat):
+    fGxfParser(GxfParser::factory(gxfIn, gxfFormat, featureFactory)),
+    fNextGene(NULL) {
+}
+
 /* Destructor */
 FeatureParser::~FeatureParser() {
     delete fGxfParser;
@@ -164,3 +174,188 @@ Feature* FeatureParser::nextGene() {
     return gene;;
 }
 
+
+/* stream buffer to read a range of characters in memory without copying */
+class CharRangeStreamBuf: public streambuf {
+    public:
+    CharRangeStreamBuf(const char* start,
+                       const char* end) {
+        char* buf = const_cast<char*>(start);
+        setg(buf, buf, buf + (end - start));
+    }
+};
+
+/* is the line starting at a position a gene feature? */
+static bool isGeneLine(const string& text,
+                       size_t lineStart,
+                       size_t lineEnd) {
+    if ((lineStart == lineEnd) or (text[lineStart] == '#')) {
+        return false;
+    }
+    // type is the third column
+    size_t typeStart = text.find('\t', lineStart);
+    if ((typeStart >= lineEnd) or ((typeStart = text.find('\t', typeStart + 1)) >= lineEnd)) {
+        return false;
+    }
+    typeStart++;
+    size_t typeEnd = text.find('\t', typeStart);
+    return (typeEnd < lineEnd)
+        and (text.compare(typeStart, typeEnd - typeStart, GxfFeature::GENE) == 0);
+}
+
+/* find the start of the first gene line at or after a position that is not
+ * in the middle of a line, or the end of the text */
+static size_t findGeneLineStart(const string& text,
+                                size_t pos) {
+    while (pos < text.size()) {
+        size_t lineEnd = text.find('\n', pos);
+        if (lineEnd == string::npos) {
+            lineEnd = text.size();
+        }
+        if (isGeneLine(text, pos, lineEnd)) {
+            return pos;
+        }
+        pos = lineEnd + 1;
+    }
+    return text.size();
+}
+
+/* split text into about numChunks ranges, each starting with a gene,
+ * except the first one.  Returns the offsets of the chunk boundaries,
+ * including zero and the end of the text. */
+static vector<size_t> splitAtGenes(const string& text,
+                                   int numChunks) {
+    vector<size_t> bounds;
+    bounds.push_back(0);
+    for (int iChunk = 1; iChunk < numChunks; iChunk++) {
+        size_t pos = (text.size() * iChunk) / numChunks;
+        if (pos <= bounds.back()) {
+            continue;
+        }
+        // move to the start of the next line
+        size_t lineEnd = text.find('\n', pos - 1);
+        if (lineEnd == string::npos) {
+            break;
+        }
+        size_t geneStart = findGeneLineStart(text, lineEnd + 1);
+        if (geneStart >= text.size()) {
+            break;
+        }
+        if (geneStart > bounds.back()) {
+            bounds.push_back(geneStart);
+        }
+    }
+    bounds.push_back(text.size());
+    return bounds;
+}
+
+/* parse the genes in a chunk of a GxF */
+static void parseGxfChunk(const char* start,
+                          const char* end,
+                          GxfFormat gxfFormat,
+                          FeatureVector& genes) {
+    CharRangeStreamBuf chunkBuf(start, end);
+    istream chunkIn(&chunkBuf);
+    FeatureParser parser(chunkIn, gxfFormat);
+    Feature* gene;
+    while ((gene = parser.nextGene()) != NULL) {
+        genes.push_back(gene);
+    }
+}
+
+/* Load all genes from a GxF file using multiple threads */
+FeatureVector loadGxfGenes(const string& gxfFile,
+                           int numThreads) {
+    GxfFormat gxfFormat = gxfFormatFromFileName(gxfFile);
+    string text;
+    FIOStream(gxfFile).readAll(text);
+    vector<size_t> bounds = splitAtGenes(text, (numThreads < 1) ? 1 : numThreads);
+    size_t numChunks = bounds.size() - 1;
+    vector<FeatureVector> chunkGenes(numChunks);
+    vector<exception_ptr> errors(numChunks);
+    vector<std::thread> threads;
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        const char* start = text.c_str() + bounds[iChunk];
+        const char* end = text.c_str() + bounds[iChunk + 1];
+        FeatureVector* genes = &chunkGenes[iChunk];
+        exception_ptr* error = &errors[iChunk];
+        threads.push_back(std::thread([=]() {
+            try {
+                parseGxfChunk(start, end, gxfFormat, *genes);
+            } catch (...) {
+                *error = current_exception();
+            }
+        }));
+    }
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        threads[iChunk].join();
+    }
+    exception_ptr error;
+    FeatureVector genes;
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        if ((error == NULL) and (errors[iChunk] != NULL)) {
+            error = errors[iChunk];
+        }
+        genes.insert(genes.end(), chunkGenes[iChunk].begin(), chunkGenes[iChunk].end());
+    }
+    if (error != NULL) {
+        for (size_t i = 0; i < genes.size(); i++) {
+            delete genes[i];
+        }
+        rethrow_exception(error);
+    }
+    return genes;
+}
+
+/* get a tab-separated column of a line, by zero-based index */
+static string getLineColumn(const string& text,
+                            size_t lineStart,
+                            size_t lineEnd,
+                            int iCol) {
+    size_t colStart = lineStart;
+    for (int i = 0; i < iCol; i++) {
+        size_t tabPos = text.find('\t', colStart);
+        if (tabPos >= lineEnd) {
+            throw invalid_argument("GxF record has too few columns: " + text.substr(lineStart, lineEnd - lineStart));
+        }
+        colStart = tabPos + 1;
+    }
+    size_t colEnd = min(text.find('\t', colStart), lineEnd);
+    return text.substr(colStart, colEnd - colStart);
+}
+
+/* parse a coordinate column of a gene line */
+static int parseGeneCoord(const string& text,
+                          size_t lineStart,
+                          size_t lineEnd,
+                          int iCol) {
+    bool isOk;
+    int coord = stringToInt(getLineColumn(text, lineStart, lineEnd, iCol), &isOk);
+    if (not isOk) {
+        throw invalid_argument("invalid coordinate in GxF record: " + text.substr(lineStart, lineEnd - lineStart));
+    }
+    return coord;
+}
+
+/* Get the locations of the gene records in a GxF file */
+vector<GxfGeneSpan> loadGxfGeneSpans(const string& gxfFile) {
+    string text;
+    FIOStream(gxfFile).readAll(text);
+    vector<GxfGeneSpan> geneSpans;
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == string::npos) {
+            lineEnd = text.size();
+        }
+        if (isGeneLine(text, lineStart, lineEnd)) {
+            GxfGeneSpan geneSpan;
+            geneSpan.seqid = getLineColumn(text, lineStart, lineEnd, 0);
+            geneSpan.start = parseGeneCoord(text, lineStart, lineEnd, 3);
+            geneSpan.end = parseGeneCoord(text, lineStart, lineEnd, 4);
+            geneSpans.push_back(geneSpan);
+        }
+        lineStart = lineEnd + 1;
+    }
+    return geneSpans;
+}
@@ -5,7 +5,7 @@
 #define featureIO_hh
 #include <assert.h>
 #include "feature.hh"
-class GxfParser;
+#include "gxfIO.hh"
 
 /**
  * Parser to group genes records together in a tree.
@@ -37,6 +37,10 @@ class FeatureParser {
     /* Constructor */
     FeatureParser(const string& gxfFile);
 
+    /* Constructor to read from a stream, which is not owned */
+    FeatureParser(istream& gxfIn,
+                  GxfFormat gxfFormat);
+
     /* Destructor */
     ~FeatureParser();
         
@@ -44,4 +48,22 @@ class FeatureParser {
     Feature* nextGene();
 };
 
+/* Load all genes from a GxF file, which maybe compressed, using multiple
+ * threads.  The file is read into memory and split into chunks that start
+ * at gene records, which are parsed in parallel.  Genes are returned in
+ * file order. */
+FeatureVector loadGxfGenes(const string& gxfFile,
+                           int numThreads);
+
+/* location of a gene record, in one-based, closed GxF coordinates */
+struct GxfGeneSpan {
+    string seqid;
+    int start;
+    int end;
+};
+
+/* Get the locations of the gene records in a GxF file, which maybe
+ * compressed.  Only the location columns of gene records are parsed. */
+vector<GxfGeneSpan> loadGxfGeneSpans(const string& gxfFile);
+
 #endif
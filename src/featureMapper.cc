@@ -7,6 +7,34 @@
 #include "frame.hh"
 #include <iostream>
 
+/*
+ * create the feature for a mapped region, given plus strand coordinates of
+ * the mapped and source regions.
+ */
+Feature* FeatureMapper::newMappedFeature(const GxfFeature* feature,
+                                         const Frame& frame,
+                                         const string& mappedSeqid,
+                                         int mappedTStart,
+                                         int mappedTEnd,
+                                         char mappedStrand,
+                                         int srcTStart,
+                                         int srcTEnd) {
+    // add mapped feature. but don't update id now
+    Feature* mappedFeature
+        = featureFactory(mappedSeqid,
+                         feature->getSource(), feature->getType(),
+                         mappedTStart+1, mappedTEnd, feature->getScore(),
+                         charToString(mappedStrand),
+                         frame.toPhaseStr(), feature->getAttrs());
+
+    // save original coordinates for this region
+    assert((feature->getStart()-1 <= srcTStart) and (srcTEnd <= feature->getEnd()));
+    string origLocation = feature->getSeqid() + ":" + feature->getStrand()
+        + ":" + toString(srcTStart+1) + "-" + toString(srcTEnd);
+    mappedFeature->getAttrs().add(AttrVal(REMAP_ORIGINAL_LOCATION_ATTR, origLocation));
+    return mappedFeature;
+}
+
 /* 
  * create an feature for a full or partially mapped feature.
  */
@@ -21,23 +49,11 @@ Feature* FeatureMapper::mkMappedFeature(const GxfFeature* feature,
     // GxF genomic coordinates are always plus strand
     int mappedTStart, mappedTEnd;
     mappedPslCursor.getTRangeStrand('+', length, &mappedTStart, &mappedTEnd);
-
-    // add mapped feature. but don't update id now
-    Feature* mappedFeature
-        = featureFactory(string(mappedPslCursor.getPsl()->tName),
-                         feature->getSource(), feature->getType(),
-                         mappedTStart+1, mappedTEnd, feature->getScore(),
-                         charToString(pslTStrand(mappedPslCursor.getPsl())),
-                         frame.toPhaseStr(), feature->getAttrs());
-
-    // save original coordinates for this region
     int srcTStart, srcTEnd;
     srcPslCursor.getTRangeStrand('+', length, &srcTStart, &srcTEnd);
-    assert((feature->getStart()-1 <= srcTStart) and (srcTEnd <= feature->getEnd()));
-    string origLocation = feature->getSeqid() + ":" + feature->getStrand()
-        + ":" + toString(srcTStart+1) + "-" + toString(srcTEnd);
-    mappedFeature->getAttrs().add(AttrVal(REMAP_ORIGINAL_LOCATION_ATTR, origLocation));
-    return mappedFeature;
+    return newMappedFeature(feature, frame, string(mappedPslCursor.getPsl()->tName),
+                            mappedTStart, mappedTEnd, pslTStrand(mappedPslCursor.getPsl()),
+                            srcTStart, srcTEnd);
 }
 
 /* 
@@ -116,6 +132,43 @@ void FeatureMapper::mapFeature(const GxfFeature* feature,
     assert(srcPslCursor.getQPos() == srcPslFeatureQEnd);
 }
 
+/* Map a feature contained in a single ungapped block of both the source and
+ * mapped alignments of its transcript.  The projection is then a constant
+ * offset, so this is done directly rather than converting the feature to
+ * a PSL and mapping it through the alignments, with the same result.
+ * Return false if the feature is not in a single block of both. */
+bool FeatureMapper::mapUngapped(const Feature* feature,
+                                struct psl* srcPsl,
+                                struct psl* mappedPsl,
+                                TransMappedFeature& transMappedFeature) {
+    if ((feature->getSeqid() != srcPsl->tName)
+        or (feature->getStrand() != charToString(pslTStrand(srcPsl)))
+        or (pslQStrand(srcPsl) != '+') or (pslQStrand(mappedPsl) != '+')) {
+        return false;
+    }
+    int length = (feature->getEnd() - feature->getStart()) + 1;
+    int srcTStart = (pslTStrand(srcPsl) == '-') ? srcPsl->tSize - feature->getEnd() : feature->getStart() - 1;
+    int iSrcBlk = pslFindTBlock(srcPsl, srcTStart, srcTStart + length);
+    if (iSrcBlk < 0) {
+        return false;
+    }
+    int qStart = srcPsl->qStarts[iSrcBlk] + (srcTStart - srcPsl->tStarts[iSrcBlk]);
+    int iMappedBlk = pslFindQBlock(mappedPsl, qStart, qStart + length);
+    if (iMappedBlk < 0) {
+        return false;
+    }
+    int mappedTStart = mappedPsl->tStarts[iMappedBlk] + (qStart - mappedPsl->qStarts[iMappedBlk]);
+    int mappedTEnd = mappedTStart + length;
+    if (pslTStrand(mappedPsl) == '-') {
+        reverseIntRange(&mappedTStart, &mappedTEnd, mappedPsl->tSize);
+    }
+    Frame frame(Frame::fromPhaseStr(feature->getPhase()).incr(0));
+    transMappedFeature.addMapped(newMappedFeature(feature, frame, string(mappedPsl->tName),
+                                                  mappedTStart, mappedTEnd, pslTStrand(mappedPsl),
+                                                  feature->getStart() - 1, feature->getEnd()));
+    return true;
+}
+
 /* Determine if an ID should be split into multiple unique ids. */
 bool FeatureMapper::shouldSplitIds(const FeatureVector& features) {
     // FIXME: add check for discontinious ids.
@@ -13,6 +13,7 @@ using namespace std;
 class GxfFeature;
 class GxfFeatureVector;
 class PslCursor;
+class Frame;
 class Feature;
 class PslMapping;
 
@@ -23,6 +24,14 @@ class PslMapping;
  */
 class FeatureMapper {
     private:
+    static Feature* newMappedFeature(const GxfFeature* feature,
+                                     const Frame& frame,
+                                     const string& mappedSeqid,
+                                     int mappedTStart,
+                                     int mappedTEnd,
+                                     char mappedStrand,
+                                     int srcTStart,
+                                     int srcTEnd);
     static Feature* mkMappedFeature(const GxfFeature* feature,
                                         const PslCursor& srcPslCursor,
                                         const PslCursor& mappedPslCursor,
@@ -63,6 +72,16 @@ class FeatureMapper {
     static TransMappedFeature map(const Feature* feature,
                                const PslMapping* pslMapping);
 
+    /* Map a feature contained in a single ungapped block of both the
+     * source and mapped alignments of its transcript, adding it to
+     * transMappedFeature.  Return false, without adding anything, if the
+     * feature crosses a gap or block boundary and must be mapped through the
+     * alignments. */
+    static bool mapUngapped(const Feature* feature,
+                            struct psl* srcPsl,
+                            struct psl* mappedPsl,
+                            TransMappedFeature& transMappedFeature);
+
     /* update Parent id for mapped or unmapped, if needed. Link Feature
      * objects. */
     static void updateParent(Feature* parentFeature,
@@ -103,7 +103,7 @@ void FeatureTransMap::mapPslVector(const PslVector& srcPsls,
 /* recursively map a PSL through the coordinate systems */
 PslVector FeatureTransMap::recursiveMapPsl(struct psl* srcPsl,
                                            int iTransMap) const {
-    PslVector mappedPsls = fTransMaps[iTransMap]->mapPsl(srcPsl);
+    PslVector mappedPsls = fTransMaps[iTransMap]->mapPsl(srcPsl, ((iTransMap == 0) ? fExonProjectionCache : NULL));
     if (iTransMap == fTransMaps.size()-1) {
         return mappedPsls;
     } else {
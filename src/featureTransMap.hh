@@ -7,6 +7,7 @@
 #include "feature.hh"
 struct psl;
 class PslMapping;
+class ExonProjectionCache;
 
 /* conversion of a list of features to a PSL */
 class FeaturesToPsl {
@@ -31,6 +32,7 @@ class FeaturesToPsl {
 class FeatureTransMap {
     private:
     TransMapVector fTransMaps;  // object(s) to performance mappings. NOT OWNED!
+    ExonProjectionCache* fExonProjectionCache;  // for first transmap, maybe NULL. NOT OWNED!
     
     void mapPslVector(const PslVector& srcPsls,
                       int iTransMap,
@@ -44,14 +46,19 @@ class FeatureTransMap {
         return transMaps;
     }
     public:
-    /* Constructor with single transmap.  Doesn't own TransMap objects */
-    FeatureTransMap(const TransMap* transMap):
-        fTransMaps(mkVector(transMap)) {
+    /* Constructor with single transmap.  Doesn't own TransMap objects.  If
+     * exonProjectionCache is not NULL, it is used to share block projections
+     * with other mappings through the same transmap; it is not owned. */
+    FeatureTransMap(const TransMap* transMap,
+                    ExonProjectionCache* exonProjectionCache=NULL):
+        fTransMaps(mkVector(transMap)),
+        fExonProjectionCache(exonProjectionCache) {
     }
     /* Constructor with mulitple transmap object, in order of projection
      * Doesn't own TransMap objects */
     FeatureTransMap(const TransMapVector& transMaps):
-        fTransMaps(transMaps) {
+        fTransMaps(transMaps),
+        fExonProjectionCache(NULL) {
     }
 
     /* destructor */
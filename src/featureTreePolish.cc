@@ -9,6 +9,14 @@
 
 const bool DEBUG = false;
 
+/* constructor, computes fingerprints of previous mapped annotations */
+FeatureTreePolish::FeatureTreePolish(const AnnotationSet* previousMappedAnotations):
+    fPreviousMappedAnotations(previousMappedAnotations) {
+    if (fPreviousMappedAnotations != NULL) {
+        buildPrevFingerprints();
+    }
+}
+
 /* renumber ab exon */
 void FeatureTreePolish::renumberExon(Feature* exon,
                                      int exonNum,
@@ -130,14 +138,46 @@ bool FeatureTreePolish::compareAttrVal(const AttrVal* prevAttr,
 }
 
 
+/* attributes compared for genes, transcripts, and other features.  Id
+ * attributes are compared without mapping versions */
+static const vector<KnownAttr> geneAttrs = {
+    ATTR_GENE_NAME,
+    ATTR_GENE_TYPE,
+    ATTR_GENE_STATUS,
+    ATTR_TAG
+};
+static const vector<KnownAttr> geneIdAttrs = {
+    ATTR_GENE_ID,
+    ATTR_GENE_HAVANA
+};
+static const vector<KnownAttr> transcriptAttrs = {
+    ATTR_GENE_NAME,
+    ATTR_TRANSCRIPT_NAME,
+    ATTR_TRANSCRIPT_TYPE,
+    ATTR_TRANSCRIPT_STATUS,
+    ATTR_TRANSCRIPT_HAVANA,
+    ATTR_TAG
+};
+static const vector<KnownAttr> transcriptIdAttrs = {
+    ATTR_GENE_ID,
+    ATTR_TRANSCRIPT_HAVANA
+};
+static const vector<KnownAttr> otherAttrs = {
+    ATTR_EXON_NUMBER,
+    ATTR_TAG
+};
+static const vector<KnownAttr> otherIdAttrs = {
+    ATTR_EXON_ID
+};
+
 /* compare two feature attribute values. If it's an id attribute, it's compared 
 * without mapping versions */
 bool FeatureTreePolish::compareAttrVals(const Feature* prevFeature,
                                         const Feature* newFeature,
-                                        const string& attrName,
+                                        KnownAttr knownAttr,
                                         bool isIdAttr) const {
-    const AttrVal* prevAttr = prevFeature->getAttrs().find(attrName);
-    const AttrVal* newAttr = newFeature->getAttrs().find(attrName);
+    const AttrVal* prevAttr = prevFeature->getAttrs().find(knownAttr);
+    const AttrVal* newAttr = newFeature->getAttrs().find(knownAttr);
     if ((prevAttr == NULL) and (newAttr == NULL)) {
         return true;  // both NULL
     } else if ((prevAttr == NULL) or (newAttr == NULL)) {
@@ -157,10 +197,10 @@ bool FeatureTreePolish::compareAttrVals(const Feature* prevFeature,
 /* compare a list of two feature attribute/values */
 bool FeatureTreePolish::compareAttrs(const Feature* prevFeature,
                                      const Feature* newFeature,
-                                     const StringVector& attrNames,
+                                     const KnownAttrVector& attrs,
                                      bool isIdAttrs) const {
-    for (int i = 0; i < attrNames.size(); i++) {
-        if (not compareAttrVals(prevFeature, newFeature, attrNames[i], isIdAttrs)) {
+    for (int i = 0; i < attrs.size(); i++) {
+        if (not compareAttrVals(prevFeature, newFeature, attrs[i], isIdAttrs)) {
             return false;
         }
     }
@@ -170,24 +210,24 @@ bool FeatureTreePolish::compareAttrs(const Feature* prevFeature,
 /* compare a list of two feature attribute/values */
 bool FeatureTreePolish::compareAttrs(const Feature* prevFeature,
                                      const Feature* newFeature,
-                                     const StringVector& attrNames,
-                                     const StringVector& idAttrNames) const {
-    return compareAttrs(prevFeature, newFeature, attrNames, false)
-        and compareAttrs(prevFeature, newFeature, idAttrNames, true);
+                                     const KnownAttrVector& attrs,
+                                     const KnownAttrVector& idAttrs) const {
+    return compareAttrs(prevFeature, newFeature, attrs, false)
+        and compareAttrs(prevFeature, newFeature, idAttrs, true);
 }
 
 
 /* compare a mapped feature with previous mapped feature.  This is not recursive */
 bool FeatureTreePolish::compareMappedFeatures(const Feature* prevFeature,
                                               const Feature* newFeature,
-                                              const StringVector& attrNames,
-                                              const StringVector& idAttrNames) const {
+                                              const KnownAttrVector& attrs,
+                                              const KnownAttrVector& idAttrs) const {
     bool same = (prevFeature->getSource() == newFeature->getSource())
         and (prevFeature->getStart() == newFeature->getStart())
         and (prevFeature->getEnd() == newFeature->getEnd())
         and (prevFeature->getStrand() == newFeature->getStrand())
         and (prevFeature->getPhase() == newFeature->getPhase())
-        and compareAttrs(prevFeature, newFeature, attrNames, idAttrNames);
+        and compareAttrs(prevFeature, newFeature, attrs, idAttrs);
     if (DEBUG and not same) {
         cerr << "diff prev\t" << prevFeature->toString() << endl
              << "      new\t" << newFeature->toString() << endl;
@@ -199,50 +239,21 @@ bool FeatureTreePolish::compareMappedFeatures(const Feature* prevFeature,
  * recursive */
 bool FeatureTreePolish::compareGeneFeatures(const Feature* prevFeature,
                                             const Feature* newFeature) const {
-    static const StringVector attrNames = {
-        GxfFeature::GENE_NAME_ATTR,
-        GxfFeature::GENE_TYPE_ATTR,
-        GxfFeature::GENE_STATUS_ATTR,
-        GxfFeature::TAG_ATTR
-    };
-    static const StringVector idAttrNames = {
-        GxfFeature::GENE_ID_ATTR,
-        GxfFeature::GENE_HAVANA_ATTR,
-    };
-    return compareMappedFeatures(prevFeature, newFeature, attrNames, idAttrNames);
+    return compareMappedFeatures(prevFeature, newFeature, geneAttrs, geneIdAttrs);
 }
 
 /* compare a mapped transcript Feature with previous mapped transcript.  This
  * is not recursive */
 bool FeatureTreePolish::compareTranscriptFeatures(const Feature* prevFeature,
                                                   const Feature* newFeature) const {
-    static const StringVector attrNames = {
-        GxfFeature::GENE_NAME_ATTR,
-        GxfFeature::TRANSCRIPT_NAME_ATTR,
-        GxfFeature::TRANSCRIPT_TYPE_ATTR,
-        GxfFeature::TRANSCRIPT_STATUS_ATTR,
-        GxfFeature::TRANSCRIPT_HAVANA_ATTR,
-        GxfFeature::TAG_ATTR
-    };
-    static const StringVector idAttrNames = {
-        GxfFeature::GENE_ID_ATTR,
-        GxfFeature::TRANSCRIPT_HAVANA_ATTR,
-    };
-    return compareMappedFeatures(prevFeature, newFeature, attrNames, idAttrNames);
+    return compareMappedFeatures(prevFeature, newFeature, transcriptAttrs, transcriptIdAttrs);
 }
 
 /* compare a mapped feature of other types (CDS, exon, etc). with previous
  * mapped features.  This is not recursive */
 bool FeatureTreePolish::compareOtherFeatures(const Feature* prevFeature,
                                              const Feature* newFeature) const {
-    static const StringVector attrNames = {
-        GxfFeature::EXON_NUMBER_ATTR,
-        GxfFeature::TAG_ATTR
-    };
-    static const StringVector idAttrNames = {
-        GxfFeature::EXON_ID_ATTR,
-    };
-    return compareMappedFeatures(prevFeature, newFeature, attrNames, idAttrNames);
+    return compareMappedFeatures(prevFeature, newFeature, otherAttrs, otherIdAttrs);
 }
 
 /* recursively compare descendant features of a transcript with previous mapped
@@ -285,6 +296,115 @@ bool FeatureTreePolish::compareMappedTranscripts(const Feature* prevTranscript,
     }
 }
 
+/* hash an id without the mapping version, avoiding the copy done by
+ * getPreMappedId() */
+static HashVal hashPreMappedId(const string& id,
+                               HashVal hv) {
+    size_t iun = id.find_last_of('_');
+    size_t len = (iun == string::npos) ? id.size() : iun;
+    return hashBytes(id.c_str(), len, hashInt(len, hv));
+}
+
+/* fingerprint of a list of attributes, matching the comparison done by
+ * compareAttrs() */
+HashVal FeatureTreePolish::attrsFingerprint(const Feature* feature,
+                                            const KnownAttrVector& attrs,
+                                            bool isIdAttrs,
+                                            HashVal hv) const {
+    for (int i = 0; i < attrs.size(); i++) {
+        const AttrVal* attr = feature->getAttrs().find(attrs[i]);
+        if (attr == NULL) {
+            hv = hashInt(-1, hv);  // distinguish missing from empty
+        } else {
+            hv = hashInt(attr->getVals().size(), hv);
+            for (int iVal = 0; iVal < attr->getVals().size(); iVal++) {
+                hv = isIdAttrs ? hashPreMappedId(attr->getVal(iVal), hv)
+                    : hashString(attr->getVal(iVal), hv);
+            }
+        }
+    }
+    return hv;
+}
+
+/* fingerprint of a single feature, matching the comparison done by
+ * compareMappedFeatures().  This is not recursive */
+HashVal FeatureTreePolish::featureFingerprint(const Feature* feature,
+                                              const KnownAttrVector& attrs,
+                                              const KnownAttrVector& idAttrs) const {
+    HashVal hv = hashString(feature->getSource());
+    hv = hashInt(feature->getStart(), hv);
+    hv = hashInt(feature->getEnd(), hv);
+    hv = hashString(feature->getStrand(), hv);
+    hv = hashString(feature->getPhase(), hv);
+    hv = attrsFingerprint(feature, attrs, false, hv);
+    return attrsFingerprint(feature, idAttrs, true, hv);
+}
+
+/* fingerprint of a gene feature, not including it's children */
+HashVal FeatureTreePolish::geneFingerprint(const Feature* gene) const {
+    return featureFingerprint(gene, geneAttrs, geneIdAttrs);
+}
+
+/* recursive fingerprint of the descendants of a transcript, matching
+ * compareMappedTranscriptsDescendants().  Children are combined with an
+ * order-independent sum so no sorting is required. */
+HashVal FeatureTreePolish::descendantsFingerprint(const Feature* parent) const {
+    HashVal sum = 0;
+    for (int i = 0; i < parent->getChildren().size(); i++) {
+        const Feature* child = parent->getChild(i);
+        sum += hashMix(hashCombine(featureFingerprint(child, otherAttrs, otherIdAttrs),
+                                   descendantsFingerprint(child)));
+    }
+    return hashCombine(hashInt(parent->getChildren().size()), sum);
+}
+
+/* compute fingerprints of all previous mapped genes and transcripts, so
+ * each is only traversed once */
+void FeatureTreePolish::buildPrevFingerprints() {
+    const FeatureVector& genes = fPreviousMappedAnotations->getGenes();
+    for (int iGene = 0; iGene < genes.size(); iGene++) {
+        const Feature* gene = genes[iGene];
+        fPrevFingerprints[gene] = geneFingerprint(gene);
+        for (int iTrans = 0; iTrans < gene->getChildren().size(); iTrans++) {
+            const Feature* transcript = gene->getChild(iTrans);
+            fPrevFingerprints[transcript] = descendantsFingerprint(transcript);
+        }
+    }
+}
+
+/* get the precomputed fingerprint of a previous gene or transcript */
+HashVal FeatureTreePolish::getPrevFingerprint(const Feature* prevFeature) const {
+    FingerprintMapConstIter it = fPrevFingerprints.find(prevFeature);
+    if (it != fPrevFingerprints.end()) {
+        return it->second;
+    } else if (prevFeature->isGene()) {
+        return geneFingerprint(prevFeature);
+    } else {
+        return descendantsFingerprint(prevFeature);
+    }
+}
+
+/* is a mapped transcript the same as the previous mapped transcript */
+bool FeatureTreePolish::sameMappedTranscript(const Feature* prevTranscript,
+                                             const Feature* newTranscript) const {
+    bool same = (getPrevFingerprint(prevTranscript) == descendantsFingerprint(newTranscript));
+    if (DEBUG and (same != compareMappedTranscriptsDescendants(prevTranscript, newTranscript))) {
+        throw logic_error("transcript fingerprint disagrees with comparison: " + newTranscript->toString());
+    }
+    return same;
+}
+
+/* is a mapped gene feature the same as the previous mapped gene.  This is not
+ * recursive */
+bool FeatureTreePolish::sameMappedGene(const Feature* prevGene,
+                                       const Feature* newGene) const {
+    bool same = (getPrevFingerprint(prevGene) == geneFingerprint(newGene));
+    if (DEBUG and (same != compareGeneFeatures(prevGene, newGene))) {
+        throw logic_error("gene fingerprint disagrees with comparison: " + newGene->toString());
+    }
+    return same;
+}
+
 /* add a mapping version to an id */
 void FeatureTreePolish::setMappingVersionInId(Feature* feature,
                                               const AttrVal* attr,
@@ -323,7 +443,7 @@ bool FeatureTreePolish::setTranscriptMappingVersion(Feature* transcript) const {
     // find previous transcript, if it exists and derive version from it.
     const Feature* prevTranscript = getPrevMappedFeature(transcript);
     bool transcriptSame = (prevTranscript == NULL)
-        or compareMappedTranscriptsDescendants(prevTranscript, transcript);
+        or sameMappedTranscript(prevTranscript, transcript);
     int mappingVersion = getFeatureMappingVersion(prevTranscript, transcriptSame);
   
     recursiveSetMappingVersion(transcript, GxfFeature::TRANSCRIPT_ID_ATTR, GxfFeature::TRANSCRIPT_HAVANA_ATTR, mappingVersion);
@@ -412,7 +532,7 @@ void FeatureTreePolish::setGeneMappingVersion(Feature* gene) const {
 
     const Feature* prevGene = getPrevMappedFeature(gene);
     bool geneSame = transcriptsSame and
-        ((prevGene == NULL) or compareGeneFeatures(prevGene, gene));
+        ((prevGene == NULL) or sameMappedGene(prevGene, gene));
     int mappingVersion = getFeatureMappingVersion(prevGene, geneSame);
     recursiveSetMappingVersion(gene, GxfFeature::GENE_ID_ATTR, GxfFeature::GENE_HAVANA_ATTR, mappingVersion);
     setExonsMappingVersions(prevGene, gene);
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <map>
 #include "feature.hh"
+#include "hashOps.hh"
 class AnnotationSet;
 
 /*
@@ -28,7 +29,15 @@ class FeatureTreePolish {
     typedef ExonIdExonMap::iterator ExonIdExonMapIter;
     typedef ExonIdExonMap::const_iterator ExonIdExonMapConstIter;
 
+    // list of attributes to compare
+    typedef vector<KnownAttr> KnownAttrVector;
+
+    // content fingerprints of previous mapped genes and transcripts
+    typedef map<const Feature*, HashVal> FingerprintMap;
+    typedef FingerprintMap::const_iterator FingerprintMapConstIter;
+
     const AnnotationSet* fPreviousMappedAnotations; // maybe NULL
+    FingerprintMap fPrevFingerprints;  // computed at construction
     
     void renumberExon(Feature* exon,
                       int exonNum,
@@ -54,20 +63,20 @@ class FeatureTreePolish {
                         bool isIdAttr) const;
     bool compareAttrVals(const Feature* prevFeature,
                          const Feature* newFeature,
-                         const string& attrName,
+                         KnownAttr knownAttr,
                          bool isIdAttr) const;
     bool compareAttrs(const Feature* prevFeature,
                       const Feature* newFeature,
-                      const StringVector& attrNames,
+                      const KnownAttrVector& attrs,
                       bool isIdAttrs) const;
     bool compareAttrs(const Feature* prevFeature,
                       const Feature* newFeature,
-                      const StringVector& attrNames,
-                      const StringVector& idAttrNames) const;
+                      const KnownAttrVector& attrs,
+                      const KnownAttrVector& idAttrs) const;
     bool compareMappedFeatures(const Feature* prevFeature,
                                const Feature* newFeature,
-                               const StringVector& attrNames,
-                               const StringVector& idAttrNames) const;
+                               const KnownAttrVector& attrs,
+                               const KnownAttrVector& idAttrs) const;
     bool compareGeneFeatures(const Feature* prevFeature,
                              const Feature* newFeature) const;
     bool compareTranscriptFeatures(const Feature* prevFeature,
@@ -78,6 +87,21 @@ class FeatureTreePolish {
                                   const Feature* newTranscript) const;
     bool compareMappedTranscriptsDescendants(const Feature* prevParent,
                                              const Feature* newParent) const;
+    HashVal attrsFingerprint(const Feature* feature,
+                             const KnownAttrVector& attrs,
+                             bool isIdAttrs,
+                             HashVal hv) const;
+    HashVal featureFingerprint(const Feature* feature,
+                               const KnownAttrVector& attrs,
+                               const KnownAttrVector& idAttrs) const;
+    HashVal geneFingerprint(const Feature* gene) const;
+    HashVal descendantsFingerprint(const Feature* parent) const;
+    void buildPrevFingerprints();
+    HashVal getPrevFingerprint(const Feature* prevFeature) const;
+    bool sameMappedTranscript(const Feature* prevTranscript,
+                              const Feature* newTranscript) const;
+    bool sameMappedGene(const Feature* prevGene,
+                        const Feature* newGene) const;
     void setMappingVersionInId(Feature* feature,
                                const AttrVal* attr,
                                int mappingVersion) const;
@@ -105,10 +129,8 @@ class FeatureTreePolish {
     
     public:
 
-    /* constructor */
-    FeatureTreePolish(const AnnotationSet* previousMappedAnotations):
-        fPreviousMappedAnotations(previousMappedAnotations) {
-    }
+    /* constructor, computes fingerprints of previous mapped annotations */
+    FeatureTreePolish(const AnnotationSet* previousMappedAnotations);
     
     /* last minute fix-ups */
     void polishGene(Feature* gene) const;
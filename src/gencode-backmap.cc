@@ -7,11 +7,23 @@
 #include "typeOps.hh"
 #include "FIOStream.hh"
 #include "transMap.hh"
+#include "mapAlnFilter.hh"
 #include "geneMapper.hh"
 #include "annotationSet.hh"
 #include "bedMap.hh"
 #include "globals.hh"
 #include "gxfIO.hh"
+#include "resultFeaturesCache.hh"
+#include "mappingServer.hh"
+#include "mappingSession.hh"
+#include "mappingInfo.hh"
+#include "mappingInfoBin.hh"
+#include "intervalLifter.hh"
+#include "mappingStats.hh"
+#include "asyncOutput.hh"
+#include "genePipeline.hh"
+#include "featureTreePolish.hh"
+#include <chrono>
 #include "./version.h"
 
 /* verbose tracing enabled */
@@ -38,18 +50,60 @@ static bool checkGxfFormats(const string& inGxfFile,
                             const string& mappedGxfFile,
                             const string& unmappedGxfFile,
                             const string& targetGxf,
-                            const string& previousMappedGxf) {
+                            const string& previousMappedGxf,
+                            const string& previousSrcGxf) {
     GxfFormat inFormat = gxfFormatFromFileName(inGxfFile);
     return checkGxfFormat(inFormat, mappedGxfFile, false)
         and checkGxfFormat(inFormat, unmappedGxfFile, true)
         and checkGxfFormat(inFormat, targetGxf, true)
-        and checkGxfFormat(inFormat, previousMappedGxf, true);
+        and checkGxfFormat(inFormat, previousMappedGxf, true)
+        and checkGxfFormat(inFormat, previousSrcGxf, true);
+}
+
+/* Create the filter used to prune mapping alignments, or NULL if not
+ * pruning.  A negative padding indicates alignments are not pruned by the
+ * location of the genes. */
+static MapAlnFilter* makeMapAlnFilter(const string& inGxfFile,
+                                      int prunePadding,
+                                      int pruneMinScore,
+                                      int pruneMinSize) {
+    if ((prunePadding < 0) and (pruneMinScore == 0) and (pruneMinSize == 0)) {
+        return NULL;
+    }
+    MapAlnFilter* mapAlnFilter = new MapAlnFilter(max(prunePadding, 0), pruneMinScore, pruneMinSize);
+    if (prunePadding >= 0) {
+        mapAlnFilter->addGxfGeneSpans(inGxfFile);
+    }
+    return mapAlnFilter;
+}
+
+/* load mapping alignments, composing them with any additional mapping
+ * alignments, in order.  The filter, if not NULL, applies to the first
+ * mapping alignments, whose query is the source genome. */
+static TransMap* loadMappingAligns(const string& mappingAligns,
+                                   const StringVector& composeMappingAligns,
+                                   bool swapMap,
+                                   int numThreads,
+                                   const MapAlnFilter* mapAlnFilter) {
+    TransMap* transMap = TransMap::factoryFromFile(mappingAligns, swapMap, numThreads, mapAlnFilter);
+    for (size_t i = 0; i < composeMappingAligns.size(); i++) {
+        TransMap* nextTransMap = TransMap::factoryFromFile(composeMappingAligns[i], swapMap, numThreads);
+        TransMap* composedTransMap = TransMap::factoryFromComposed(transMap, nextTransMap);
+        delete nextTransMap;
+        delete transMap;
+        transMap = composedTransMap;
+    }
+    return transMap;
 }
 
 /* map to different assembly */
 static void gencodeBackmap(const string& inGxfFile,
                            const string& mappingAligns,
+                           const StringVector& composeMappingAligns,
                            bool swapMap,
+                           int prunePadding,
+                           int pruneMinScore,
+                           int pruneMinSize,
                            const string& substituteMissingTargetVersion,
                            unsigned useTargetFlags,
                            bool onlyManualForTargetSubstituteOverlap,
@@ -58,47 +112,187 @@ static void gencodeBackmap(const string& inGxfFile,
                            const string& mappedGxfFile,
                            const string& unmappedGxfFile,
                            const string& mappingInfoTsv,
+                           const string& mappingInfoBin,
                            const string& targetGxf,
                            const string& targetPatchBed,
                            const string& previousMappedGxf,
-                           const string& transcriptPsls) {
-    TransMap* genomeTransMap = TransMap::factoryFromFile(mappingAligns, swapMap);
-    AnnotationSet srcAnnotations(inGxfFile);
-    AnnotationSet* targetAnnotations = (targetGxf.size() > 0) ? new AnnotationSet(targetGxf) : NULL;
-    AnnotationSet* previousMappedAnnotations = (previousMappedGxf.size() > 0) ? new AnnotationSet(previousMappedGxf) : NULL;
+                           const string& previousSrcGxf,
+                           const string& transcriptPsls,
+                           const string& cacheDir,
+                           int numThreads,
+                           int minParallelTranscripts) {
+    MapAlnFilter* mapAlnFilter = makeMapAlnFilter(inGxfFile, prunePadding, pruneMinScore, pruneMinSize);
+    TransMap* genomeTransMap = loadMappingAligns(mappingAligns, composeMappingAligns, swapMap, numThreads, mapAlnFilter);
+    delete mapAlnFilter;
+    // with multiple threads, the source is loaded as it is mapped
+    AnnotationSet* srcAnnotations = (numThreads > 1) ? new AnnotationSet() : new AnnotationSet(inGxfFile);
+    AnnotationSet* targetAnnotations = (targetGxf.size() > 0) ? new AnnotationSet(targetGxf, NULL, numThreads) : NULL;
+    AnnotationSet* previousMappedAnnotations = (previousMappedGxf.size() > 0) ? new AnnotationSet(previousMappedGxf, NULL, numThreads) : NULL;
+    AnnotationSet* previousSrcAnnotations = (previousSrcGxf.size() > 0) ? new AnnotationSet(previousSrcGxf, NULL, numThreads) : NULL;
     BedMap* targetPatchMap = (targetPatchBed.size() > 0) ? new BedMap(targetPatchBed) : NULL;
-    GxfWriter* mappedGxfFh = GxfWriter::factory(mappedGxfFile, parIdHackMethod);
-    GxfWriter* unmappedGxfFh = (unmappedGxfFile.size() > 0)
-        ? GxfWriter::factory(unmappedGxfFile, parIdHackMethod) : NULL;
+    ResultFeaturesCache* resultCache = (cacheDir.size() > 0) ? new ResultFeaturesCache(cacheDir) : NULL;
+    // output is formatted, compressed, and written by writer threads
+    FIOStream mappedGxfFileFh(mappedGxfFile, ios::out);
+    AsyncOStream mappedGxfOut(mappedGxfFileFh);
+    GxfWriter* mappedGxfFh = GxfWriter::factory(mappedGxfOut, gxfFormatFromFileName(mappedGxfFile), parIdHackMethod);
+    FIOStream* unmappedGxfFileFh = (unmappedGxfFile.size() > 0) ? new FIOStream(unmappedGxfFile, ios::out) : NULL;
+    AsyncOStream* unmappedGxfOut = (unmappedGxfFileFh != NULL) ? new AsyncOStream(*unmappedGxfFileFh) : NULL;
+    GxfWriter* unmappedGxfFh = (unmappedGxfOut != NULL)
+        ? GxfWriter::factory(*unmappedGxfOut, gxfFormatFromFileName(unmappedGxfFile), parIdHackMethod) : NULL;
     if (headerFile.size() > 0) {
         mappedGxfFh->copyFile(headerFile);
         if (unmappedGxfFh != NULL) {
             unmappedGxfFh->copyFile(headerFile);
         }
     }
-    FIOStream mappingInfoFh((mappingInfoTsv.size() > 0) ? mappingInfoTsv : "/dev/null" , ios::out);
-    FIOStream* transcriptPslFh = (transcriptPsls.size() > 0) ? new FIOStream(transcriptPsls, ios::out) : NULL;
-    GeneMapper geneMapper(&srcAnnotations, genomeTransMap, targetAnnotations, previousMappedAnnotations,
-                          targetPatchMap, substituteMissingTargetVersion,
+    FIOStream mappingInfoTsvFh((mappingInfoTsv.size() > 0) ? mappingInfoTsv : "/dev/null" , ios::out);
+    MappingInfoTsvWriter mappingInfoTsvWriter(mappingInfoTsvFh);
+    FIOStream* mappingInfoBinFh = (mappingInfoBin.size() > 0) ? new FIOStream(mappingInfoBin, ios::out) : NULL;
+    MappingInfoBinWriter* mappingInfoBinWriter = (mappingInfoBinFh != NULL) ? new MappingInfoBinWriter(*mappingInfoBinFh) : NULL;
+    MappingInfoMultiWriter mappingInfoWriters;
+    mappingInfoWriters.add(&mappingInfoTsvWriter);
+    if (mappingInfoBinWriter != NULL) {
+        mappingInfoWriters.add(mappingInfoBinWriter);
+    }
+    AsyncMappingInfoWriter mappingInfoFh(mappingInfoWriters);
+    FIOStream* transcriptPslFileFh = (transcriptPsls.size() > 0) ? new FIOStream(transcriptPsls, ios::out) : NULL;
+    AsyncOStream* transcriptPslFh = (transcriptPslFileFh != NULL) ? new AsyncOStream(*transcriptPslFileFh) : NULL;
+    GeneMapper geneMapper(srcAnnotations, genomeTransMap, targetAnnotations, previousMappedAnnotations,
+                          previousSrcAnnotations, targetPatchMap, resultCache, substituteMissingTargetVersion,
                           useTargetFlags, onlyManualForTargetSubstituteOverlap);
-    geneMapper.mapGxf(*mappedGxfFh, unmappedGxfFh, mappingInfoFh, transcriptPslFh);
+    if (numThreads > 1) {
+        geneMapper.setTranscriptThreads(numThreads, minParallelTranscripts);
+        geneMapper.setCopyTargetThreads(numThreads);
+        FeatureTreePolish featureTreePolish(previousMappedAnnotations);
+        GenePipeline genePipeline(geneMapper, featureTreePolish, numThreads, max(1, numThreads / 4));
+        genePipeline.mapGxf(inGxfFile, *srcAnnotations, true, *mappedGxfFh, unmappedGxfFh,
+                            mappingInfoFh, transcriptPslFh);
+    } else {
+        geneMapper.mapGxf(*mappedGxfFh, unmappedGxfFh, mappingInfoFh, transcriptPslFh);
+    }
+
+    // flush in a fixed order, so errors are reported deterministically
+    mappingInfoFh.close();
+    if (mappingInfoBinWriter != NULL) {
+        mappingInfoBinWriter->close();
+    }
+    mappedGxfOut.close();
+    if (unmappedGxfOut != NULL) {
+        unmappedGxfOut->close();
+    }
+    if (transcriptPslFh != NULL) {
+        transcriptPslFh->close();
+    }
+    delete mappingInfoBinWriter;
+    delete mappingInfoBinFh;
     delete mappedGxfFh;
     delete unmappedGxfFh;
+    delete unmappedGxfOut;
+    delete unmappedGxfFileFh;
+    delete transcriptPslFh;
+    delete transcriptPslFileFh;
     delete genomeTransMap;
     delete targetPatchMap;
+    delete resultCache;
     delete targetAnnotations;
     delete previousMappedAnnotations;
-    delete transcriptPslFh;
+    delete previousSrcAnnotations;
+    delete srcAnnotations;
+}
+
+/* run as a server */
+static void gencodeBackmapServe(const string& socketPath,
+                                const string& mappingAligns,
+                                const StringVector& composeMappingAligns,
+                                bool swapMap,
+                                const string& substituteMissingTargetVersion,
+                                unsigned useTargetFlags,
+                                bool onlyManualForTargetSubstituteOverlap,
+                                ParIdHackMethod parIdHackMethod,
+                                const string& targetGxf,
+                                const string& targetPatchBed,
+                                const string& previousMappedGxf,
+                                const string& cacheDir,
+                                int numThreads) {
+    MappingSession mappingSession(loadMappingAligns(mappingAligns, composeMappingAligns, swapMap, numThreads, NULL),
+                                  targetGxf, targetPatchBed, previousMappedGxf, cacheDir,
+                                  substituteMissingTargetVersion, useTargetFlags,
+                                  onlyManualForTargetSubstituteOverlap);
+    MappingServer mappingServer(socketPath, &mappingSession, parIdHackMethod, numThreads);
+    mappingServer.serve();
 }
 
-const string usage = "%s [options] inGxf mappingAligns mappedGxf [mappingInfoTsv]\n\n"
+/* lift BED/TSV intervals */
+static void gencodeBackmapLift(const string& mappingAligns,
+                               const StringVector& composeMappingAligns,
+                               bool swapMap,
+                               int numThreads,
+                               int batchSize,
+                               int bedFields,
+                               const string& inBed,
+                               const string& mappedBed,
+                               const string& unmappedBed,
+                               const string& liftInfoTsv) {
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    TransMap* genomeTransMap = loadMappingAligns(mappingAligns, composeMappingAligns, swapMap, numThreads, NULL);
+    std::chrono::steady_clock::time_point liftStart = std::chrono::steady_clock::now();
+    FIOStream inFh(inBed);
+    FIOStream mappedFh(mappedBed, ios::out);
+    FIOStream* unmappedFh = (unmappedBed.size() > 0) ? new FIOStream(unmappedBed, ios::out) : NULL;
+    FIOStream* liftInfoFh = (liftInfoTsv.size() > 0) ? new FIOStream(liftInfoTsv, ios::out) : NULL;
+    IntervalLifter intervalLifter(genomeTransMap, numThreads, batchSize, bedFields);
+    LiftCounts counts = intervalLifter.lift(inFh, mappedFh, unmappedFh, liftInfoFh);
+    delete unmappedFh;
+    delete liftInfoFh;
+    std::chrono::steady_clock::time_point liftEnd = std::chrono::steady_clock::now();
+    double loadSecs = std::chrono::duration<double>(liftStart - loadStart).count();
+    double liftSecs = std::chrono::duration<double>(liftEnd - liftStart).count();
+    cerr << "lifted " << counts.numIntervals << " intervals, " << counts.numMapped << " mapped, "
+         << counts.numMappings << " mapped records; load " << loadSecs << " sec, lift " << liftSecs
+         << " sec, " << long((liftSecs > 0.0) ? (counts.numIntervals / liftSecs) : 0) << " intervals/sec" << endl;
+    delete genomeTransMap;
+}
+
+const string usage = "%s [options] inGxf mappingAligns mappedGxf [mappingInfoTsv]\n"
+    "%s [options] --serve=socketPath mappingAligns\n"
+    "%s lift [options] mappingAligns inBed mappedBed\n"
+    "%s mapInfoToTsv mappingInfoBin mappingInfoTsv\n"
+    "%s stats [options] outDir inFile ...\n\n"
     "Map GENCODE annotations between assemblies projecting through genomic\n"
     "alignments. This operates on GENCODE GFF3 and GTF files and makes assumptions\n"
     "about their organization.\n\n"
+    "With --serve, the mapping alignments and target and previous annotations are\n"
+    "loaded once and GxF genes are mapped as they are received on a Unix domain socket.\n"
+    "A client sends complete genes, in GFF3 (starting with ##gff-version 3) or GTF, and\n"
+    "shuts down its side of the connection.  The response contains ##mapped, ##unmapped,\n"
+    "and ##map-info sections followed by ##end, or ##error on failure.  Target genes are\n"
+    "not copied to the response.  --threads is the number of requests mapped at the\n"
+    "same time, other connections wait to be accepted.  For example:\n"
+    "    socat -t 600 - UNIX-CONNECT:socketPath <gene.gff3\n\n"
+    "The lift subcommand projects BED/TSV intervals through the mapping alignments,\n"
+    "see `lift --help'.\n\n"
+    "The mapInfoToTsv subcommand converts a file created with --mappingInfoBin to\n"
+    "the mapping info TSV format.\n\n"
+    "The stats subcommand summarizes mapping info or lift attrs files,\n"
+    "see `stats --help'.\n\n"
     "Options:\n"
     "  --help - print this message and exit\n"
     "  --verbose - verbose tracing to stderr\n"
     "  --swapMap - swap the query and target sides of the mapping alignments\n"
+    "  --composeMappingAligns=alignFile - additional mapping alignments from the\n"
+    "    target of mappingAligns to another genome.  The alignments are composed\n"
+    "    when loaded, so annotations are mapped through both in one step.  Maybe\n"
+    "    repeated to compose a series of mappings, which are applied in order.\n"
+    "    --swapMap applies to all mapping alignments.\n"
+    "  --pruneMappingAligns=padding - only keep mapping alignments that overlap a gene\n"
+    "    in inGxf, extended by padding bases on each side, reducing memory and load\n"
+    "    time.  The gene locations are read before the mapping alignments are loaded.\n"
+    "    As mappings only use alignments overlapping the gene, this doesn't change the\n"
+    "    results.\n"
+    "  --pruneMinScore=score - only keep chains with at least this score.  This\n"
+    "    changes the results, as do the other --prune options.\n"
+    "  --pruneMinSize=bases - only keep mapping alignments with at least this many\n"
+    "    aligned bases.\n"
     "  --unmappedGxf=gxfFile - output unmapped annotations in an GTF/GFF3 file.\n"
     "    This is mainly useful for debugging.\n"
     "  --targetGxf=gxfFile - GFF3 or GTF of gene annotations on target genome.\n"
@@ -106,10 +300,22 @@ const string usage = "%s [options] inGxf mappingAligns mappedGxf [mappingInfoTsv
     "    gene or transcript.\n"
     "  --previousMappedGxf=gxfFile - GFF3 or GTF of gene annotations on previous mapping.\n"
     "    This is used to determine the mapped version number to append to the ids.\n"
+    "  --previousSrcGxf=gxfFile - GFF3 or GTF of the source annotations used to create\n"
+    "    the previousMappedGxf.  Genes that are identical to the previous source release\n"
+    "    and were completely mapped are copied from previousMappedGxf rather than\n"
+    "    being mapped again.  Requires --previousMappedGxf and is only valid if the\n"
+    "    mapping alignments are the same as used for the previous mapping. Transcript PSLs\n"
+    "    are only written for genes that are mapped.\n"
     "  --headerFile=commentFile - copy contents of this file as comment header for GFF3/GTF output.\n"
     "    Doesn't include GFF3 file type meta comment.\n"
     "  --transcriptPsls=pslFile - write all mapped transcript-level PSL to this file, including\n"
     "    multiple mappers.\n"
+    "  --mappingInfoBin=file - also write the mapping info in a columnar binary format\n"
+    "    that is faster to read than the TSV.  Convert to TSV with mapInfoToTsv.\n"
+    "  --cacheDir=dir - cache the transcript mappings of each gene in this directory.\n"
+    "    Entries are keyed by the source gene, the overlapping mapping alignments, and\n"
+    "    the target annotations used in selecting mappings, so a cache can be shared by\n"
+    "    runs with different options.  The directory is created if it doesn't exist.\n"
     "  --substituteMissingTargets=targetVersion - if target GxF is specified and no GENE maps to\n"
     "    the target locus, pass through the original target location.  Only a subset of the\n"
     "    biotypes are substituted. Argument is target GENCODE version that is stored as an attribute\n"
@@ -128,8 +334,16 @@ const string usage = "%s [options] inGxf mappingAligns mappedGxf [mappingInfoTsv
     "  --onlyManualForTargetSubstituteOverlap - when checking for overlap of\n"
     "    target with mapped before substituting a target gene, only consider\n"
     "    manual transcripts.\n"
+    "  --serve=socketPath - run as a server on this Unix domain socket.\n"
     "  --oldStyleParIdHack - use ENSTR style PAR id unique on output rather than the\n"
     "    newer _PAR_Y.  Either form is recognized on input.\n"
+    "  --threads=n - number of threads used to map genes, default 1.  With more than\n"
+    "    one thread, parsing, mapping, assignment of mapping versions, and output\n"
+    "    are overlapped in a pipeline.  The transcripts of genes with many transcripts\n"
+    "    are also mapped in parallel, as is the check of which target genes to copy.\n"
+    "    Chain mapping alignments and the target and previous GxF files are parsed\n"
+    "    in parallel.\n"
+    "    Output is the same as with one thread.\n"
     "Arguments:\n"
     "  inGxf - Input GENCODE GFF3 or GTF file. The format is identified\n"
     "          by a .gff3 or .gtf extension, it maybe compressed with gzip with an\n"
@@ -145,18 +359,29 @@ const struct option long_options[] = {
     {"help", 0, NULL, 'h'},
     {"verbose", 0, NULL, 'v'},
     {"swapMap", 0, NULL, 's'},
+    {"composeMappingAligns", 1, NULL, 'K'},
+    {"pruneMappingAligns", 1, NULL, 'G'},
+    {"pruneMinScore", 1, NULL, 'g'},
+    {"pruneMinSize", 1, NULL, 'z'},
     {"unmappedGxf", 1, NULL, 'U'},
     {"targetGxf", 1, NULL, 't'}, 
     {"previousMappedGxf", 1, NULL, 'M'}, 
+    {"previousSrcGxf", 1, NULL, 'S'}, 
     {"targetPatches", 1, NULL, 'T'}, 
     {"headerFile", 1, NULL, 'H'},
     {"transcriptPsls", 1, NULL, 'p'},
+    {"cacheDir", 1, NULL, 'C'},
+    {"mappingInfoBin", 1, NULL, 'B'},
     {"substituteMissingTargets", 1, NULL, 'm'},
     {"useTargetForAutoSmallNonCoding", 0, NULL, 'N'},
     {"useTargetForAutoGenes", 0, NULL, 'A'},
     {"useTargetForPseudoGenes", 0, NULL, 'P'},
     {"onlyManualForTargetSubstituteOverlap", 0, NULL, 'O'},
     {"oldStyleParIdHack", 0, NULL, 'Q'},
+    {"serve", 1, NULL, 'R'},
+    {"threads", 1, NULL, 'j'},
+    // for testing, not documented: minimum transcripts in a gene to map them in parallel
+    {"minParallelTranscripts", 1, NULL, 'L'},
     {NULL, 0, NULL, 0}
 };
 const char* short_options = "hst:p:m:n";
@@ -166,9 +391,255 @@ static void prUsage() {
     cerr << usage << "Version: " << VERSION << " (" << VERSION_HASH <<  ")" << endl;
 }
 
+const string liftUsage = "%s lift [options] mappingAligns inBed mappedBed\n\n"
+    "Lift intervals in a BED or other TSV file through the mapping alignments.\n"
+    "The first three columns must be chrom, start and end, in BED coordinates.\n"
+    "The fourth column is used as the name if present, and the sixth, if a strand,\n"
+    "is reversed for mappings to the opposite strand.  With --bedFields of at least 8,\n"
+    "thickStart and thickEnd are lifted to the mapped part of the thick region.  Other\n"
+    "columns are passed through, so formats such as narrowPeak can be lifted.  An\n"
+    "interval that projects through multiple mapping alignments results in multiple\n"
+    "records.  Input is processed in batches that are divided between threads,\n"
+    "output is in input order.  A throughput summary is written to stderr.\n\n"
+    "Options:\n"
+    "  --help - print this message and exit\n"
+    "  --verbose - verbose tracing to stderr\n"
+    "  --swapMap - swap the query and target sides of the mapping alignments\n"
+    "  --composeMappingAligns=alignFile - additional mapping alignments to compose\n"
+    "    with mappingAligns, maybe repeated.\n"
+    "  --threads=n - number of threads to use, default 1.  Chain mapping alignments\n"
+    "    are also parsed in parallel.\n"
+    "  --batchSize=n - number of lines to read per batch, default 100000\n"
+    "  --bedFields=n - input is BED with n standard fields, followed by any other\n"
+    "    columns.  Must be in the range 3 to 9, BED12 blocks are not lifted.\n"
+    "    Without this option, only the first three columns are interpreted as BED.\n"
+    "  --unmapped=bedFile - write intervals that could not be lifted to this file\n"
+    "  --liftInfo=tsvFile - write the status of each interval to this TSV file.\n"
+    "    The mappingStatus column is full_contig, full_fragment, partial, deleted,\n"
+    "    no_seq_map (chrom not in mapping alignments) or ineligible (zero length).\n"
+    "Arguments:\n"
+    "  mappingAligns - Alignments between the two genomes.\n"
+    "  inBed - Input BED or TSV file, maybe compressed.\n"
+    "  mappedBed - Output file of lifted records.\n"
+    "\n";
+
+const struct option lift_long_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"verbose", 0, NULL, 'v'},
+    {"swapMap", 0, NULL, 's'},
+    {"composeMappingAligns", 1, NULL, 'K'},
+    {"threads", 1, NULL, 'j'},
+    {"batchSize", 1, NULL, 'b'},
+    {"bedFields", 1, NULL, 'F'},
+    {"unmapped", 1, NULL, 'U'},
+    {"liftInfo", 1, NULL, 'I'},
+    {NULL, 0, NULL, 0}
+};
+
+/* print lift usage */
+static void prLiftUsage() {
+    cerr << liftUsage << "Version: " << VERSION << " (" << VERSION_HASH <<  ")" << endl;
+}
+
+/* parse an option value that must be an integer greater than zero */
+static int parsePositiveIntOpt(const string& optName,
+                               const string& optValue) {
+    bool isOk;
+    int value = stringToInt(optValue, &isOk);
+    if ((not isOk) or (value < 1)) {
+        errAbort(toCharStr("%s must be an integer greater than zero, got \"%s\""),
+                 optName.c_str(), optValue.c_str());
+    }
+    return value;
+}
+
+/* parse an option value that must be an integer that is zero or greater */
+static int parseNonNegativeIntOpt(const string& optName,
+                                  const string& optValue) {
+    bool isOk;
+    int value = stringToInt(optValue, &isOk);
+    if ((not isOk) or (value < 0)) {
+        errAbort(toCharStr("%s must be an integer of zero or greater, got \"%s\""),
+                 optName.c_str(), optValue.c_str());
+    }
+    return value;
+}
+
+/* lift subcommand entry.  Parse arguments. */
+static int liftMain(int argc, char *argv[]) {
+    bool swapMap = false;
+    StringVector composeMappingAligns;
+    bool help = false;
+    int numThreads = 1;
+    int batchSize = 100000;
+    int bedFields = 0;
+    string unmappedBed;
+    string liftInfoTsv;
+    opterr = 0;  // we print error message
+    while (true) {
+        int optc = getopt_long(argc, argv, "", lift_long_options, NULL);
+        if (optc == -1) {
+            break;
+        } else if (optc == 'h') {
+            help = true;
+            break;  // check no more
+        } else if (optc == 'v') {
+            gVerbose = true;
+        } else if (optc == 's') {
+            swapMap = true;
+        } else if (optc == 'K') {
+            composeMappingAligns.push_back(optarg);
+        } else if (optc == 'j') {
+            numThreads = parsePositiveIntOpt("--threads", optarg);
+        } else if (optc == 'b') {
+            batchSize = parsePositiveIntOpt("--batchSize", optarg);
+        } else if (optc == 'F') {
+            bedFields = parsePositiveIntOpt("--bedFields", optarg);
+            if ((bedFields < 3) or (bedFields > 9)) {
+                errAbort(toCharStr("--bedFields must be in the range 3 to 9, BED12 blocks can't be lifted, got %d"), bedFields);
+            }
+        } else if (optc == 'U') {
+            unmappedBed = string(optarg);
+        } else if (optc == 'I') {
+            liftInfoTsv = string(optarg);
+        } else {
+            errAbort(toCharStr("invalid option %s"), argv[optind-1]);
+        }
+    }
+    if (help) {
+        prLiftUsage();
+        return 1;
+    }
+    if ((argc - optind) != 3) {
+        cerr << "wrong # args: ";
+        prLiftUsage();
+        return 1;
+    }
+    try {
+        gencodeBackmapLift(argv[optind], composeMappingAligns, swapMap, numThreads, batchSize, bedFields,
+                           argv[optind+1], argv[optind+2], unmappedBed, liftInfoTsv);
+    } catch (const exception& ex) {
+        cerr << "Error: " << ex.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+/* convert binary mapping info to TSV */
+static void mapInfoToTsv(const string& mappingInfoBin,
+                         const string& mappingInfoTsv) {
+    FIOStream inFh(mappingInfoBin);
+    FIOStream outFh(mappingInfoTsv, ios::out);
+    MappingInfoBinReader reader(inFh);
+    MappingInfoTsvWriter writer(outFh);
+    MappingInfo mappingInfo;
+    while (reader.read(mappingInfo)) {
+        writer.write(mappingInfo);
+    }
+}
+
+/* mapInfoToTsv subcommand entry. */
+static int mapInfoToTsvMain(int argc, char *argv[]) {
+    if ((argc != 3) or (string(argv[1]) == "--help")) {
+        cerr << "wrong # args: ";
+        prUsage();
+        return 1;
+    }
+    try {
+        mapInfoToTsv(argv[1], argv[2]);
+    } catch (const exception& ex) {
+        cerr << "Error: " << ex.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+const string statsUsage = "%s stats [options] outDir inFile ...\n\n"
+    "Produce summary statistics for mapping info files (TSV or created with\n"
+    "--mappingInfoBin) or the UCSC attrs table of a mapping.  The file type is\n"
+    "determined from its contents.  Each file is read in a single pass and\n"
+    "multiple files are processed in parallel.  For each inFile, the counts of\n"
+    "genes and transcripts by biotype category and mapping type are written to\n"
+    "outDir/base.stats, where base is the file name without directory and\n"
+    "extension.  For mapping info files, the fraction of mapped and unmapped\n"
+    "records of each biotype by mapping status and target status are written to\n"
+    "outDir/base.{gene,trans}.biotype-{mapstatus,targetstatus}.matrix.\n\n"
+    "Options:\n"
+    "  --help - print this message and exit\n"
+    "  --threads=n - number of files to process at the same time, default 1\n"
+    "Arguments:\n"
+    "  outDir - Output directory, created if it doesn't exist.\n"
+    "  inFile - Mapping info or attrs file, maybe compressed.  The base names\n"
+    "           must be unique.\n"
+    "\n";
+
+const struct option stats_long_options[] = {
+    {"help", 0, NULL, 'h'},
+    {"threads", 1, NULL, 'j'},
+    {NULL, 0, NULL, 0}
+};
+
+/* print stats usage */
+static void prStatsUsage() {
+    cerr << statsUsage << "Version: " << VERSION << " (" << VERSION_HASH <<  ")" << endl;
+}
+
+/* stats subcommand entry.  Parse arguments. */
+static int statsMain(int argc, char *argv[]) {
+    bool help = false;
+    int numThreads = 1;
+    opterr = 0;  // we print error message
+    while (true) {
+        int optc = getopt_long(argc, argv, "", stats_long_options, NULL);
+        if (optc == -1) {
+            break;
+        } else if (optc == 'h') {
+            help = true;
+            break;  // check no more
+        } else if (optc == 'j') {
+            numThreads = parsePositiveIntOpt("--threads", optarg);
+        } else {
+            errAbort(toCharStr("invalid option %s"), argv[optind-1]);
+        }
+    }
+    if (help) {
+        prStatsUsage();
+        return 1;
+    }
+    if ((argc - optind) < 2) {
+        cerr << "wrong # args: ";
+        prStatsUsage();
+        return 1;
+    }
+    StringVector inFiles;
+    for (int i = optind + 1; i < argc; i++) {
+        inFiles.push_back(argv[i]);
+    }
+    try {
+        mappingStatsFiles(inFiles, argv[optind], numThreads);
+    } catch (const exception& ex) {
+        cerr << "Error: " << ex.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
 /* Entry point.  Parse arguments. */
 int main(int argc, char *argv[]) {
+    if ((argc > 1) and (string(argv[1]) == "lift")) {
+        return liftMain(argc-1, argv+1);
+    }
+    if ((argc > 1) and (string(argv[1]) == "mapInfoToTsv")) {
+        return mapInfoToTsvMain(argc-1, argv+1);
+    }
+    if ((argc > 1) and (string(argv[1]) == "stats")) {
+        return statsMain(argc-1, argv+1);
+    }
     bool swapMap = false;
+    StringVector composeMappingAligns;
+    int prunePadding = -1;
+    int pruneMinScore = 0;
+    int pruneMinSize = 0;
     bool help = false;
     unsigned useTargetFlags = 0;
     string unmappedGxfFile;
@@ -176,10 +647,16 @@ int main(int argc, char *argv[]) {
     string targetPatchBed;
     string headerFile;
     string previousMappedGxf;
+    string previousSrcGxf;
     string transcriptPsls;
+    string cacheDir;
+    string mappingInfoBin;
+    string socketPath;
     string substituteMissingTargetVersion;
     ParIdHackMethod parIdHackMethod = PAR_ID_HACK_NEW;
     bool onlyManualForTargetSubstituteOverlap = false;
+    int numThreads = 1;
+    int minParallelTranscripts = GeneMapper::DEFAULT_MIN_PARALLEL_TRANSCRIPTS;
     opterr = 0;  // we print error message
     while (true) {
         int optc = getopt_long(argc, argv, short_options, long_options, NULL);
@@ -192,6 +669,14 @@ int main(int argc, char *argv[]) {
             gVerbose = true;
         } else if (optc == 's') {
             swapMap = true;
+        } else if (optc == 'K') {
+            composeMappingAligns.push_back(optarg);
+        } else if (optc == 'G') {
+            prunePadding = parseNonNegativeIntOpt("--pruneMappingAligns", optarg);
+        } else if (optc == 'g') {
+            pruneMinScore = parseNonNegativeIntOpt("--pruneMinScore", optarg);
+        } else if (optc == 'z') {
+            pruneMinSize = parseNonNegativeIntOpt("--pruneMinSize", optarg);
         } else if (optc == 'U') {
             unmappedGxfFile = string(optarg);
         } else if (optc == 't') {
@@ -203,8 +688,14 @@ int main(int argc, char *argv[]) {
             headerFile = string(optarg);
         } else if (optc == 'M') {
             previousMappedGxf = string(optarg);
+        } else if (optc == 'S') {
+            previousSrcGxf = string(optarg);
         } else if (optc == 'p') {
             transcriptPsls = string(optarg);
+        } else if (optc == 'C') {
+            cacheDir = string(optarg);
+        } else if (optc == 'B') {
+            mappingInfoBin = string(optarg);
         } else if (optc == 'm') {
             substituteMissingTargetVersion = string(optarg);
         } else if (optc == 'O') {
@@ -217,6 +708,12 @@ int main(int argc, char *argv[]) {
             useTargetFlags |= GeneMapper::useTargetForPseudoGenes;
         } else if (optc == 'Q') {
             parIdHackMethod = PAR_ID_HACK_OLD;
+        } else if (optc == 'R') {
+            socketPath = string(optarg);
+        } else if (optc == 'j') {
+            numThreads = parsePositiveIntOpt("--threads", optarg);
+        } else if (optc == 'L') {
+            minParallelTranscripts = parsePositiveIntOpt("--minParallelTranscripts", optarg);
         } else {
             errAbort(toCharStr("invalid option %s"), argv[optind-1]);
         }
@@ -228,6 +725,27 @@ int main(int argc, char *argv[]) {
     }
 
     int nposargs = (argc - optind);
+    if ((socketPath.size() > 0) and ((prunePadding >= 0) or (pruneMinScore > 0) or (pruneMinSize > 0))) {
+        errAbort(toCharStr("--pruneMappingAligns, --pruneMinScore, and --pruneMinSize can't be used with --serve"));
+    }
+    if (socketPath.size() > 0) {
+        if (nposargs != 1) {
+            cerr << "wrong # args: ";
+            prUsage();
+            return 1;
+        }
+        try {
+            gencodeBackmapServe(socketPath, argv[optind], composeMappingAligns, swapMap,
+                                substituteMissingTargetVersion, useTargetFlags,
+                                onlyManualForTargetSubstituteOverlap, parIdHackMethod,
+                                targetGxf, targetPatchBed, previousMappedGxf, cacheDir,
+                                numThreads);
+        } catch (const exception& ex) {
+            cerr << "Error: " << ex.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
     if ((nposargs < 3) or (nposargs > 4)) {
         cerr << "wrong # args: ";
         prUsage();
@@ -238,18 +756,23 @@ int main(int argc, char *argv[]) {
     string mappedGxfFile = argv[optind+2];
     string mappingInfoTsv = (nposargs > 3) ? argv[optind+3] : "";
 
+    if ((previousSrcGxf.size() > 0) and (previousMappedGxf.size() == 0)) {
+        errAbort(toCharStr("--previousSrcGxf requires --previousMappedGxf"));
+    }
     if (not checkGxfFormats(inGxfFile, mappedGxfFile, unmappedGxfFile,
-                            targetGxf, previousMappedGxf)) {
+                            targetGxf, previousMappedGxf, previousSrcGxf)) {
         return 1;
     }
     
     try {
-        gencodeBackmap(inGxfFile, mappingAligns, swapMap,
+        gencodeBackmap(inGxfFile, mappingAligns, composeMappingAligns, swapMap,
+                       prunePadding, pruneMinScore, pruneMinSize,
                        substituteMissingTargetVersion, useTargetFlags,
                        onlyManualForTargetSubstituteOverlap, parIdHackMethod,
                        headerFile, mappedGxfFile, unmappedGxfFile,
-                       mappingInfoTsv, targetGxf, targetPatchBed, previousMappedGxf,
-                       transcriptPsls);
+                       mappingInfoTsv, mappingInfoBin, targetGxf, targetPatchBed, previousMappedGxf,
+                       previousSrcGxf, transcriptPsls, cacheDir, numThreads,
+                       minParallelTranscripts);
     } catch (const exception& ex) {
         cerr << "Error: " << ex.what() << endl;
         return 1;
@@ -7,33 +7,21 @@
 #include <iostream>
 #include <stdexcept>
 #include "transcriptMapper.hh"
+#include "exonProjectionCache.hh"
 #include "annotationSet.hh"
 #include "featureTreePolish.hh"
 #include "globals.hh"
 #include "gxfIO.hh"
+#include "resultFeaturesCache.hh"
+#include "mappingInfo.hh"
+#include <sstream>
+#include <thread>
+#include <atomic>
 
 
 /* fraction of gene expansion that causes a rejection */
 const float geneExpansionThreshold = 0.50;
 
-/*  mapinfo TSV headers, terminated by NULL */
-static const char* mappingInfoHeaders[] = {
-    "geneNum", "recType", "featType",
-    "featId", "featOttId", "featName", "featBiotype", "featChrom", "featStart", "featEnd", "featStrand",
-    "mappingStatus", "mappingCount", "targetStatus", NULL
-};
-
-/* output info TSV header */
-void GeneMapper::outputInfoHeader(ostream& mappingInfoFh) const {
-    for (int i = 0; mappingInfoHeaders[i] != NULL; i++) {
-        if (i > 0) {
-            mappingInfoFh << "\t";
-        }
-        mappingInfoFh << mappingInfoHeaders[i];
-    }
-    mappingInfoFh << endl;
-}
-
 /* output info record */
 void GeneMapper::outputInfo(const string& recType,
                             const string& featType,
@@ -41,29 +29,16 @@ void GeneMapper::outputInfo(const string& recType,
                             RemapStatus mappingStatus,
                             int mappingCount,
                             TargetStatus targetStatus,
-                            ostream& mappingInfoFh) const {
-    mappingInfoFh << fCurrentGeneNum << "\t"
-                  << recType << "\t"
-                  << featType << "\t"
-                  << feature->getTypeId() << "\t"
-                  << feature->getHavanaTypeId() << "\t"
-                  << feature->getTypeName() << "\t"
-                  << feature->getTypeBiotype() << "\t"
-                  << feature->getSeqid() << "\t"
-                  << feature->getStart() << "\t"
-                  << feature->getEnd() << "\t"
-                  << feature->getStrand() << "\t"
-                  << remapStatusToStr(mappingStatus) << "\t"
-                  << mappingCount << "\t"
-                  << targetStatusToStr(targetStatus)
-                  << endl;
+                            MappingInfoWriter& mappingInfoFh) const {
+    mappingInfoFh.write(MappingInfo(fCurrentGeneNum, recType, featType, feature,
+                                    mappingStatus, mappingCount, targetStatus));
 }
 
 /*
  * Output information about source gene that was  mapped or failed mapping.
  */
 void GeneMapper::outputSrcGeneInfo(const ResultFeatures* mappedGene,
-                                   ostream& mappingInfoFh) const {
+                                   MappingInfoWriter& mappingInfoFh) const {
     assert(mappedGene->src != NULL);
     const Feature* srcGene = mappedGene->src;
     outputInfo("mapSrc", "gene", srcGene, srcGene->getRemapStatus(), 0, srcGene->getTargetStatus(), mappingInfoFh);
@@ -77,7 +52,7 @@ void GeneMapper::outputSrcGeneInfo(const ResultFeatures* mappedGene,
  * Output information about gene that was mapped or partially mapped.
  */
 void GeneMapper::outputMappedGeneInfo(const ResultFeatures* mappedGene,
-                                      ostream& mappingInfoFh) const {
+                                      MappingInfoWriter& mappingInfoFh) const {
     assert(mappedGene->src != NULL);
     // not all transcripts maybe not be mapped
     const Feature* mapGene = mappedGene->mapped;
@@ -94,7 +69,7 @@ void GeneMapper::outputMappedGeneInfo(const ResultFeatures* mappedGene,
  * Output information about gene that was unmapped or partially unmapped.
  */
 void GeneMapper::outputUnmappedGeneInfo(const ResultFeatures* mappedGene,
-                                        ostream& mappingInfoFh) const {
+                                        MappingInfoWriter& mappingInfoFh) const {
     assert(mappedGene->src != NULL);
     // not all transcripts maybe not be mapped
     const Feature* unmapGene = mappedGene->unmapped;
@@ -112,7 +87,7 @@ void GeneMapper::outputUnmappedGeneInfo(const ResultFeatures* mappedGene,
  */
 void GeneMapper::outputTargetGeneInfo(const ResultFeatures* mappedGene,
                                       const string& targetAction,
-                                      ostream& mappingInfoFh) const {
+                                      MappingInfoWriter& mappingInfoFh) const {
     const Feature* targetGene = mappedGene->target;
     outputInfo(targetAction, "gene", targetGene, targetGene->getRemapStatus(), 0, targetGene->getTargetStatus(), mappingInfoFh);
     for (int i = 0; i < targetGene->getChildren().size(); i++) {
@@ -134,11 +109,12 @@ bool GeneMapper::isSrcSeqInMapping(const Feature* feature) const {
 
 void GeneMapper::debugRecordMapped(const Feature* feature,
                                    const string& desc,
-                                   const string& key) const {
+                                   const string& key,
+                                   bool keyIsBaseId) const {
     if (gVerbose) {
         cerr << desc << " " << featureDesc(feature);
         if (key != "") {
-            cerr << " key: " << key;
+            cerr << " key: " << (keyIsBaseId ? getBaseId(key) : key);
         }
         cerr << endl;
     }
@@ -147,19 +123,19 @@ void GeneMapper::debugRecordMapped(const Feature* feature,
 /* record gene and it's transcripts as being mapped */
 void GeneMapper::recordGeneMapped(const Feature* gene) {
     assert(gene->isGene());
-    fMappedIdsNames.insert(getBaseId(gene->getTypeId()));
-    debugRecordMapped(gene, "recordGeneMapped typeId", getBaseId(gene->getTypeId()));
+    fMappedIdsNames.insertBaseId(gene->getTypeId());
+    debugRecordMapped(gene, "recordGeneMapped typeId", gene->getTypeId(), true);
     
     // N.B.  Don't use gene name for automatic non-coding, as some small
     // non-coding genes has the same name for multiple instances
     // N.B. gene names with `.' are not always a version
     if (not gene->isAutomaticSmallNonCodingGene()) {
         fMappedIdsNames.insert(gene->getTypeName());
-        debugRecordMapped(gene, "recordGeneMapped typeName", getBaseId(gene->getTypeName()));
+        debugRecordMapped(gene, "recordGeneMapped typeName", gene->getTypeName(), true);
     }
     if (gene->getHavanaTypeId() != "") {
-        fMappedIdsNames.insert(getBaseId(gene->getHavanaTypeId()));
-        debugRecordMapped(gene, "recordGeneMapped havanaTypeId", getBaseId(gene->getHavanaTypeId()));
+        fMappedIdsNames.insertBaseId(gene->getHavanaTypeId());
+        debugRecordMapped(gene, "recordGeneMapped havanaTypeId", gene->getHavanaTypeId(), true);
     }
 
     for (size_t i = 0; i < gene->getChildren().size(); i++) {
@@ -171,11 +147,11 @@ void GeneMapper::recordGeneMapped(const Feature* gene) {
 /* record transcript as being mapped */
 void GeneMapper::recordTranscriptMapped(const Feature* transcript) {
     assert(transcript->isTranscript());
-    fMappedIdsNames.insert(getBaseId(transcript->getTypeId()));
-    debugRecordMapped(transcript, "recordTranscriptMapped typeId", getBaseId(transcript->getTypeId()));
+    fMappedIdsNames.insertBaseId(transcript->getTypeId());
+    debugRecordMapped(transcript, "recordTranscriptMapped typeId", transcript->getTypeId(), true);
     if (transcript->getHavanaTypeId() != "") {
-        fMappedIdsNames.insert(getBaseId(transcript->getHavanaTypeId()));
-        debugRecordMapped(transcript, "recordTranscriptMapped havanaTypeId", getBaseId(transcript->getHavanaTypeId()));
+        fMappedIdsNames.insertBaseId(transcript->getHavanaTypeId());
+        debugRecordMapped(transcript, "recordTranscriptMapped havanaTypeId", transcript->getHavanaTypeId(), true);
     }
 }
 
@@ -183,18 +159,18 @@ void GeneMapper::recordTranscriptMapped(const Feature* transcript) {
 /* check if gene have been mapped */
 bool GeneMapper::checkGeneMapped(const Feature* gene) const {
     assert(gene->isGene());
-    if (fMappedIdsNames.find(getBaseId(gene->getTypeId())) != fMappedIdsNames.end()) {
-        debugRecordMapped(gene, "checkGeneMapped found typeId", getBaseId(gene->getTypeId()));
+    if (fMappedIdsNames.containsBaseId(gene->getTypeId())) {
+        debugRecordMapped(gene, "checkGeneMapped found typeId", gene->getTypeId(), true);
         return true;
     }
     if ((not gene->isAutomaticSmallNonCodingGene())
-        and fMappedIdsNames.find(getBaseId(gene->getTypeName())) != fMappedIdsNames.end()) {
+        and fMappedIdsNames.containsBaseId(gene->getTypeName())) {
         debugRecordMapped(gene, "checkGeneMapped found typeName", gene->getTypeName());
         return true;
 
     }
     if (gene->getHavanaTypeId() != "") {
-        if (fMappedIdsNames.find(getBaseId(gene->getHavanaTypeId())) != fMappedIdsNames.end()) {
+        if (fMappedIdsNames.containsBaseId(gene->getHavanaTypeId())) {
             debugRecordMapped(gene, "checkGeneMapped found havanaTypeId", gene->getHavanaTypeId());
             return true;
         }
@@ -206,8 +182,8 @@ bool GeneMapper::checkGeneMapped(const Feature* gene) const {
 /* check if transcript have already been mapped */
 bool GeneMapper::checkTranscriptMapped(const Feature* transcript) const {
     assert(transcript->isTranscript());
-    if (fMappedIdsNames.find(getBaseId(transcript->getTypeId())) != fMappedIdsNames.end()) {
-        debugRecordMapped(transcript, "checkTranscriptMapped found typeId", getBaseId(transcript->getTypeId()));
+    if (fMappedIdsNames.containsBaseId(transcript->getTypeId())) {
+        debugRecordMapped(transcript, "checkTranscriptMapped found typeId", transcript->getTypeId(), true);
         return true;
     }
     return false;
@@ -226,27 +202,170 @@ bool GeneMapper::checkGeneTranscriptsMapped(const Feature* gene) const {
     return true;
 }
 
-/* process one transcript */
+/* map one transcript, sharing exon projections with the other transcripts
+ * of the gene through exonProjectionCache */
 ResultFeatures GeneMapper::processTranscript(const Feature* transcript,
-                                                 ostream* transcriptPslFh) const {
+                                             ExonProjectionCache* exonProjectionCache,
+                                             ostream* transcriptPslFh) const {
     TranscriptMapper transcriptMapper(fGenomeTransMap, transcript, fTargetAnnotations,
-                                      isSrcSeqInMapping(transcript), transcriptPslFh);
-    ResultFeatures mappedTranscript = transcriptMapper.mapTranscriptFeatures(transcript);
-    TargetStatus targetStatus = getTargetAnnotationStatus(&mappedTranscript);
-    mappedTranscript.setTargetStatus(targetStatus);
-    return mappedTranscript;
+                                      isSrcSeqInMapping(transcript), exonProjectionCache,
+                                      transcriptPslFh);
+    return transcriptMapper.mapTranscriptFeatures(transcript);
 }
 
-/* process all transcripts of gene. */
-ResultFeaturesVector GeneMapper::processTranscripts(const Feature* gene,
-                                                    ostream* transcriptPslFh) const {
+/* Reserve up to maxThreads of the additional transcript threads, returning
+ * the number obtained, which maybe zero. */
+int GeneMapper::acquireTranscriptThreads(int maxThreads) const {
+    int idle = fIdleTranscriptThreads.load();
+    int numThreads;
+    do {
+        numThreads = min(idle, maxThreads);
+        if (numThreads <= 0) {
+            return 0;
+        }
+    } while (not fIdleTranscriptThreads.compare_exchange_weak(idle, idle - numThreads));
+    return numThreads;
+}
+
+/* return transcript threads obtained with acquireTranscriptThreads */
+void GeneMapper::releaseTranscriptThreads(int numThreads) const {
+    fIdleTranscriptThreads += numThreads;
+}
+
+/* Map the transcripts of a gene using the calling thread and numHelpers
+ * additional threads. Threads take the next unmapped transcript, so long
+ * transcripts don't delay the others. Each transcript's PSLs are buffered and
+ * written in the original order.  Each thread has its own exon projection
+ * cache. */
+ResultFeaturesVector GeneMapper::parallelMapTranscripts(const Feature* gene,
+                                                        int numHelpers,
+                                                        ostream* transcriptPslFh) const {
+    size_t numTranscripts = gene->getChildren().size();
+    size_t numThreads = numHelpers + 1;
+    vector<ResultFeatures> results(numTranscripts);
+    vector<string> transcriptPsls(numTranscripts);
+    vector<exception_ptr> errors(numThreads);
+    atomic<size_t> nextTranscript(0);
+    auto mapNextTranscripts = [=, &results, &transcriptPsls, &nextTranscript](exception_ptr* error) {
+        try {
+            ExonProjectionCache exonProjectionCache;
+            size_t i;
+            while ((i = nextTranscript++) < numTranscripts) {
+                ostringstream transcriptPslBuf;
+                results[i] = processTranscript(gene->getChild(i), &exonProjectionCache,
+                                               ((transcriptPslFh != NULL) ? &transcriptPslBuf : NULL));
+                transcriptPsls[i] = transcriptPslBuf.str();
+            }
+        } catch (...) {
+            *error = current_exception();
+        }
+    };
+    vector<std::thread> threads;
+    for (size_t iThread = 1; iThread < numThreads; iThread++) {
+        threads.push_back(std::thread(mapNextTranscripts, &errors[iThread]));
+    }
+    mapNextTranscripts(&errors[0]);
+    for (size_t iThread = 0; iThread < threads.size(); iThread++) {
+        threads[iThread].join();
+    }
+    releaseTranscriptThreads(numHelpers);
+    for (size_t iThread = 0; iThread < numThreads; iThread++) {
+        if (errors[iThread] != NULL) {
+            for (size_t i = 0; i < numTranscripts; i++) {
+                results[i].free();
+            }
+            rethrow_exception(errors[iThread]);
+        }
+    }
     ResultFeaturesVector mappedTranscripts;
+    for (size_t i = 0; i < numTranscripts; i++) {
+        if (transcriptPslFh != NULL) {
+            *transcriptPslFh << transcriptPsls[i];
+        }
+        mappedTranscripts.push_back(results[i]);
+    }
+    return mappedTranscripts;
+}
+
+/* map all transcripts of gene.  The alternative transcripts share most
+ * exons, so the projections of the exons are cached for the gene. */
+ResultFeaturesVector GeneMapper::mapTranscripts(const Feature* gene,
+                                                ostream* transcriptPslFh) const {
     for (size_t i = 0; i < gene->getChildren().size(); i++) {
         const Feature* transcript = gene->getChild(i);
         if (transcript->getType() != Feature::TRANSCRIPT) {
             throw logic_error("gene record has child that is not of type transcript: " + transcript->toString());
         }
-        mappedTranscripts.push_back(processTranscript(transcript, transcriptPslFh));
+    }
+    if ((fTranscriptThreads > 1) and (gene->getChildren().size() >= fMinParallelTranscripts)) {
+        int numHelpers = acquireTranscriptThreads(gene->getChildren().size() - 1);
+        if (numHelpers > 0) {
+            return parallelMapTranscripts(gene, numHelpers, transcriptPslFh);
+        }
+    }
+    ExonProjectionCache exonProjectionCache;
+    ResultFeaturesVector mappedTranscripts;
+    for (size_t i = 0; i < gene->getChildren().size(); i++) {
+        mappedTranscripts.push_back(processTranscript(gene->getChild(i), &exonProjectionCache, transcriptPslFh));
+    }
+    return mappedTranscripts;
+}
+
+/* fingerprint of a target annotation used by TranscriptMapper, or a
+ * marker if it doesn't exist */
+HashVal GeneMapper::getTargetFingerprint(const string& id,
+                                         const string& seqid) const {
+    const Feature* targetFeature = (fTargetAnnotations == NULL) ? NULL
+        : fTargetAnnotations->getFeatureById(id, seqid);
+    return (targetFeature == NULL) ? hashInt(-1) : targetFeature->fingerprint();
+}
+
+/* Compute the result cache key for a gene.  This includes everything that
+ * affects the mapping of the transcripts: the source gene tree, the
+ * overlapping mapping alignments, and the target annotations used to
+ * select between multiple mappings. */
+HashVal GeneMapper::getResultCacheKey(const Feature* gene) const {
+    HashVal hv = gene->fingerprint();
+    hv = hashCombine(hv, fGenomeTransMap->getMapAlnsFingerprint(gene->getSeqid(), gene->getStart()-1, gene->getEnd()));
+    hv = hashInt(isSrcSeqInMapping(gene), hv);
+    for (size_t i = 0; i < gene->getChildren().size(); i++) {
+        const Feature* transcript = gene->getChild(i);
+        hv = hashCombine(hv, getTargetFingerprint(transcript->getAttrValue(GxfFeature::GENE_ID_ATTR), transcript->getSeqid()));
+        hv = hashCombine(hv, getTargetFingerprint(transcript->getAttrValue(GxfFeature::TRANSCRIPT_ID_ATTR), transcript->getSeqid()));
+    }
+    return hv;
+}
+
+/* map all transcripts of a gene, using the result cache. The transcript
+ * PSLs are saved in the cache, so they are available on later runs */
+ResultFeaturesVector GeneMapper::cachedMapTranscripts(const Feature* gene,
+                                                      ostream* transcriptPslFh) const {
+    HashVal key = getResultCacheKey(gene);
+    ResultFeaturesVector mappedTranscripts;
+    string transcriptPsls;
+    if (not fResultCache->load(key, gene, mappedTranscripts, transcriptPsls)) {
+        ostringstream transcriptPslBuf;
+        mappedTranscripts = mapTranscripts(gene, &transcriptPslBuf);
+        transcriptPsls = transcriptPslBuf.str();
+        fResultCache->save(key, gene, mappedTranscripts, transcriptPsls);
+    } else if (gVerbose) {
+        cerr << "cachedMapTranscripts: cache hit " << featureDesc(gene) << endl;
+    }
+    if (transcriptPslFh != NULL) {
+        *transcriptPslFh << transcriptPsls;
+    }
+    return mappedTranscripts;
+}
+
+/* process all transcripts of gene. */
+ResultFeaturesVector GeneMapper::processTranscripts(const Feature* gene,
+                                                    ostream* transcriptPslFh) const {
+    ResultFeaturesVector mappedTranscripts = (fResultCache != NULL)
+        ? cachedMapTranscripts(gene, transcriptPslFh)
+        : mapTranscripts(gene, transcriptPslFh);
+    for (size_t i = 0; i < mappedTranscripts.size(); i++) {
+        TargetStatus targetStatus = getTargetAnnotationStatus(&mappedTranscripts[i]);
+        mappedTranscripts[i].setTargetStatus(targetStatus);
     }
     return mappedTranscripts;
 }
@@ -558,16 +677,25 @@ ResultFeatures GeneMapper::buildGeneFeature(const Feature* srcGeneTree,
     return mappedGene;
 }
 
+/* record the mapped or substituted target gene of a finished source gene */
+void GeneMapper::recordSrcGeneMapped(const ResultFeatures& mappedGene) {
+    // either one of target or mapped is saved
+    if (mappedGene.target != NULL) {
+        recordGeneMapped(mappedGene.target);
+    } else if (mappedGene.mapped != NULL) {
+        recordGeneMapped(mappedGene.mapped);
+    }
+}
+
 /* save mapped gene features  */
 void GeneMapper::saveMapped(ResultFeatures& mappedGene,
                             AnnotationSet& mappedSet) {
+    recordSrcGeneMapped(mappedGene);
     // either one of target or mapped is saved
     if (mappedGene.target != NULL) {
-        recordGeneMapped(mappedGene.target);
         mappedSet.addGene(mappedGene.target);
         mappedGene.target = NULL;
     } else if (mappedGene.mapped != NULL) {
-        recordGeneMapped(mappedGene.mapped);
         mappedSet.addGene(mappedGene.mapped);
         mappedGene.mapped = NULL;
     }
@@ -575,7 +703,7 @@ void GeneMapper::saveMapped(ResultFeatures& mappedGene,
 
 /* save unmapped gene features  */
 void GeneMapper::saveUnmapped(ResultFeatures& mappedGene,
-                              AnnotationSet& unmappedSet) {
+                              AnnotationSet& unmappedSet) const {
     if (mappedGene.unmapped) {
         unmappedSet.addGene(mappedGene.unmapped);
         mappedGene.unmapped = NULL;
@@ -640,7 +768,7 @@ const string& GeneMapper::getTargetAnnotationBiotype(const ResultFeatures* mappe
  * Check for and handle problematic cases after mapping gene.
  * return true if gene is ok, false if force to unmapped.
  */
-void GeneMapper::processGeneLevelMapping(ResultFeatures* mappedGene) {
+void GeneMapper::processGeneLevelMapping(ResultFeatures* mappedGene) const {
     if (hasMixedMappedSeqStrand(mappedGene)) {
         forceToUnmappedDueToRemapStatus(mappedGene, REMAP_STATUS_GENE_CONFLICT);
     } else if (hasExcessiveSizeChange(mappedGene)) {
@@ -652,7 +780,7 @@ void GeneMapper::processGeneLevelMapping(ResultFeatures* mappedGene) {
 
 /* set gene-level attributes after all mapping decisions have
  * been made */
-void GeneMapper::setGeneLevelMappingAttributes(ResultFeatures* mappedGene) {
+void GeneMapper::setGeneLevelMappingAttributes(ResultFeatures* mappedGene) const {
     mappedGene->setBoundingFeatureRemapStatus(isSrcSeqInMapping(mappedGene->src));
     mappedGene->rsetRemapStatusAttr();
     mappedGene->setNumMappingsAttr();
@@ -660,35 +788,110 @@ void GeneMapper::setGeneLevelMappingAttributes(ResultFeatures* mappedGene) {
 }
 
 /*
- * map and output one gene's annotations
+ * map one gene's annotations, returning the results, which are owned by the
+ * caller.  Polishing, mapping info output, and target substitution are
+ * done later.
  */
-void GeneMapper::mapGene(const Feature* srcGeneTree,
-                         AnnotationSet& mappedSet,
-                         AnnotationSet& unmappedSet,
-                         FeatureTreePolish& featureTreePolish,
-                         ostream& mappingInfoFh,
-                         ostream* transcriptPslFh) {
+ResultFeatures GeneMapper::mapGene(const Feature* srcGeneTree,
+                                   ostream* transcriptPslFh) const {
     ResultFeaturesVector mappedTranscripts = processTranscripts(srcGeneTree, transcriptPslFh);
     ResultFeatures mappedGene = buildGeneFeature(srcGeneTree, mappedTranscripts);
     setGeneLevelMappingAttributes(&mappedGene);
     processGeneLevelMapping(&mappedGene);
-    outputSrcGeneInfo(&mappedGene, mappingInfoFh);
+    return mappedGene;
+}
+
+/* Is the source gene identical to the gene in the previous source release?
+ * The complete subtree, including the gene id version, must be the same. */
+bool GeneMapper::isSrcGeneUnchanged(const Feature* srcGene) const {
+    const Feature* prevSrcGene = fPreviousSrcAnnotations->getFeatureById(srcGene->getTypeId(),
+                                                                          srcGene->getSeqid());
+    return (prevSrcGene != NULL)
+        and (prevSrcGene->getTypeId() == srcGene->getTypeId())
+        and (prevSrcGene->getSeqid() == srcGene->getSeqid())
+        and (prevSrcGene->fingerprint() == srcGene->fingerprint());
+}
 
-    // must be done after forcing status above
-    if (mappedGene.mapped == NULL) {
-        outputUnmappedGeneInfo(&mappedGene, mappingInfoFh);
-        if (shouldSubstituteTarget(&mappedGene)) {
-            substituteTarget(&mappedGene);
-            outputTargetGeneInfo(&mappedGene, "targetSubst", mappingInfoFh);
+/* find the previous mapping of a source transcript in a previous mapped gene,
+ * or NULL if it was not mapped */
+const Feature* GeneMapper::findPrevMappedTranscript(const Feature* prevMappedGene,
+                                                    const Feature* srcTranscript) const {
+    for (int i = 0; i < prevMappedGene->getChildren().size(); i++) {
+        const Feature* prevMappedTranscript = prevMappedGene->getChild(i);
+        if (getPreMappedId(prevMappedTranscript->getTypeId()) == srcTranscript->getTypeId()) {
+            return prevMappedTranscript;
         }
     }
-    if (mappedGene.mapped != NULL) {
-        featureTreePolish.polishGene(mappedGene.mapped);
-        outputMappedGeneInfo(&mappedGene, mappingInfoFh);  // MUST do before saveGene, as it moved to output sets
+    return NULL;
+}
+
+/* Check that target status recomputed against the current target annotations
+ * matches the status save in a previous mapping. */
+bool GeneMapper::checkPrevMappedTargetStatus(const Feature* srcFeature,
+                                             Feature* prevMappedFeature) const {
+    ResultFeatures prevResult(srcFeature, prevMappedFeature);
+    return getTargetAnnotationStatus(&prevResult) == prevMappedFeature->getTargetStatus();
+}
+
+/* was a previously mapped gene or transcript completely mapped? */
+bool GeneMapper::isPrevMappedFull(const Feature* prevMappedFeature) {
+    return (prevMappedFeature->getRemapStatus() == REMAP_STATUS_FULL_CONTIG)
+        or (prevMappedFeature->getRemapStatus() == REMAP_STATUS_FULL_FRAGMENT);
+}
+
+/* Check if a previous mapping of a unchanged source gene can be used as-is.
+ * It must be a complete mapping of the gene and all transcripts, as the
+ * previous unmapped features are not available, and the target status must
+ * not have changed. */
+bool GeneMapper::checkPrevMappedGeneReusable(const Feature* srcGene,
+                                             Feature* prevMappedGene) const {
+    if ((prevMappedGene->findAttr(ATTR_REMAP_STATUS) == NULL)
+        or (prevMappedGene->findAttr(ATTR_REMAP_SUBSTITUTED_MISSING_TARGET) != NULL)
+        or (not isPrevMappedFull(prevMappedGene))
+        or (prevMappedGene->getChildren().size() != srcGene->getChildren().size())) {
+        return false;
     }
-    saveMapped(mappedGene, mappedSet);
-    saveUnmapped(mappedGene, unmappedSet);
-    mappedGene.free();
+    if (not checkPrevMappedTargetStatus(srcGene, prevMappedGene)) {
+        return false;
+    }
+    for (int i = 0; i < srcGene->getChildren().size(); i++) {
+        const Feature* srcTranscript = srcGene->getChild(i);
+        const Feature* prevMappedTranscript = findPrevMappedTranscript(prevMappedGene, srcTranscript);
+        if ((prevMappedTranscript == NULL)
+            or (not isPrevMappedFull(prevMappedTranscript))
+            or (not checkPrevMappedTargetStatus(srcTranscript, const_cast<Feature*>(prevMappedTranscript)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Release-delta mode: if source gene is unchanged from the previous release,
+ * copy the previous mapping, including mapping versions, rather than
+ * remapping.  Return false if the gene must be mapped.
+ */
+bool GeneMapper::copyPrevMappedGene(const Feature* srcGeneTree,
+                                    ResultFeatures& mappedGene) const {
+    if (not isSrcGeneUnchanged(srcGeneTree)) {
+        return false;
+    }
+    const Feature* prevMappedGene = fPreviousMappedAnotations->getFeatureById(srcGeneTree->getTypeId(),
+                                                                              srcGeneTree->getSeqid());
+    if ((prevMappedGene == NULL) or (not prevMappedGene->isGene())) {
+        return false;
+    }
+    Feature* prevMappedGeneCopy = prevMappedGene->cloneTree();
+    prevMappedGeneCopy->rsetStatusFromAttrs();
+    if (not checkPrevMappedGeneReusable(srcGeneTree, prevMappedGeneCopy)) {
+        delete prevMappedGeneCopy;
+        return false;
+    }
+    mappedGene.mapped = prevMappedGeneCopy;
+    if (gVerbose) {
+        cerr << "copyPrevMappedGene: " << featureDesc(srcGeneTree) << endl;
+    }
+    return true;
 }
 
 /* determine if this is a gene type that should not be mapped, returning
@@ -713,7 +916,7 @@ bool GeneMapper::shouldMapGeneType(const Feature* gene) const {
 }
 
 /* is target gene in patch region? */
-bool GeneMapper::inTargetPatchRegion(const Feature* targetGene) {
+bool GeneMapper::inTargetPatchRegion(const Feature* targetGene) const {
     return fTargetPatchMap->anyOverlap(targetGene->getSeqid(),
                                        targetGene->getStart(),
                                        targetGene->getEnd());
@@ -722,7 +925,7 @@ bool GeneMapper::inTargetPatchRegion(const Feature* targetGene) {
 /* check to see if the target overlaps a mapped gene with sufficient similarity to
  * be considered the same annotation..  */
 bool GeneMapper::checkTargetOverlappingMapped(const Feature* targetGene,
-                                              AnnotationSet& mappedSet) {
+                                              AnnotationSet& mappedSet) const {
     static const float minSimilarity = 0.5;
     FeatureVector overlapping = mappedSet.findOverlappingGenes(targetGene, minSimilarity,
                                                                fOnlyManualForTargetSubstituteOverlap);
@@ -733,7 +936,7 @@ bool GeneMapper::checkTargetOverlappingMapped(const Feature* targetGene,
  * Check if a target gene should be copied.
  */
 bool GeneMapper::shouldIncludeTargetGene(const Feature* targetGene,
-                                         AnnotationSet& mappedSet)  {
+                                         AnnotationSet& mappedSet) const {
     if (gVerbose) {
         cerr << "shouldIncludeTargetGene: " << featureDesc(targetGene)
              << " noMapRemapStatus: " << remapStatusToStr(getNoMapRemapStatus(targetGene))
@@ -767,7 +970,7 @@ bool GeneMapper::shouldIncludeTargetGene(const Feature* targetGene,
  */
 void GeneMapper::copyTargetGene(const Feature* targetGene,
                                 AnnotationSet& mappedSet,
-                                ostream& mappingInfoFh) {
+                                MappingInfoWriter& mappingInfoFh) {
     if (gVerbose) {
         cerr << "copyTargetGene " << featureDesc(targetGene) << endl;
     }
@@ -783,44 +986,167 @@ void GeneMapper::copyTargetGene(const Feature* targetGene,
 }
 
 /*
- * copy target annotations that are skipped for mapping
+ * Check which target genes should be copied given the current mapped set,
+ * using multiple threads if requested.  Neither the mapped set nor the
+ * mapped ids are modified while this runs.
+ */
+void GeneMapper::findTargetGeneCandidates(const FeatureVector& targetGenes,
+                                          AnnotationSet& mappedSet,
+                                          vector<char>& isCandidate) const {
+    isCandidate.assign(targetGenes.size(), false);
+    size_t numThreads = min(size_t(max(fCopyTargetThreads, 1)), targetGenes.size());
+    if (numThreads <= 1) {
+        for (size_t iGene = 0; iGene < targetGenes.size(); iGene++) {
+            isCandidate[iGene] = shouldIncludeTargetGene(targetGenes[iGene], mappedSet);
+        }
+        return;
+    }
+    vector<exception_ptr> errors(numThreads);
+    atomic<size_t> nextGene(0);
+    vector<std::thread> threads;
+    for (size_t iThread = 0; iThread < numThreads; iThread++) {
+        exception_ptr* error = &errors[iThread];
+        threads.push_back(std::thread([=, &targetGenes, &mappedSet, &isCandidate, &nextGene]() {
+            try {
+                size_t iGene;
+                while ((iGene = nextGene++) < targetGenes.size()) {
+                    isCandidate[iGene] = shouldIncludeTargetGene(targetGenes[iGene], mappedSet);
+                }
+            } catch (...) {
+                *error = current_exception();
+            }
+        }));
+    }
+    for (size_t iThread = 0; iThread < numThreads; iThread++) {
+        threads[iThread].join();
+    }
+    for (size_t iThread = 0; iThread < numThreads; iThread++) {
+        if (errors[iThread] != NULL) {
+            rethrow_exception(errors[iThread]);
+        }
+    }
+}
+
+/*
+ * copy target annotations that are skipped for mapping.  Candidates are
+ * found against the mapped set before any targets are copied.  Copying a
+ * gene only adds to the mapped set and mapped ids, which can only cause a
+ * later gene to be rejected, never included.  So the candidates are then
+ * checked again in order, after the first copy, giving the same results as
+ * checking each gene sequentially.
  */
 void GeneMapper::copyTargetGenes(AnnotationSet& mappedSet,
-                                 ostream& mappingInfoFh) {
+                                 MappingInfoWriter& mappingInfoFh) {
     const FeatureVector& genes = fTargetAnnotations->getGenes();
+    vector<char> isCandidate;
+    findTargetGeneCandidates(genes, mappedSet, isCandidate);
+    bool anyCopied = false;
     for (int iGene = 0; iGene < genes.size(); iGene++) {
-        if (shouldIncludeTargetGene(genes[iGene], mappedSet)) {
+        if (isCandidate[iGene]
+            and ((not anyCopied) or shouldIncludeTargetGene(genes[iGene], mappedSet))) {
             fCurrentGeneNum++;
             copyTargetGene(genes[iGene], mappedSet, mappingInfoFh);
+            anyCopied = true;
         }
     }
 }
 
-/* Map a GFF3/GTF */
-void GeneMapper::mapGxf(GxfWriter& mappedGxfFh,
-                        GxfWriter* unmappedGxfFh,
-                        ostream& mappingInfoFh,
-                        ostream* transcriptPslFh) {
-    AnnotationSet mappedSet(&fGenomeTransMap->fTargetSizes);
-    AnnotationSet unmappedSet(&fGenomeTransMap->fQuerySizes);
-    FeatureTreePolish featureTreePolish(fPreviousMappedAnotations);
-    
-    const FeatureVector& srcGenes = fSrcAnnotations->getGenes();
-    outputInfoHeader(mappingInfoFh);
-    for (int i = 0; i < srcGenes.size(); i++) {
-        if (gVerbose) {
-            cerr << endl << "mapGxf: " << featureDesc(srcGenes[i])
-                 << " shouldMapGeneType: " << shouldMapGeneType(srcGenes[i])
-                 << " noMapRemapStatus: " << remapStatusToStr(getNoMapRemapStatus(srcGenes[i]))
-                 << " " << srcGenes[i]->getTypeId() << " " << srcGenes[i]->getSource()
-                 << endl;
+/* Estimate the relative cost of mapping a source gene.  Genes that are
+ * not mapped have a minimal cost. */
+long GeneMapper::estimateMapCost(const Feature* srcGene) const {
+    if (not shouldMapGeneType(srcGene)) {
+        return 1;
+    }
+    long numFeatures = 1;
+    for (size_t i = 0; i < srcGene->getChildren().size(); i++) {
+        const Feature* transcript = srcGene->getChild(i);
+        numFeatures++;
+        for (size_t j = 0; j < transcript->getChildren().size(); j++) {
+            if (transcript->getChild(j)->isExon()) {
+                numFeatures++;
+            }
         }
-        if (shouldMapGeneType(srcGenes[i])) {
-            fCurrentGeneNum++;
-            mapGene(srcGenes[i], mappedSet, unmappedSet, featureTreePolish, mappingInfoFh, transcriptPslFh);
+    }
+    int numMapAlns = fGenomeTransMap->countMapAlns(srcGene->getSeqid(), srcGene->getStart() - 1,
+                                                   srcGene->getEnd());
+    return numFeatures * max(1, numMapAlns);
+}
+
+/* First step of mapping a source gene, mapping transcripts and doing
+ * gene-level checks.  Doesn't modify the mapper, so it is thread-safe. */
+GeneMapper::SrcGeneDisposition GeneMapper::mapSrcGeneFeatures(const Feature* srcGene,
+                                                              ResultFeatures& mappedGene,
+                                                              ostream* transcriptPslFh) const {
+    if (gVerbose) {
+        cerr << endl << "mapSrcGene: " << featureDesc(srcGene)
+             << " shouldMapGeneType: " << shouldMapGeneType(srcGene)
+             << " noMapRemapStatus: " << remapStatusToStr(getNoMapRemapStatus(srcGene))
+             << " " << srcGene->getTypeId() << " " << srcGene->getSource()
+             << endl;
+    }
+    mappedGene = ResultFeatures(srcGene);
+    if (not shouldMapGeneType(srcGene)) {
+        return SRC_GENE_SKIPPED;
+    }
+    if ((fPreviousSrcAnnotations != NULL) and copyPrevMappedGene(srcGene, mappedGene)) {
+        return SRC_GENE_PREV_COPIED;
+    }
+    mappedGene = mapGene(srcGene, transcriptPslFh);
+    return SRC_GENE_MAPPED;
+}
+
+/* Second step of mapping a source gene, assigning mapping versions.  Only
+ * newly mapped genes are polished, substituted targets are not. */
+void GeneMapper::polishSrcGene(ResultFeatures& mappedGene,
+                               SrcGeneDisposition disposition,
+                               const FeatureTreePolish& featureTreePolish) const {
+    if ((disposition == SRC_GENE_MAPPED) and (mappedGene.mapped != NULL)) {
+        featureTreePolish.polishGene(mappedGene.mapped);
+    }
+}
+
+/* Final step of mapping a source gene, output of mapping info and target
+ * substitution.  Must be called in source gene order. */
+void GeneMapper::finishSrcGene(ResultFeatures& mappedGene,
+                               SrcGeneDisposition disposition,
+                               MappingInfoWriter& mappingInfoFh) {
+    if (disposition == SRC_GENE_SKIPPED) {
+        return;
+    }
+    fCurrentGeneNum++;
+    outputSrcGeneInfo(&mappedGene, mappingInfoFh);
+    if (disposition == SRC_GENE_MAPPED) {
+        // must be done after forcing status in mapGene
+        if (mappedGene.mapped == NULL) {
+            outputUnmappedGeneInfo(&mappedGene, mappingInfoFh);
+            if (shouldSubstituteTarget(&mappedGene)) {
+                substituteTarget(&mappedGene);
+                outputTargetGeneInfo(&mappedGene, "targetSubst", mappingInfoFh);
+            }
         }
     }
-    if ((fUseTargetFlags != 0) and (fTargetAnnotations != NULL)) {
+    if (mappedGene.mapped != NULL) {
+        outputMappedGeneInfo(&mappedGene, mappingInfoFh);
+    }
+}
+
+/* Move the features of a finished gene to the mapped and unmapped sets */
+void GeneMapper::saveSrcGene(ResultFeatures& mappedGene,
+                             AnnotationSet& mappedSet,
+                             AnnotationSet& unmappedSet) {
+    saveMapped(mappedGene, mappedSet);
+    saveUnmapped(mappedGene, unmappedSet);
+}
+
+/* After all source genes are finished, optionally copy target genes, then
+ * sort and write the mapped and unmapped sets. */
+void GeneMapper::writeGxf(bool copyTargets,
+                          AnnotationSet& mappedSet,
+                          AnnotationSet& unmappedSet,
+                          GxfWriter& mappedGxfFh,
+                          GxfWriter* unmappedGxfFh,
+                          MappingInfoWriter& mappingInfoFh) {
+    if (copyTargets and (fUseTargetFlags != 0) and (fTargetAnnotations != NULL)) {
         copyTargetGenes(mappedSet, mappingInfoFh);
     }
     mappedSet.sort();
@@ -831,3 +1157,44 @@ void GeneMapper::mapGxf(GxfWriter& mappedGxfFh,
     }
 }
 
+/* Map a source gene, returning the mapped, unmapped, or substituted target
+ * features, which are owned by the caller. */
+ResultFeatures GeneMapper::mapSrcGene(const Feature* srcGene,
+                                      const FeatureTreePolish& featureTreePolish,
+                                      MappingInfoWriter& mappingInfoFh,
+                                      ostream* transcriptPslFh) {
+    ResultFeatures mappedGene;
+    SrcGeneDisposition disposition = mapSrcGeneFeatures(srcGene, mappedGene, transcriptPslFh);
+    polishSrcGene(mappedGene, disposition, featureTreePolish);
+    finishSrcGene(mappedGene, disposition, mappingInfoFh);
+    return mappedGene;
+}
+
+/* Map a GFF3/GTF */
+void GeneMapper::mapGxf(GxfWriter& mappedGxfFh,
+                        GxfWriter* unmappedGxfFh,
+                        MappingInfoWriter& mappingInfoFh,
+                        ostream* transcriptPslFh) {
+    FeatureTreePolish featureTreePolish(fPreviousMappedAnotations);
+    mapGxf(featureTreePolish, true, mappedGxfFh, unmappedGxfFh, mappingInfoFh, transcriptPslFh);
+}
+
+/* Map a GFF3/GTF using a FeatureTreePolish object that is kept between
+ * calls. */
+void GeneMapper::mapGxf(const FeatureTreePolish& featureTreePolish,
+                        bool copyTargets,
+                        GxfWriter& mappedGxfFh,
+                        GxfWriter* unmappedGxfFh,
+                        MappingInfoWriter& mappingInfoFh,
+                        ostream* transcriptPslFh) {
+    AnnotationSet mappedSet(&fGenomeTransMap->fTargetSizes);
+    AnnotationSet unmappedSet(&fGenomeTransMap->fQuerySizes);
+    
+    const FeatureVector& srcGenes = fSrcAnnotations->getGenes();
+    for (int i = 0; i < srcGenes.size(); i++) {
+        ResultFeatures mappedGene = mapSrcGene(srcGenes[i], featureTreePolish, mappingInfoFh, transcriptPslFh);
+        saveSrcGene(mappedGene, mappedSet, unmappedSet);
+        mappedGene.free();
+    }
+    writeGxf(copyTargets, mappedSet, unmappedSet, mappedGxfFh, unmappedGxfFh, mappingInfoFh);
+}
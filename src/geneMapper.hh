@@ -7,7 +7,9 @@
 #include "feature.hh"
 #include "typeOps.hh"
 #include "resultFeatures.hh"
+#include "concurrentIdSet.hh"
 #include <set>
+#include <atomic>
 class TransMap;
 class PslMapping;
 struct psl;
@@ -16,6 +18,9 @@ class AnnotationSet;
 class BedMap;
 class FeatureTreePolish;
 class GxfWriter;
+class ResultFeaturesCache;
+class MappingInfoWriter;
+class ExonProjectionCache;
 
 /* class that maps a gene to the new assemble */
 class GeneMapper {
@@ -32,7 +37,9 @@ class GeneMapper {
     const TransMap* fGenomeTransMap;  // genomic mapping
     const AnnotationSet* fTargetAnnotations; // targeted genes/transcripts, maybe NULL
     const AnnotationSet* fPreviousMappedAnotations; // previous version
+    const AnnotationSet* fPreviousSrcAnnotations; // source of previous version, maybe NULL
     const BedMap* fTargetPatchMap; // location of patch regions in target genome
+    const ResultFeaturesCache* fResultCache; // cache of transcript results, maybe NULL
     const string fSubstituteTargetVersion;  // pass through targets when gene new gene doesn't map
     unsigned fUseTargetFlags;  // what targets to force.
     bool fOnlyManualForTargetSubstituteOverlap;  // only check manual transcripts when checking target/map overlap
@@ -41,41 +48,64 @@ class GeneMapper {
      * mapped.  Used to prevent output of target genes types that are not being
      * mapped (automatic genes), when type or source changes are already mapped.
      * N.B. Can't use AnnotationSet to track this, due to PAR mappings needing
-     * to be mapped twice. */
-    StringSet fMappedIdsNames;
+     * to be mapped twice.  Safe for updates from multiple threads. */
+    ConcurrentIdSet fMappedIdsNames;
     
     int fCurrentGeneNum;  /* used by output info log to logically group features together,
                            * increments each time a gene is process */ 
+
+    int fTranscriptThreads;  // threads used to map transcripts of large genes
+    size_t fMinParallelTranscripts;  // minimum transcripts in gene to use threads
+
+    /* Number of additional threads that may currently be started to map
+     * transcripts.  This is shared by all genes being mapped, so the total
+     * number of transcript threads is bounded by fTranscriptThreads
+     * no matter how many genes are mapped at the same time. */
+    mutable std::atomic<int> fIdleTranscriptThreads;
+    int fCopyTargetThreads;  // threads used to check target genes to copy
     
-    void outputInfoHeader(ostream& mappingInfoFh) const;
     void outputInfo(const string& recType,
                     const string& featType,
                     const Feature* feature,
                     RemapStatus mappingStatus,
                     int mappingCount,
                     TargetStatus targetStatus,
-                    ostream& mappingInfoFh) const;
+                    MappingInfoWriter& mappingInfoFh) const;
     void outputSrcGeneInfo(const ResultFeatures* mappedGene,
-                           ostream& mappingInfoFh) const;
+                           MappingInfoWriter& mappingInfoFh) const;
     void outputMappedGeneInfo(const ResultFeatures* mappedGene,
-                              ostream& mappingInfoFh) const;
+                              MappingInfoWriter& mappingInfoFh) const;
     void outputUnmappedGeneInfo(const ResultFeatures* mappedGene,
-                                ostream& mappingInfoFh) const;
+                                MappingInfoWriter& mappingInfoFh) const;
     void outputTargetGeneInfo(const ResultFeatures* mappedGene,
                               const string& targetAction,
-                              ostream& mappingInfoFh) const;
+                              MappingInfoWriter& mappingInfoFh) const;
     string featureDesc(const Feature* feature) const;
     bool isSrcSeqInMapping(const Feature* feature) const;
     void debugRecordMapped(const Feature* feature,
                            const string& desc,
-                           const string& key = "") const;
+                           const string& key = "",
+                           bool keyIsBaseId = false) const;
     void recordGeneMapped(const Feature* gene);
     void recordTranscriptMapped(const Feature* transcript);
     bool checkGeneMapped(const Feature* gene) const ;
     bool checkTranscriptMapped(const Feature* transcript) const;
     bool checkGeneTranscriptsMapped(const Feature* gene) const;
     ResultFeatures processTranscript(const Feature* transcript,
+                                     ExonProjectionCache* exonProjectionCache,
                                      ostream* transcriptPslFh) const;
+    int acquireTranscriptThreads(int maxThreads) const;
+    void releaseTranscriptThreads(int numThreads) const;
+    ResultFeaturesVector parallelMapTranscripts(const Feature* gene,
+                                                int numHelpers,
+                                                ostream* transcriptPslFh) const;
+    ResultFeaturesVector mapTranscripts(const Feature* gene,
+                                        ostream* transcriptPslFh) const;
+    HashVal getTargetFingerprint(const string& id,
+                                 const string& seqid) const;
+    HashVal getResultCacheKey(const Feature* gene) const;
+    ResultFeaturesVector cachedMapTranscripts(const Feature* gene,
+                                              ostream* transcriptPslFh) const;
     ResultFeaturesVector processTranscripts(const Feature* gene,
                                             ostream* transcriptPslFh) const;
     Feature* findMatchingBoundingFeature(const FeatureVector& features,
@@ -110,37 +140,55 @@ class GeneMapper {
     void saveMapped(ResultFeatures& mappedGene,
                     AnnotationSet& mappedSet);
     void saveUnmapped(ResultFeatures& mappedGene,
-                      AnnotationSet& unmappedSet);
+                      AnnotationSet& unmappedSet) const;
     const Feature* getTargetAnnotation(const Feature* feature) const;
     TargetStatus getTargetAnnotationStatus(const ResultFeatures* mappedFeature) const;
     const string& getTargetAnnotationBiotype(const ResultFeatures* mappedFeature) const;
-    void processGeneLevelMapping(ResultFeatures* mappedGene);
-    void setGeneLevelMappingAttributes(ResultFeatures* mappedGene);
-    void mapGene(const Feature* srcGeneTree,
-                 AnnotationSet& mappedSet,
-                 AnnotationSet& unmappedSet,
-                 FeatureTreePolish& featureTreePolish,
-                 ostream& mappingInfoFh,
-                 ostream* transcriptPslFh);
+    void processGeneLevelMapping(ResultFeatures* mappedGene) const;
+    void setGeneLevelMappingAttributes(ResultFeatures* mappedGene) const;
+    ResultFeatures mapGene(const Feature* srcGeneTree,
+                           ostream* transcriptPslFh) const;
+    bool isSrcGeneUnchanged(const Feature* srcGene) const;
+    const Feature* findPrevMappedTranscript(const Feature* prevMappedGene,
+                                            const Feature* srcTranscript) const;
+    bool checkPrevMappedTargetStatus(const Feature* srcFeature,
+                                     Feature* prevMappedFeature) const;
+    static bool isPrevMappedFull(const Feature* prevMappedFeature);
+    bool checkPrevMappedGeneReusable(const Feature* srcGene,
+                                     Feature* prevMappedGene) const;
+    bool copyPrevMappedGene(const Feature* srcGeneTree,
+                            ResultFeatures& mappedGene) const;
     RemapStatus getNoMapRemapStatus(const Feature* gene) const;
     bool shouldMapGeneType(const Feature* gene) const;
-    bool inTargetPatchRegion(const Feature* targetGene);
+    bool inTargetPatchRegion(const Feature* targetGene) const;
     bool checkTargetOverlappingMapped(const Feature* targetGene,
-                                      AnnotationSet& mappedSet);
+                                      AnnotationSet& mappedSet) const;
     bool shouldIncludeTargetGene(const Feature* gene,
-                                 AnnotationSet& mappedSet);
+                                 AnnotationSet& mappedSet) const;
+    void findTargetGeneCandidates(const FeatureVector& targetGenes,
+                                  AnnotationSet& mappedSet,
+                                  vector<char>& isCandidate) const;
     void copyTargetGene(const Feature* targetGene,
                         AnnotationSet& mappedSet,
-                        ostream& mappingInfoFh);
+                        MappingInfoWriter& mappingInfoFh);
     void copyTargetGenes(AnnotationSet& mappedSet,
-                         ostream& mappingInfoFh);
+                         MappingInfoWriter& mappingInfoFh);
     public:
+    /* how a source gene was handled by mapSrcGeneFeatures */
+    typedef enum {
+        SRC_GENE_SKIPPED,      // type of gene is not mapped
+        SRC_GENE_PREV_COPIED,  // previous mapping copied
+        SRC_GENE_MAPPED        // mapped
+    } SrcGeneDisposition;
+
     /* Constructor */
     GeneMapper(const AnnotationSet* srcAnnotations,
                const TransMap* genomeTransMap,
                const AnnotationSet* targetAnnotations,
                const AnnotationSet* previousMappedAnnotations,
+               const AnnotationSet* previousSrcAnnotations,
                const BedMap* targetPatchMap,
+               const ResultFeaturesCache* resultCache,
                const string& substituteTargetVersion,
                unsigned useTargetFlags,
                bool onlyManualForTargetSubstituteOverlap):
@@ -148,17 +196,129 @@ class GeneMapper {
         fGenomeTransMap(genomeTransMap),
         fTargetAnnotations(targetAnnotations),
         fPreviousMappedAnotations(previousMappedAnnotations),
+        fPreviousSrcAnnotations(previousSrcAnnotations),
         fTargetPatchMap(targetPatchMap),
+        fResultCache(resultCache),
         fSubstituteTargetVersion(substituteTargetVersion),
         fUseTargetFlags(useTargetFlags),
         fOnlyManualForTargetSubstituteOverlap(onlyManualForTargetSubstituteOverlap),
-        fCurrentGeneNum(-1) {
+        fCurrentGeneNum(-1),
+        fTranscriptThreads(1),
+        fMinParallelTranscripts(0),
+        fIdleTranscriptThreads(0),
+        fCopyTargetThreads(1) {
+    }
+
+    /* default minimum number of transcripts in a gene for them to be
+     * mapped in parallel */
+    static const int DEFAULT_MIN_PARALLEL_TRANSCRIPTS = 32;
+
+    /* Map the transcripts of genes with at least minTranscripts
+     * transcripts using threads.  The calling thread maps transcripts along
+     * with at most numThreads - 1 additional threads, which are shared by
+     * all genes being mapped concurrently.  The results and transcript PSLs
+     * are in the same order as mapping with one thread. */
+    void setTranscriptThreads(int numThreads,
+                              int minTranscripts = DEFAULT_MIN_PARALLEL_TRANSCRIPTS) {
+        fTranscriptThreads = numThreads;
+        fMinParallelTranscripts = minTranscripts;
+        fIdleTranscriptThreads = (numThreads > 1) ? numThreads - 1 : 0;
     }
 
+    /* get the genomic mapping */
+    const TransMap* getGenomeTransMap() const {
+        return fGenomeTransMap;
+    }
+
+    /* Estimate the relative cost of mapping a source gene, used to schedule
+     * the expensive genes first.  This is the number of transcripts and
+     * exons times the number of mapping alignments overlapping the gene. */
+    long estimateMapCost(const Feature* srcGene) const;
+
+    /* First step of mapping a source gene, the transcripts are mapped and the
+     * gene-level checks are done, with results stored in mappedGene.  No
+     * mapping info is written and mapper state is not changed, so this maybe
+     * called from multiple threads.  If transcriptPslFh is not NULL, the
+     * transcript PSLs are written to it. */
+    SrcGeneDisposition mapSrcGeneFeatures(const Feature* srcGene,
+                                          ResultFeatures& mappedGene,
+                                          ostream* transcriptPslFh) const;
+
+    /* Second step of mapping a source gene, assigning mapping versions to a
+     * newly mapped gene.  Maybe called from multiple threads. */
+    void polishSrcGene(ResultFeatures& mappedGene,
+                       SrcGeneDisposition disposition,
+                       const FeatureTreePolish& featureTreePolish) const;
+
+    /* Final step of mapping a source gene, writing mapping info and making
+     * target substitution decisions.  This depends on the genes previously
+     * finished, so it must be called on genes in source order from a single
+     * thread.  If a target substitution could be made (see
+     * needsAllSrcGenes), the complete source annotation set must have been
+     * loaded. */
+    void finishSrcGene(ResultFeatures& mappedGene,
+                       SrcGeneDisposition disposition,
+                       MappingInfoWriter& mappingInfoFh);
+
+    /* Will finishSrcGene need to check for the gene in the complete source
+     * annotation set? */
+    bool needsAllSrcGenes(const ResultFeatures& mappedGene,
+                          SrcGeneDisposition disposition) const {
+        return (disposition == SRC_GENE_MAPPED) and (mappedGene.mapped == NULL)
+            and (fSubstituteTargetVersion.size() > 0);
+    }
+
+    /* Move the features of a finished gene to the mapped and unmapped
+     * sets */
+    void saveSrcGene(ResultFeatures& mappedGene,
+                     AnnotationSet& mappedSet,
+                     AnnotationSet& unmappedSet);
+
+    /* After all source genes are finished, optionally copy target genes,
+     * then sort and write the mapped and unmapped sets. */
+    void writeGxf(bool copyTargets,
+                  AnnotationSet& mappedSet,
+                  AnnotationSet& unmappedSet,
+                  GxfWriter& mappedGxfFh,
+                  GxfWriter* unmappedGxfFh,
+                  MappingInfoWriter& mappingInfoFh);
+
+    /* Use up to numThreads threads to check which target genes should be
+     * copied after mapping.  The target genes copied are the same as with
+     * one thread. */
+    void setCopyTargetThreads(int numThreads) {
+        fCopyTargetThreads = numThreads;
+    }
+
+    /* Record the mapped or substituted target gene of a finished source
+     * gene as mapped, so later target substitution decisions take it into
+     * account.  Done by saveSrcGene, this is for results kept by the
+     * caller. */
+    void recordSrcGeneMapped(const ResultFeatures& mappedGene);
+
+    /* Map a source gene, returning the mapped, unmapped, or substituted
+     * target features, which are owned by the caller.  Genes of types that
+     * are not mapped return results without features.  Target genes
+     * are not copied. */
+    ResultFeatures mapSrcGene(const Feature* srcGene,
+                              const FeatureTreePolish& featureTreePolish,
+                              MappingInfoWriter& mappingInfoFh,
+                              ostream* transcriptPslFh);
+
     /* Map a GFF3/GTF */
     void mapGxf(GxfWriter& mappedGxfFh,
                 GxfWriter* unmappedGxfFh,
-                ostream& mappingInfoFh,
+                MappingInfoWriter& mappingInfoFh,
+                ostream* transcriptPslFh);
+
+    /* Map a GFF3/GTF using a FeatureTreePolish object that is kept between
+     * calls. Target genes are only copied to the output if copyTargets is
+     * true. */
+    void mapGxf(const FeatureTreePolish& featureTreePolish,
+                bool copyTargets,
+                GxfWriter& mappedGxfFh,
+                GxfWriter* unmappedGxfFh,
+                MappingInfoWriter& mappingInfoFh,
                 ostream* transcriptPslFh);
 };
 
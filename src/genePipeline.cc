@@ -0,0 +1,261 @@
+/*
+ * Pipeline of threads for mapping a GxF file.
+ */
+#include "genePipeline.hh"
+#include "annotationSet.hh"
+#include "featureIO.hh"
+#include "transMap.hh"
+#include <sstream>
+
+/* Constructor */
+GenePipeline::GenePipeline(GeneMapper& geneMapper,
+                           const FeatureTreePolish& featureTreePolish,
+                           int numMapThreads,
+                           int numPolishThreads,
+                           size_t maxQueued):
+    fGeneMapper(geneMapper),
+    fFeatureTreePolish(featureTreePolish),
+    fNumMapThreads((numMapThreads < 1) ? 1 : numMapThreads),
+    fNumPolishThreads((numPolishThreads < 1) ? 1 : numPolishThreads),
+    fWantTranscriptPsls(false),
+    fMapScheduler(fNumMapThreads, maxQueued),
+    fPolishQueue(maxQueued),
+    fFinishQueue(maxQueued),
+    fMapThreadsLeft(0),
+    fPolishThreadsLeft(0),
+    fParseDone(false),
+    fAborted(false),
+    fMaxInFlight((maxQueued < 1) ? 1 : maxQueued),
+    fNumInFlight(0),
+    fFinishWaitingForParse(false) {
+}
+
+/* save the current exception if it is the first one and stop the
+ * pipeline.  Must be called from a catch block. */
+void GenePipeline::recordError() {
+    lock_guard<mutex> lock(fErrorMutex);
+    if (fError == NULL) {
+        fError = current_exception();
+    }
+    fAborted = true;
+    notifyInFlight();
+}
+
+/* wake threads waiting on the in-flight state.  The mutex is taken so a
+ * change made without it isn't missed by a thread about to wait. */
+void GenePipeline::notifyInFlight() {
+    lock_guard<mutex> lock(fInFlightMutex);
+    fInFlightChanged.notify_all();
+}
+
+/* Wait until another gene can be put in flight.  Returns false without
+ * waiting if the finish stage is waiting for parsing to complete, as no
+ * genes will be finished until then, or if the pipeline was aborted. */
+bool GenePipeline::acquireInFlight() {
+    unique_lock<mutex> lock(fInFlightMutex);
+    fInFlightChanged.wait(lock, [this]() {
+            return (fNumInFlight < fMaxInFlight) or fAborted
+                or (fFinishWaitingForParse and not fParseDone);
+        });
+    if ((fNumInFlight < fMaxInFlight) and not fAborted) {
+        fNumInFlight++;
+        return true;
+    }
+    return false;
+}
+
+/* a gene is no longer in flight */
+void GenePipeline::releaseInFlight() {
+    lock_guard<mutex> lock(fInFlightMutex);
+    fNumInFlight--;
+    fInFlightChanged.notify_all();
+}
+
+/* record that all source genes have been loaded */
+void GenePipeline::setParseDone() {
+    lock_guard<mutex> lock(fInFlightMutex);
+    fParseDone = true;
+    fInFlightChanged.notify_all();
+}
+
+/* finish stage waits for all source genes to be loaded, or an error */
+void GenePipeline::waitForParse() {
+    unique_lock<mutex> lock(fInFlightMutex);
+    fFinishWaitingForParse = true;
+    fInFlightChanged.notify_all();
+    fInFlightChanged.wait(lock, [this]() {
+            return fParseDone or fAborted;
+        });
+    fFinishWaitingForParse = false;
+}
+
+/* parse stage thread.  Genes are added to the source annotations set before
+ * being scheduled, as the set owns them.  Genes that can't be put in flight
+ * because the finish stage is waiting for parsing to complete are held and
+ * scheduled once it is complete. */
+void GenePipeline::parseGenes(const string& inGxfFile,
+                              AnnotationSet* srcAnnotations) {
+    deque<GeneTask*> heldTasks;
+    try {
+        FeatureParser parser(inGxfFile);
+        long seq = 0;
+        Feature* gene;
+        while ((not fAborted) and ((gene = parser.nextGene()) != NULL)) {
+            srcAnnotations->addGene(gene);
+            GeneTask* task = new GeneTask(seq++, gene);
+            if ((heldTasks.size() == 0) and acquireInFlight()) {
+                fMapScheduler.push(task, fGeneMapper.estimateMapCost(gene));
+            } else {
+                heldTasks.push_back(task);
+            }
+        }
+    } catch (...) {
+        recordError();
+    }
+    setParseDone();
+    while (heldTasks.size() > 0) {
+        GeneTask* task = heldTasks.front();
+        heldTasks.pop_front();
+        if (acquireInFlight()) {
+            fMapScheduler.push(task, fGeneMapper.estimateMapCost(task->srcGene));
+        } else {
+            delete task;  // aborted
+        }
+    }
+    fMapScheduler.close();
+}
+
+/* map stage thread.  After an error, genes are passed on without mapping so
+ * they are freed by the finish stage. */
+void GenePipeline::mapGenes(int worker) {
+    GeneTask* task;
+    while (fMapScheduler.pop(worker, task)) {
+        if (not fAborted) {
+            try {
+                ostringstream transcriptPslBuf;
+                task->disposition = fGeneMapper.mapSrcGeneFeatures(task->srcGene, task->mappedGene,
+                                                                   (fWantTranscriptPsls ? &transcriptPslBuf : NULL));
+                task->transcriptPsls = transcriptPslBuf.str();
+            } catch (...) {
+                recordError();
+            }
+        }
+        fPolishQueue.push(task);
+    }
+    if (--fMapThreadsLeft == 0) {
+        fPolishQueue.close();
+    }
+}
+
+/* polish stage thread */
+void GenePipeline::polishGenes() {
+    GeneTask* task;
+    while (fPolishQueue.pop(task)) {
+        if (not fAborted) {
+            try {
+                fGeneMapper.polishSrcGene(task->mappedGene, task->disposition, fFeatureTreePolish);
+            } catch (...) {
+                recordError();
+            }
+        }
+        fFinishQueue.push(task);
+    }
+    if (--fPolishThreadsLeft == 0) {
+        fFinishQueue.close();
+    }
+}
+
+/* can a gene that is next in order be finished now? */
+bool GenePipeline::canFinishGene(const GeneTask* task) const {
+    return fAborted or fParseDone
+        or (not fGeneMapper.needsAllSrcGenes(task->mappedGene, task->disposition));
+}
+
+/* finish a gene and free the task */
+void GenePipeline::finishGene(GeneTask* task,
+                              AnnotationSet& mappedSet,
+                              AnnotationSet& unmappedSet,
+                              MappingInfoWriter& mappingInfoFh,
+                              ostream* transcriptPslFh) {
+    if (not fAborted) {
+        try {
+            fGeneMapper.finishSrcGene(task->mappedGene, task->disposition, mappingInfoFh);
+            if (transcriptPslFh != NULL) {
+                *transcriptPslFh << task->transcriptPsls;
+            }
+            fGeneMapper.saveSrcGene(task->mappedGene, mappedSet, unmappedSet);
+        } catch (...) {
+            recordError();
+        }
+    }
+    delete task;
+    releaseInFlight();
+}
+
+/* finish stage, run in the calling thread.  Genes are finished in source
+ * order as they become available.  If the next gene can't be finished until
+ * parsing is complete, wait for it rather than buffering more genes.  This
+ * always drains the queue, so that the other stages don't block after an
+ * error. */
+void GenePipeline::finishGenes(AnnotationSet& mappedSet,
+                               AnnotationSet& unmappedSet,
+                               MappingInfoWriter& mappingInfoFh,
+                               ostream* transcriptPslFh) {
+    GeneTaskMap pending;
+    long nextSeq = 0;
+    GeneTask* task;
+    bool queueOpen = true;
+    while (true) {
+        // once the queue is closed, parsing is complete and all can be finished
+        GeneTaskMap::iterator next;
+        while (((next = pending.find(nextSeq)) != pending.end())
+               and ((not queueOpen) or canFinishGene(next->second))) {
+            finishGene(next->second, mappedSet, unmappedSet, mappingInfoFh, transcriptPslFh);
+            pending.erase(next);
+            nextSeq++;
+        }
+        if (not queueOpen) {
+            break;
+        }
+        if (next != pending.end()) {
+            waitForParse();  // next gene needs all source genes
+        } else if (fFinishQueue.pop(task)) {
+            pending[task->seq] = task;
+        } else {
+            queueOpen = false;
+        }
+    }
+    assert(pending.size() == 0);
+}
+
+/* Map a GFF3/GTF, loading it into srcAnnotations. */
+void GenePipeline::mapGxf(const string& inGxfFile,
+                          AnnotationSet& srcAnnotations,
+                          bool copyTargets,
+                          GxfWriter& mappedGxfFh,
+                          GxfWriter* unmappedGxfFh,
+                          MappingInfoWriter& mappingInfoFh,
+                          ostream* transcriptPslFh) {
+    AnnotationSet mappedSet(&fGeneMapper.getGenomeTransMap()->fTargetSizes);
+    AnnotationSet unmappedSet(&fGeneMapper.getGenomeTransMap()->fQuerySizes);
+    fWantTranscriptPsls = (transcriptPslFh != NULL);
+    fMapThreadsLeft = fNumMapThreads;
+    fPolishThreadsLeft = fNumPolishThreads;
+
+    vector<std::thread> threads;
+    threads.push_back(std::thread(&GenePipeline::parseGenes, this, inGxfFile, &srcAnnotations));
+    for (int i = 0; i < fNumMapThreads; i++) {
+        threads.push_back(std::thread(&GenePipeline::mapGenes, this, i));
+    }
+    for (int i = 0; i < fNumPolishThreads; i++) {
+        threads.push_back(std::thread(&GenePipeline::polishGenes, this));
+    }
+    finishGenes(mappedSet, unmappedSet, mappingInfoFh, transcriptPslFh);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    if (fError != NULL) {
+        rethrow_exception(fError);
+    }
+    fGeneMapper.writeGxf(copyTargets, mappedSet, unmappedSet, mappedGxfFh, unmappedGxfFh, mappingInfoFh);
+}
@@ -0,0 +1,128 @@
+/*
+ * Pipeline of threads for mapping a GxF file.
+ */
+#ifndef genePipeline_hh
+#define genePipeline_hh
+#include "geneMapper.hh"
+#include "asyncOutput.hh"
+#include "workScheduler.hh"
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+class FeatureTreePolish;
+
+/*
+ * Maps a GxF file as a pipeline of stages connected by bounded queues:
+ *   - parse: a thread reads source genes, adding them to the source
+ *     annotation set and queuing them for mapping.
+ *   - map: mapping threads map the transcripts and do gene-level checks.
+ *     Genes are scheduled to the mapping threads by estimated cost (see
+ *     WorkScheduler), so the most expensive genes are started first.
+ *   - polish: polishing threads assign mapping versions.
+ *   - finish: the calling thread puts genes back into source order, writes
+ *     mapping info and transcript PSLs, makes target substitution decisions,
+ *     and collects the results to be sorted and written at the end.
+ * The number of genes in flight, from being scheduled for mapping until
+ * finished, including genes waiting to be put back into order, is limited
+ * to maxQueued, which is also the size of the queues, so the queues never
+ * block.  Genes that might have a target substituted can't be finished
+ * until parsing is complete, as this checks for the gene in the complete
+ * source set.  When the next gene to finish is one of these, the finish
+ * stage waits for parsing to complete.  If the limit is reached while it
+ * waits, the parse thread continues to load the source genes, but holds
+ * them without mapping until parsing is complete.  The mapping info,
+ * transcript PSLs, and GxF output are identical to mapping with a single
+ * thread.
+ */
+class GenePipeline {
+    private:
+    /* a gene moving through the pipeline */
+    class GeneTask {
+        public:
+        long seq;  // order in source
+        const Feature* srcGene;
+        ResultFeatures mappedGene;
+        GeneMapper::SrcGeneDisposition disposition;
+        string transcriptPsls;
+
+        GeneTask(long seq,
+                 const Feature* srcGene):
+            seq(seq),
+            srcGene(srcGene),
+            mappedGene(srcGene),
+            disposition(GeneMapper::SRC_GENE_SKIPPED) {
+        }
+        ~GeneTask() {
+            mappedGene.free();
+        }
+    };
+    typedef map<long, GeneTask*> GeneTaskMap;
+
+    GeneMapper& fGeneMapper;
+    const FeatureTreePolish& fFeatureTreePolish;
+    int fNumMapThreads;
+    int fNumPolishThreads;
+    bool fWantTranscriptPsls;
+    WorkScheduler<GeneTask*> fMapScheduler;
+    BoundedQueue<GeneTask*> fPolishQueue;
+    BoundedQueue<GeneTask*> fFinishQueue;
+    atomic<int> fMapThreadsLeft;
+    atomic<int> fPolishThreadsLeft;
+    atomic<bool> fParseDone;
+    atomic<bool> fAborted;
+    mutex fErrorMutex;
+    exception_ptr fError;
+    size_t fMaxInFlight;
+    size_t fNumInFlight;            // protected by fInFlightMutex
+    bool fFinishWaitingForParse;    // protected by fInFlightMutex
+    mutex fInFlightMutex;
+    condition_variable fInFlightChanged;
+
+    void recordError();
+    void notifyInFlight();
+    bool acquireInFlight();
+    void releaseInFlight();
+    void setParseDone();
+    void waitForParse();
+    void parseGenes(const string& inGxfFile,
+                    AnnotationSet* srcAnnotations);
+    void mapGenes(int worker);
+    void polishGenes();
+    bool canFinishGene(const GeneTask* task) const;
+    void finishGene(GeneTask* task,
+                    AnnotationSet& mappedSet,
+                    AnnotationSet& unmappedSet,
+                    MappingInfoWriter& mappingInfoFh,
+                    ostream* transcriptPslFh);
+    void finishGenes(AnnotationSet& mappedSet,
+                     AnnotationSet& unmappedSet,
+                     MappingInfoWriter& mappingInfoFh,
+                     ostream* transcriptPslFh);
+
+    public:
+    /* default maximum number of genes in flight, in each queue, and in a
+     * batch scheduled for mapping */
+    static const size_t DEFAULT_MAX_QUEUED = 256;
+
+    /* Constructor.  The GeneMapper must have been created with the empty
+     * source annotation set that will be passed to mapGxf. */
+    GenePipeline(GeneMapper& geneMapper,
+                 const FeatureTreePolish& featureTreePolish,
+                 int numMapThreads,
+                 int numPolishThreads,
+                 size_t maxQueued = DEFAULT_MAX_QUEUED);
+
+    /* Map a GFF3/GTF, loading it into srcAnnotations.  An exception
+     * in any stage stops the pipeline and is rethrown.  May only be
+     * called once on an object. */
+    void mapGxf(const string& inGxfFile,
+                AnnotationSet& srcAnnotations,
+                bool copyTargets,
+                GxfWriter& mappedGxfFh,
+                GxfWriter* unmappedGxfFh,
+                MappingInfoWriter& mappingInfoFh,
+                ostream* transcriptPslFh);
+};
+
+#endif
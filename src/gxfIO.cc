@@ -69,7 +69,7 @@ class Gff3Parser: public GxfParser {
         string value = stripQuotes(attrStr.substr(i+1));
         StringVector values = stringSplit(value, ',');
         AttrVal* attrVal = new AttrVal(name, values[0]);
-        attrVals.push_back(attrVal);
+        attrVals.add(attrVal);
         for (int i = 1; i < values.size(); i++) {
             attrVal->addVal(values[i]);
         }
@@ -92,6 +92,12 @@ class Gff3Parser: public GxfParser {
                GxfFeatureFactory gxfFeatureFactory):
         GxfParser(fileName, gxfFeatureFactory) {
     }
+
+    /* constructor from stream */
+    Gff3Parser(istream& in,
+               GxfFeatureFactory gxfFeatureFactory):
+        GxfParser(in, gxfFeatureFactory) {
+    }
  
     /* get the format being parser */
     virtual GxfFormat getFormat() const {
@@ -137,7 +143,7 @@ class GtfParser: public GxfParser {
         if (idx >= 0) {
             attrVals[idx]->addVal(value);
         } else {
-            attrVals.push_back(new AttrVal(name, value));
+            attrVals.add(new AttrVal(name, value));
         }
     }
 
@@ -158,6 +164,12 @@ class GtfParser: public GxfParser {
               GxfFeatureFactory gxfFeatureFactory):
         GxfParser(fileName, gxfFeatureFactory) {
     }
+
+    /* constructor from stream */
+    GtfParser(istream& in,
+              GxfFeatureFactory gxfFeatureFactory):
+        GxfParser(in, gxfFeatureFactory) {
+    }
  
     /* get the format being parser */
     virtual GxfFormat getFormat() const {
@@ -184,19 +196,42 @@ StringVector GxfParser::splitFeatureLine(const string& line) const {
 /* constructor that opens file, which maybe compressed. */
 GxfParser::GxfParser(const string& fileName,
                      GxfFeatureFactory gxfFeatureFactory):
-    fIn(new FIOStream(fileName)),
+    fFileIn(new FIOStream(fileName)),
+    fIn(fFileIn),
+    fGxfFeatureFactory(gxfFeatureFactory) {
+}
+
+/* constructor that reads from a stream */
+GxfParser::GxfParser(istream& in,
+                     GxfFeatureFactory gxfFeatureFactory):
+    fFileIn(NULL),
+    fIn(&in),
     fGxfFeatureFactory(gxfFeatureFactory) {
 }
 
 /* destructor */
 GxfParser::~GxfParser() {
-    delete fIn;
+    delete fFileIn;
+}
+
+/* read a line, return false on EOF */
+bool GxfParser::readLine(string& line) {
+    if (fFileIn != NULL) {
+        return fFileIn->readLine(line);
+    } else if (not getline(*fIn, line)) {
+        if (fIn->bad()) {
+            throw ios_base::failure("I/O error reading GxF stream");
+        }
+        return false;
+    } else {
+        return true;
+    }
 }
 
 /* Read the next record */
 GxfRecord* GxfParser::read() {
     string line;
-    if (not fIn->readLine(line)) {
+    if (not readLine(line)) {
         return NULL;
     } else if ((line.size() > 0) and line[0] != '#') {
         return parseFeature(splitFeatureLine(line));
@@ -233,6 +268,17 @@ GxfParser *GxfParser::factory(const string& fileName,
     }
 }
 
+/* Factory to create a parser that reads from a stream. */
+GxfParser *GxfParser::factory(istream& in,
+                              GxfFormat gxfFormat,
+                              GxfFeatureFactory gxfFeatureFactory) {
+    if (gxfFormat == GFF3_FORMAT) {
+        return new Gff3Parser(in, gxfFeatureFactory);
+    } else {
+        return new GtfParser(in, gxfFeatureFactory);
+    }
+}
+
 /* Write for GFF3 */
 class Gff3Writer: public GxfWriter {
     public:
@@ -267,6 +313,12 @@ class Gff3Writer: public GxfWriter {
         write("##gff-version 3");
     }
 
+    /* constructor from stream */
+    Gff3Writer(ostream& out):
+        GxfWriter(out) {
+        write("##gff-version 3");
+    }
+
     /* get the format being parser */
     virtual GxfFormat getFormat() const {
         return GFF3_FORMAT;
@@ -371,6 +423,13 @@ class GtfWriter: public GxfWriter {
         fParIdHackMethod(parIdHackMethod) {
     }
 
+    /* constructor from stream */
+    GtfWriter(ostream& out,
+              ParIdHackMethod parIdHackMethod):
+        GxfWriter(out),
+        fParIdHackMethod(parIdHackMethod) {
+    }
+
     /* get the format being parser */
     virtual GxfFormat getFormat() const {
         return GTF_FORMAT;
@@ -384,12 +443,19 @@ class GtfWriter: public GxfWriter {
 
 /* constructor that opens file */
 GxfWriter::GxfWriter(const string& fileName):
-    fOut(new FIOStream(fileName, ios::out)) {
+    fFileOut(new FIOStream(fileName, ios::out)),
+    fOut(fFileOut) {
+}
+
+/* constructor that writes to a stream */
+GxfWriter::GxfWriter(ostream& out):
+    fFileOut(NULL),
+    fOut(&out) {
 }
 
 /* destructor */
 GxfWriter::~GxfWriter() {
-    delete fOut;
+    delete fFileOut;
 }
 
 /* Factory to create a writer. file maybe compressed.  If gxfFormat is
@@ -407,6 +473,17 @@ GxfWriter *GxfWriter::factory(const string& fileName,
     }
 }
 
+/* Factory to create a writer to a stream */
+GxfWriter *GxfWriter::factory(ostream& out,
+                              GxfFormat gxfFormat,
+                              ParIdHackMethod parIdHackMethod) {
+    if (gxfFormat == GFF3_FORMAT) {
+        return new Gff3Writer(out);
+    } else {
+        return new GtfWriter(out, parIdHackMethod);
+    }
+}
+
 /* copy a file to output, normally used for a header */
 void GxfWriter::copyFile(const string& inFile) {
     FIOStream inFh(inFile);
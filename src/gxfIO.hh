@@ -37,10 +37,12 @@ typedef GxfFeature* (*GxfFeatureFactory)(const string& seqid, const string& sour
  */
 class GxfParser {
     private:
-    FIOStream* fIn;  // input stream
+    FIOStream* fFileIn;  // input file, NULL if reading a stream
+    istream* fIn;        // input stream, maybe fFileIn
     queue<GxfRecord*> fPending; // FIFO of pushed records to be read before file
 
     StringVector splitFeatureLine(const string& line) const;
+    bool readLine(string& line);
     GxfRecord* read();
 
     protected:
@@ -52,6 +54,10 @@ class GxfParser {
     /* constructor that opens file */
     GxfParser(const string& fileName,
               GxfFeatureFactory gxfFeatureFactory);
+
+    /* constructor that reads from a stream, which is not owned */
+    GxfParser(istream& in,
+              GxfFeatureFactory gxfFeatureFactory);
     
     public:
     /* destructor */
@@ -66,6 +72,11 @@ class GxfParser {
                               GxfFeatureFactory gxfFeatureFactory,
                               GxfFormat gxfFormat=GXF_UNKNOWN_FORMAT);
 
+    /* Factory to create a parser that reads from a stream. */
+    static GxfParser *factory(istream& in,
+                              GxfFormat gxfFormat,
+                              GxfFeatureFactory gxfFeatureFactory);
+
     /* Read the next record, either queued by push() or from the file , use
      * instanceOf to determine the type.  Return NULL on EOF.
      */
@@ -82,7 +93,8 @@ class GxfParser {
  */
 class GxfWriter {
     private:
-    FIOStream* fOut;  // output stream
+    FIOStream* fFileOut;  // output file, NULL if writing a stream
+    ostream* fOut;        // output stream, maybe fFileOut
 
     protected:
     /* format a feature line */
@@ -92,6 +104,9 @@ class GxfWriter {
     /* constructor that opens file */
     GxfWriter(const string& fileName);
 
+    /* constructor that writes to a stream, which is not owned */
+    GxfWriter(ostream& out);
+
     /* destructor */
     virtual ~GxfWriter();
 
@@ -102,6 +117,11 @@ class GxfWriter {
                               ParIdHackMethod parIdHackMethod,
                               GxfFormat gxfFormat=GXF_UNKNOWN_FORMAT);
 
+    /* Factory to create a writer to a stream */
+    static GxfWriter *factory(ostream& out,
+                              GxfFormat gxfFormat,
+                              ParIdHackMethod parIdHackMethod);
+
     /* copy a file to output, normally used for a header */
     void copyFile(const string& inFile);
 
@@ -1,4 +1,5 @@
 #include "gxfRecord.hh"
+#include <string.h>
 
 const string GxfFeature::GENE = "gene";
 const string GxfFeature::TRANSCRIPT = "transcript";
@@ -30,6 +31,67 @@ const string GxfFeature::TAG_ATTR = "tag";
 const string GxfFeature::SOURCE_HAVANA = "HAVANA";
 const string GxfFeature::SOURCE_ENSEMBL = "ENSEMBL";
 
+/* names of well-known attributes, indexed by KnownAttr */
+static const char* const knownAttrNames[ATTR_NUM_KNOWN] = {
+    "ID", "Parent", "gene_id", "gene_name", "gene_type", "gene_status",
+    "havana_gene", "transcript_id", "transcript_name", "transcript_type",
+    "transcript_status", "havana_transcript", "exon_id", "exon_number", "tag",
+    "remap_status", "remap_original_id", "remap_original_location",
+    "remap_num_mappings", "remap_target_status", "remap_substituted_missing_target"
+};
+
+/*
+ * Perfect hash table of well-known attribute names to slots.  The hash
+ * multiplier was chosen so that none of the names collide; this is checked
+ * when the table is built.
+ */
+class KnownAttrTable {
+    private:
+    static const unsigned NUM_BUCKETS = 64;  // power of two
+    static const unsigned HASH_MULT = 45;
+    signed char fBuckets[NUM_BUCKETS];  // KnownAttr or ATTR_UNKNOWN
+
+    /* hash a name */
+    static unsigned hashName(const char* name,
+                             unsigned len) {
+        unsigned hv = len;
+        for (unsigned i = 0; i < len; i++) {
+            hv = (hv * HASH_MULT) + static_cast<unsigned char>(name[i]);
+        }
+        return hv & (NUM_BUCKETS-1);
+    }
+
+    public:
+    /* constructor, build table and check that it is perfect */
+    KnownAttrTable() {
+        std::fill(fBuckets, fBuckets+NUM_BUCKETS, ATTR_UNKNOWN);
+        for (int i = 0; i < ATTR_NUM_KNOWN; i++) {
+            unsigned iBucket = hashName(knownAttrNames[i], strlen(knownAttrNames[i]));
+            if (fBuckets[iBucket] != ATTR_UNKNOWN) {
+                throw logic_error(string("BUG: known attribute hash collision: ") + knownAttrNames[i]);
+            }
+            fBuckets[iBucket] = i;
+        }
+    }
+
+    /* lookup a name */
+    KnownAttr lookup(const string& name) const {
+        int knownAttr = fBuckets[hashName(name.c_str(), name.size())];
+        if ((knownAttr != ATTR_UNKNOWN) and (name == knownAttrNames[knownAttr])) {
+            return static_cast<KnownAttr>(knownAttr);
+        } else {
+            return ATTR_UNKNOWN;
+        }
+    }
+};
+
+/* get the slot of an attribute name, or ATTR_UNKNOWN if it is not a
+ * well-known attribute. */
+KnownAttr knownAttrFromName(const string& name) {
+    static const KnownAttrTable knownAttrTable;
+    return knownAttrTable.lookup(name);
+}
+
 /* return base columns (excluding attributes) as a string */
 string GxfFeature::baseColumnsAsString() const {
     return fSeqid + "\t" + fSource + "\t" + fType + "\t" + to_string(fStart) + "\t"
@@ -40,11 +102,11 @@ string GxfFeature::baseColumnsAsString() const {
  * id */
 const string& GxfFeature::getTypeId() const {
     if (fType == GxfFeature::GENE) {
-        return getAttrValue(GxfFeature::GENE_ID_ATTR, emptyString);
+        return getAttrValue(ATTR_GENE_ID, emptyString);
     } else if (fType == GxfFeature::TRANSCRIPT) {
-        return getAttrValue(GxfFeature::TRANSCRIPT_ID_ATTR, emptyString);
+        return getAttrValue(ATTR_TRANSCRIPT_ID, emptyString);
     } else if (fType == GxfFeature::EXON) {
-        return getAttrValue(GxfFeature::EXON_ID_ATTR, emptyString);
+        return getAttrValue(ATTR_EXON_ID, emptyString);
     } else {
         return emptyString;
     }
@@ -54,9 +116,9 @@ const string& GxfFeature::getTypeId() const {
  * id */
 const string& GxfFeature::getHavanaTypeId() const {
     if (fType == GxfFeature::GENE) {
-        return getAttrValue(GxfFeature::GENE_HAVANA_ATTR, emptyString);
+        return getAttrValue(ATTR_GENE_HAVANA, emptyString);
     } else if (fType == GxfFeature::TRANSCRIPT) {
-        return getAttrValue(GxfFeature::TRANSCRIPT_HAVANA_ATTR, emptyString);
+        return getAttrValue(ATTR_TRANSCRIPT_HAVANA, emptyString);
     } else {
         return emptyString;
     }
@@ -66,9 +128,9 @@ const string& GxfFeature::getHavanaTypeId() const {
  * id */
 const string& GxfFeature::getTypeName() const {
     if (fType == GxfFeature::GENE) {
-        return getAttrValue(GxfFeature::GENE_NAME_ATTR, emptyString);
+        return getAttrValue(ATTR_GENE_NAME, emptyString);
     } else if (fType == GxfFeature::TRANSCRIPT) {
-        return getAttrValue(GxfFeature::TRANSCRIPT_NAME_ATTR, emptyString);
+        return getAttrValue(ATTR_TRANSCRIPT_NAME, emptyString);
     } else {
         return emptyString;
     }
@@ -79,9 +141,9 @@ const string& GxfFeature::getTypeName() const {
 const string& GxfFeature::getTypeBiotype() const {
     static const string emptyString;
     if (fType == GxfFeature::GENE) {
-        return getAttrValue(GxfFeature::GENE_TYPE_ATTR, emptyString);
+        return getAttrValue(ATTR_GENE_TYPE, emptyString);
     } else if (fType == GxfFeature::TRANSCRIPT) {
-        return getAttrValue(GxfFeature::TRANSCRIPT_TYPE_ATTR, emptyString);
+        return getAttrValue(ATTR_TRANSCRIPT_TYPE, emptyString);
     } else {
         return emptyString;
     }
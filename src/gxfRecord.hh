@@ -48,10 +48,45 @@ class GxfLine: public string, public GxfRecord {
     }
 };
 
+/*
+ * Well-known attributes.  These are assigned a fixed slot when parsed, so
+ * they can be found without searching the attribute list.
+ */
+typedef enum {
+    ATTR_UNKNOWN = -1,   // not a well-known attribute
+    ATTR_ID,
+    ATTR_PARENT,
+    ATTR_GENE_ID,
+    ATTR_GENE_NAME,
+    ATTR_GENE_TYPE,
+    ATTR_GENE_STATUS,
+    ATTR_GENE_HAVANA,
+    ATTR_TRANSCRIPT_ID,
+    ATTR_TRANSCRIPT_NAME,
+    ATTR_TRANSCRIPT_TYPE,
+    ATTR_TRANSCRIPT_STATUS,
+    ATTR_TRANSCRIPT_HAVANA,
+    ATTR_EXON_ID,
+    ATTR_EXON_NUMBER,
+    ATTR_TAG,
+    ATTR_REMAP_STATUS,
+    ATTR_REMAP_ORIGINAL_ID,
+    ATTR_REMAP_ORIGINAL_LOCATION,
+    ATTR_REMAP_NUM_MAPPINGS,
+    ATTR_REMAP_TARGET_STATUS,
+    ATTR_REMAP_SUBSTITUTED_MISSING_TARGET,
+    ATTR_NUM_KNOWN       // number of well-known attributes, must be last
+} KnownAttr;
+
+/* get the slot of an attribute name, or ATTR_UNKNOWN if it is not a
+ * well-known attribute. */
+KnownAttr knownAttrFromName(const string& name);
+
 /* attribute/value pair.  Maybe multi-valued */
 class AttrVal {
     private:
     const string fName;
+    const KnownAttr fKnownAttr;  // slot if well-known attribute
     StringVector fVals;
 
     static void checkName(const string& name) {
@@ -67,14 +102,15 @@ class AttrVal {
 
     public:
     AttrVal(const string& name, const string& val):
-        fName(name) {
+        fName(name),
+        fKnownAttr(knownAttrFromName(name)) {
         checkName(name);
         checkVal(val);
         fVals.push_back(val);
     }
 
     AttrVal(const string& name, const StringVector& vals):
-        fName(name), fVals(vals) {
+        fName(name), fKnownAttr(knownAttrFromName(name)), fVals(vals) {
         checkName(name);
         for (int i = 0; i < vals.size(); i++) {
             checkVal(vals[i]);
@@ -89,12 +125,15 @@ class AttrVal {
     
     /* copy constructor */
     AttrVal(const AttrVal& src):
-        fName(src.fName), fVals(src.fVals) {
+        fName(src.fName), fKnownAttr(src.fKnownAttr), fVals(src.fVals) {
     }
 
     const string& getName() const {
         return fName;
     }
+    KnownAttr getKnownAttr() const {
+        return fKnownAttr;
+    }
     const string& getVal(int iVal=0) const {
         return fVals[iVal];
     }
@@ -113,9 +152,26 @@ typedef vector<AttrVal*> AttrValVector;
  * entries. */
 class AttrVals: public AttrValVector {
     // n.b.  this keeps pointers rather than values due to reallocation if vector changes
+    // n.b.  modify with the methods below, not the vector methods, so
+    // the slot index stays valid.
+    private:
+    int fKnownIdx[ATTR_NUM_KNOWN];  // index of first well-known attribute, or -1
+
+    /* rebuild index of well-known attributes after a insert or erase */
+    void rebuildKnownIdx() {
+        std::fill(fKnownIdx, fKnownIdx+ATTR_NUM_KNOWN, -1);
+        for (int i = size()-1; i >= 0; i--) {
+            KnownAttr knownAttr = (*this)[i]->getKnownAttr();
+            if (knownAttr != ATTR_UNKNOWN) {
+                fKnownIdx[knownAttr] = i;
+            }
+        }
+    }
+
     public:
     /* empty constructor */
     AttrVals() {
+        std::fill(fKnownIdx, fKnownIdx+ATTR_NUM_KNOWN, -1);
     }
 
     /* copy constructor */
@@ -123,6 +179,7 @@ class AttrVals: public AttrValVector {
         for (size_t i = 0; i < src.size(); i++) {
             push_back(new AttrVal(*(src[i])));
         }
+        std::copy(src.fKnownIdx, src.fKnownIdx+ATTR_NUM_KNOWN, fKnownIdx);
     }
     
     /* destructor */
@@ -137,8 +194,22 @@ class AttrVals: public AttrValVector {
         return findIdx(name) >= 0;
     }
     
+    /* does the well-known attribute exist */
+    bool exists(KnownAttr knownAttr) const {
+        return findIdx(knownAttr) >= 0;
+    }
+    
+    /* find the index of the first well-known attribute or -1 if not found */
+    int findIdx(KnownAttr knownAttr) const {
+        return fKnownIdx[knownAttr];
+    }
+
     /* find the index of the first attribute with name or -1 if not found */
     int findIdx(const string& name) const {
+        KnownAttr knownAttr = knownAttrFromName(name);
+        if (knownAttr != ATTR_UNKNOWN) {
+            return findIdx(knownAttr);
+        }
         for (int i = 0; i < size(); i++) {
             if ((*this)[i]->getName() == name) {
                 return i;
@@ -158,6 +229,15 @@ class AttrVals: public AttrValVector {
         }
     }
     
+    /* get a well-known attribute, NULL if it doesn't exist */
+    const AttrVal* find(KnownAttr knownAttr) const {
+        int i = findIdx(knownAttr);
+        if (i < 0) {
+            return NULL;
+        } else {
+            return (*this)[i];
+        }
+    }
     
     /* get a attribute, error it doesn't exist */
     const AttrVal* get(const string& name) const {
@@ -168,19 +248,30 @@ class AttrVals: public AttrValVector {
         return attrVal;
     }
 
+    /* add an attribute, taking ownership */
+    void add(AttrVal* attrVal) {
+        push_back(attrVal);
+        KnownAttr knownAttr = attrVal->getKnownAttr();
+        if ((knownAttr != ATTR_UNKNOWN) and (fKnownIdx[knownAttr] < 0)) {
+            fKnownIdx[knownAttr] = size()-1;
+        }
+    }
+
     /* add an attribute */
     void add(const AttrVal& attrVal) {
-        push_back(new AttrVal(attrVal));
+        add(new AttrVal(attrVal));
     }
 
     /* insert an attribute at the front */
     void push(const AttrVal& attrVal) {
         insert(begin(), new AttrVal(attrVal));
+        rebuildKnownIdx();
     }
 
     /* add or replace an attribute */
     void update(const AttrVal& attrVal) {
-        int idx = findIdx(attrVal.getName());
+        int idx = (attrVal.getKnownAttr() != ATTR_UNKNOWN)
+            ? findIdx(attrVal.getKnownAttr()) : findIdx(attrVal.getName());
         if (idx < 0) {
             add(attrVal);
         } else {
@@ -195,6 +286,7 @@ class AttrVals: public AttrValVector {
         if (idx >= 0) {
             delete (*this)[idx];
             erase(begin()+idx);
+            rebuildKnownIdx();
         }
     }
 };
@@ -339,6 +431,23 @@ public:
         }
     }
 
+    /* get a well-known attribute, NULL if it doesn't exist */
+    const AttrVal* findAttr(KnownAttr knownAttr) const {
+        return fAttrs.find(knownAttr);
+    }
+
+    /* get a well-known attribute value, default it doesn't exist */
+    const string& getAttrValue(KnownAttr knownAttr,
+                               const string& defaultVal,
+                               int iVal=0) const {
+        const AttrVal* attrVal = findAttr(knownAttr);
+        if (attrVal == NULL) {
+            return defaultVal;
+        } else {
+            return attrVal->getVal(iVal);
+        }
+    }
+
     /* get the id based on feature type, or empty string if it doesn't have an
      * id */
     const string& getTypeId() const;
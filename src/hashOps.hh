@@ -0,0 +1,56 @@
+/*
+ * Content hashing operations, used to build fingerprints of annotations.
+ */
+#ifndef hashOps_hh
+#define hashOps_hh
+#include <string>
+#include <stdint.h>
+using namespace std;
+
+/* type of a hash value */
+typedef uint64_t HashVal;
+
+/* initial value for a hash (64-bit FNV-1a offset basis) */
+static const HashVal HASH_INIT = 0xcbf29ce484222325ULL;
+
+/* hash a range of bytes, continuing from a previous hash value (FNV-1a) */
+static inline HashVal hashBytes(const char* bytes,
+                                size_t len,
+                                HashVal hv = HASH_INIT) {
+    for (size_t i = 0; i < len; i++) {
+        hv ^= static_cast<unsigned char>(bytes[i]);
+        hv *= 0x100000001b3ULL;
+    }
+    return hv;
+}
+
+/* hash an integer value */
+static inline HashVal hashInt(int64_t val,
+                              HashVal hv = HASH_INIT) {
+    return hashBytes(reinterpret_cast<const char*>(&val), sizeof(val), hv);
+}
+
+/* hash a string.  The length is included so concatenated strings
+ * don't collide. */
+static inline HashVal hashString(const string& str,
+                                 HashVal hv = HASH_INIT) {
+    return hashBytes(str.c_str(), str.size(), hashInt(str.size(), hv));
+}
+
+/* scramble the bits of a hash value (splitmix64 finalizer) */
+static inline HashVal hashMix(HashVal hv) {
+    hv ^= hv >> 30;
+    hv *= 0xbf58476d1ce4e5b9ULL;
+    hv ^= hv >> 27;
+    hv *= 0x94d049bb133111ebULL;
+    hv ^= hv >> 31;
+    return hv;
+}
+
+/* combine two hash values, order dependent */
+static inline HashVal hashCombine(HashVal hv1,
+                                  HashVal hv2) {
+    return hashMix(hv1 ^ (hv2 + 0x9e3779b97f4a7c15ULL + (hv1 << 6) + (hv1 >> 2)));
+}
+
+#endif
@@ -0,0 +1,312 @@
+/*
+ * Lift BED/TSV intervals through mapping alignments.
+ */
+#include "intervalLifter.hh"
+#include "transMap.hh"
+#include "pslOps.hh"
+#include <stdexcept>
+#include <thread>
+#include <exception>
+
+/* lift info TSV headers, terminated by NULL */
+static const char* liftInfoHeaders[] = {
+    "inChrom", "inStart", "inEnd", "inName", "mappingStatus", "mappingCount",
+    "mappedChrom", "mappedStart", "mappedEnd", "mappedStrand", "mappedBases", NULL
+};
+
+/* constructor */
+IntervalLifter::IntervalLifter(const TransMap* transMap,
+                               int numThreads,
+                               int batchSize,
+                               int bedFields):
+    fTransMap(transMap),
+    fNumThreads((numThreads < 1) ? 1 : numThreads),
+    fBatchSize((batchSize < 1) ? 1 : batchSize),
+    fBedFields(bedFields) {
+    if ((fBedFields != 0) and ((fBedFields < 3) or (fBedFields > 9))) {
+        throw invalid_argument("number of BED fields must be in the range 3 to 9, BED12 blocks can't be lifted, got "
+                               + toString(fBedFields));
+    }
+}
+
+/* write the lift info TSV header */
+void IntervalLifter::outputLiftInfoHeader(ostream& liftInfoFh) {
+    for (int i = 0; liftInfoHeaders[i] != NULL; i++) {
+        if (i > 0) {
+            liftInfoFh << "\t";
+        }
+        liftInfoFh << liftInfoHeaders[i];
+    }
+    liftInfoFh << endl;
+}
+
+/* is this a line that is copied without lifting? */
+bool IntervalLifter::isPassThroughLine(const string& line) {
+    return stringEmpty(line) or stringStartsWith(line, "#")
+        or stringStartsWith(line, "track") or stringStartsWith(line, "browser");
+}
+
+/* construct a single block PSL for an interval */
+struct psl* IntervalLifter::intervalToPsl(const string& qName,
+                                          const string& chrom,
+                                          int start,
+                                          int end) const {
+    int size = end - start;
+    struct psl* psl = pslNew(toCharStr(qName), size, 0, size,
+                             toCharStr(chrom), fTransMap->getQuerySeqSize(chrom), start, end,
+                             toCharStr("++"), 1, 0);
+    pslAddBlock(psl, 0, start, size);
+    return psl;
+}
+
+/* get the status of one mapping of an interval, also returning the number
+ * of bases mapped */
+RemapStatus IntervalLifter::getMappingStatus(struct psl* mappedPsl,
+                                             int size,
+                                             int& mappedBases) const {
+    mappedBases = 0;
+    for (unsigned iBlk = 0; iBlk < mappedPsl->blockCount; iBlk++) {
+        mappedBases += mappedPsl->blockSizes[iBlk];
+    }
+    if (mappedBases < size) {
+        return REMAP_STATUS_PARTIAL;
+    } else if (mappedPsl->blockCount == 1) {
+        return REMAP_STATUS_FULL_CONTIG;
+    } else {
+        return REMAP_STATUS_FULL_FRAGMENT;
+    }
+}
+
+/* output a lift info record, mappedPsl is NULL if not mapped */
+void IntervalLifter::outputLiftInfo(const StringVector& cols,
+                                    const string& name,
+                                    RemapStatus mappingStatus,
+                                    int mappingCount,
+                                    struct psl* mappedPsl,
+                                    int mappedBases,
+                                    ostream& liftInfoFh) const {
+    liftInfoFh << cols[0] << "\t" << cols[1] << "\t" << cols[2] << "\t" << name << "\t"
+               << remapStatusToStr(mappingStatus) << "\t" << mappingCount << "\t";
+    if (mappedPsl != NULL) {
+        liftInfoFh << mappedPsl->tName << "\t" << mappedPsl->tStart << "\t" << mappedPsl->tEnd << "\t"
+                   << normStrand(mappedPsl->strand[1]) << "\t" << mappedBases;
+    } else {
+        liftInfoFh << "\t\t\t\t";
+    }
+    liftInfoFh << endl;
+}
+
+/* Lift the thick range of an interval starting at start through a mapping
+ * of the interval.  The result is the bounds of the mapped parts of the thick
+ * range, or an empty range at the mapped start if none of it mapped. */
+void IntervalLifter::liftThickRange(struct psl* mappedPsl,
+                                    int start,
+                                    int thickStart,
+                                    int thickEnd,
+                                    int& mappedThickStart,
+                                    int& mappedThickEnd) const {
+    // mapped PSL query is the interval, on the positive strand
+    int qThickStart = thickStart - start, qThickEnd = thickEnd - start;
+    mappedThickStart = mappedThickEnd = -1;
+    for (unsigned iBlk = 0; iBlk < mappedPsl->blockCount; iBlk++) {
+        int qStart = max(qThickStart, int(pslQStart(mappedPsl, iBlk)));
+        int qEnd = min(qThickEnd, int(pslQEnd(mappedPsl, iBlk)));
+        if (qStart < qEnd) {
+            int tStart = pslTStart(mappedPsl, iBlk) + (qStart - pslQStart(mappedPsl, iBlk));
+            int tEnd = tStart + (qEnd - qStart);
+            if (normStrand(mappedPsl->strand[1]) == '-') {
+                reverseIntRange(&tStart, &tEnd, mappedPsl->tSize);
+            }
+            mappedThickStart = (mappedThickStart < 0) ? tStart : min(mappedThickStart, tStart);
+            mappedThickEnd = max(mappedThickEnd, tEnd);
+        }
+    }
+    if (mappedThickStart < 0) {
+        mappedThickStart = mappedThickEnd = mappedPsl->tStart;
+    }
+}
+
+/* output a mapped record, thickStart is -1 if the record doesn't have
+ * a thick range */
+void IntervalLifter::outputMapped(const StringVector& cols,
+                                  struct psl* mappedPsl,
+                                  int start,
+                                  int thickStart,
+                                  int thickEnd,
+                                  ostream& mappedFh) const {
+    StringVector mappedCols(cols);
+    mappedCols[0] = mappedPsl->tName;
+    mappedCols[1] = toString(mappedPsl->tStart);
+    mappedCols[2] = toString(mappedPsl->tEnd);
+    if (thickStart >= 0) {
+        int mappedThickStart, mappedThickEnd;
+        liftThickRange(mappedPsl, start, thickStart, thickEnd, mappedThickStart, mappedThickEnd);
+        mappedCols[6] = toString(mappedThickStart);
+        mappedCols[7] = toString(mappedThickEnd);
+    }
+    if ((mappedCols.size() >= 6) and (normStrand(mappedPsl->strand[1]) == '-')) {
+        if (mappedCols[5] == "+") {
+            mappedCols[5] = "-";
+        } else if (mappedCols[5] == "-") {
+            mappedCols[5] = "+";
+        }
+    }
+    mappedFh << stringJoin(mappedCols, '\t') << endl;
+}
+
+/* lift one line */
+void IntervalLifter::liftInterval(const string& line,
+                                  long lineNum,
+                                  LiftOutput& liftOutput) const {
+    if (isPassThroughLine(line)) {
+        liftOutput.mapped << line << endl;
+        return;
+    }
+    StringVector cols = stringSplit(line, '\t');
+    bool startOk = false, endOk = false;
+    int start = (cols.size() >= 3) ? stringToInt(cols[1], &startOk) : 0;
+    int end = (cols.size() >= 3) ? stringToInt(cols[2], &endOk) : 0;
+    if ((not startOk) or (not endOk) or (start < 0) or (end < start)) {
+        throw invalid_argument("invalid interval on line " + toString(lineNum) + ": " + line);
+    }
+    if (cols.size() < fBedFields) {
+        throw invalid_argument("expected at least " + toString(fBedFields) + " BED fields on line "
+                               + toString(lineNum) + ": " + line);
+    }
+    int thickStart = -1, thickEnd = -1;
+    if (fBedFields >= 8) {
+        bool thickStartOk = false, thickEndOk = false;
+        thickStart = stringToInt(cols[6], &thickStartOk);
+        thickEnd = stringToInt(cols[7], &thickEndOk);
+        if ((not thickStartOk) or (not thickEndOk) or (thickEnd < thickStart)) {
+            throw invalid_argument("invalid thickStart or thickEnd on line " + toString(lineNum) + ": " + line);
+        }
+    }
+    const string& chrom = cols[0];
+    string name = (cols.size() >= 4) ? cols[3] : chrom + ":" + cols[1] + "-" + cols[2];
+    liftOutput.counts.numIntervals++;
+
+    RemapStatus unmappedStatus = REMAP_STATUS_NONE;
+    if (not fTransMap->haveQuerySeq(chrom)) {
+        unmappedStatus = REMAP_STATUS_NO_SEQ_MAP;
+    } else if (start == end) {
+        unmappedStatus = REMAP_STATUS_INELIGIBLE;
+    } else {
+        if (end > fTransMap->getQuerySeqSize(chrom)) {
+            throw invalid_argument("interval end on line " + toString(lineNum) + " is greater than " + chrom
+                                   + " mapping alignment query size " + toString(fTransMap->getQuerySeqSize(chrom))
+                                   + ", does the mapping alignment need swapped?");
+        }
+        struct psl* inPsl = intervalToPsl(name, chrom, start, end);
+        PslVector mappedPsls = fTransMap->mapPsl(inPsl);
+        pslFree(&inPsl);
+        if (mappedPsls.size() == 0) {
+            unmappedStatus = REMAP_STATUS_DELETED;
+        } else {
+            liftOutput.counts.numMapped++;
+        }
+        for (int i = 0; i < mappedPsls.size(); i++) {
+            int mappedBases;
+            RemapStatus mappingStatus = getMappingStatus(mappedPsls[i], end - start, mappedBases);
+            outputMapped(cols, mappedPsls[i], start, thickStart, thickEnd, liftOutput.mapped);
+            outputLiftInfo(cols, name, mappingStatus, mappedPsls.size(), mappedPsls[i], mappedBases, liftOutput.liftInfo);
+            liftOutput.counts.numMappings++;
+        }
+        mappedPsls.free();
+    }
+    if (unmappedStatus != REMAP_STATUS_NONE) {
+        liftOutput.unmapped << line << endl;
+        outputLiftInfo(cols, name, unmappedStatus, 0, NULL, 0, liftOutput.liftInfo);
+    }
+}
+
+/* lift a range of lines of a batch */
+void IntervalLifter::liftLines(const StringVector& lines,
+                               long firstLineNum,
+                               size_t iStart,
+                               size_t iEnd,
+                               LiftOutput& liftOutput) const {
+    for (size_t i = iStart; i < iEnd; i++) {
+        liftInterval(lines[i], firstLineNum + i, liftOutput);
+    }
+}
+
+/* Lift a batch of lines, dividing them between threads and writing the
+ * results in input order. */
+void IntervalLifter::liftBatch(const StringVector& lines,
+                               long firstLineNum,
+                               ostream& mappedFh,
+                               ostream* unmappedFh,
+                               ostream* liftInfoFh,
+                               LiftCounts& counts) const {
+    size_t numChunks = min(size_t(fNumThreads), lines.size());
+    size_t chunkSize = (lines.size() + numChunks - 1) / numChunks;
+    vector<LiftOutput*> liftOutputs;
+    vector<exception_ptr> errors(numChunks);
+    vector<std::thread> threads;
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        liftOutputs.push_back(new LiftOutput());
+    }
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        size_t iStart = iChunk * chunkSize;
+        size_t iEnd = min(iStart + chunkSize, lines.size());
+        LiftOutput* liftOutput = liftOutputs[iChunk];
+        exception_ptr* error = &errors[iChunk];
+        threads.push_back(std::thread([=, &lines]() {
+            try {
+                liftLines(lines, firstLineNum, iStart, iEnd, *liftOutput);
+            } catch (...) {
+                *error = current_exception();
+            }
+        }));
+    }
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        threads[iChunk].join();
+    }
+    exception_ptr error;
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        if ((error == NULL) and (errors[iChunk] != NULL)) {
+            error = errors[iChunk];
+        }
+        if (error == NULL) {
+            mappedFh << liftOutputs[iChunk]->mapped.str();
+            if (unmappedFh != NULL) {
+                *unmappedFh << liftOutputs[iChunk]->unmapped.str();
+            }
+            if (liftInfoFh != NULL) {
+                *liftInfoFh << liftOutputs[iChunk]->liftInfo.str();
+            }
+            counts.add(liftOutputs[iChunk]->counts);
+        }
+        delete liftOutputs[iChunk];
+    }
+    if (error != NULL) {
+        rethrow_exception(error);
+    }
+}
+
+/* lift all intervals from a stream. */
+LiftCounts IntervalLifter::lift(istream& inFh,
+                                ostream& mappedFh,
+                                ostream* unmappedFh,
+                                ostream* liftInfoFh) const {
+    LiftCounts counts;
+    if (liftInfoFh != NULL) {
+        outputLiftInfoHeader(*liftInfoFh);
+    }
+    StringVector lines;
+    long firstLineNum = 1;
+    string line;
+    while (getline(inFh, line)) {
+        lines.push_back(line);
+        if (lines.size() >= fBatchSize) {
+            liftBatch(lines, firstLineNum, mappedFh, unmappedFh, liftInfoFh, counts);
+            firstLineNum += lines.size();
+            lines.clear();
+        }
+    }
+    if (lines.size() > 0) {
+        liftBatch(lines, firstLineNum, mappedFh, unmappedFh, liftInfoFh, counts);
+    }
+    return counts;
+}
@@ -0,0 +1,127 @@
+/*
+ * Lift BED/TSV intervals through mapping alignments.
+ */
+#ifndef intervalLifter_hh
+#define intervalLifter_hh
+#include "typeOps.hh"
+#include "remapStatus.hh"
+#include <iostream>
+#include <sstream>
+class TransMap;
+struct psl;
+
+/* counts of intervals lifted */
+class LiftCounts {
+    public:
+    long numIntervals;  // intervals read
+    long numMapped;     // intervals with at least one mapping
+    long numMappings;   // mapped records written
+
+    /* constructor */
+    LiftCounts():
+        numIntervals(0), numMapped(0), numMappings(0) {
+    }
+
+    /* sum counts */
+    void add(const LiftCounts& other) {
+        numIntervals += other.numIntervals;
+        numMapped += other.numMapped;
+        numMappings += other.numMappings;
+    }
+};
+
+/*
+ * Lift intervals in a BED-like TSV through the genomic mapping alignments.
+ * The first three columns must be chrom, start, and end.  If there are at
+ * least four columns, the fourth is used as the name, and if the sixth is a
+ * strand, it is adjusted for mappings to the opposite strand.  If the input
+ * is declared as BED with at least eight fields, the seventh and eighth are
+ * thickStart and thickEnd, which are lifted to the bounds of the mapped part
+ * of the thick region, or set to the mapped start if none of it is mapped.
+ * Other columns are passed through unchanged, so BED-like formats such as
+ * narrowPeak can be lifted.  Blank lines and lines starting with `#', `track'
+ * or `browser' are copied to the mapped output.
+ *
+ * Each mapping alignment that an interval projects through results in a
+ * separate mapped record, with the bounds of the mapped part of the interval.
+ * Input is read in batches of lines that are divided between threads; output
+ * order is the same as the input order.
+ */
+class IntervalLifter {
+    private:
+    /* output from mapping part of a batch */
+    class LiftOutput {
+        public:
+        ostringstream mapped;
+        ostringstream unmapped;
+        ostringstream liftInfo;
+        LiftCounts counts;
+    };
+
+    const TransMap* fTransMap;
+    int fNumThreads;
+    int fBatchSize;
+    int fBedFields;  // number of standard BED fields, or 0 if not BED
+
+    static void outputLiftInfoHeader(ostream& liftInfoFh);
+    static bool isPassThroughLine(const string& line);
+    struct psl* intervalToPsl(const string& qName,
+                              const string& chrom,
+                              int start,
+                              int end) const;
+    RemapStatus getMappingStatus(struct psl* mappedPsl,
+                                 int size,
+                                 int& mappedBases) const;
+    void outputLiftInfo(const StringVector& cols,
+                        const string& name,
+                        RemapStatus mappingStatus,
+                        int mappingCount,
+                        struct psl* mappedPsl,
+                        int mappedBases,
+                        ostream& liftInfoFh) const;
+    void liftThickRange(struct psl* mappedPsl,
+                        int start,
+                        int thickStart,
+                        int thickEnd,
+                        int& mappedThickStart,
+                        int& mappedThickEnd) const;
+    void outputMapped(const StringVector& cols,
+                      struct psl* mappedPsl,
+                      int start,
+                      int thickStart,
+                      int thickEnd,
+                      ostream& mappedFh) const;
+    void liftInterval(const string& line,
+                      long lineNum,
+                      LiftOutput& liftOutput) const;
+    void liftLines(const StringVector& lines,
+                   long firstLineNum,
+                   size_t iStart,
+                   size_t iEnd,
+                   LiftOutput& liftOutput) const;
+    void liftBatch(const StringVector& lines,
+                   long firstLineNum,
+                   ostream& mappedFh,
+                   ostream* unmappedFh,
+                   ostream* liftInfoFh,
+                   LiftCounts& counts) const;
+
+    public:
+    /* Constructor.  If bedFields is not zero, the input is BED with that
+     * number of standard fields, which must be less than 10, as BED12 blocks
+     * are not lifted. */
+    IntervalLifter(const TransMap* transMap,
+                   int numThreads,
+                   int batchSize,
+                   int bedFields = 0);
+
+    /* lift all intervals from a stream.  Unmapped intervals are written to
+     * unmappedFh and the status of each interval to liftInfoFh, if they are
+     * not NULL. */
+    LiftCounts lift(istream& inFh,
+                    ostream& mappedFh,
+                    ostream* unmappedFh,
+                    ostream* liftInfoFh) const;
+};
+
+#endif
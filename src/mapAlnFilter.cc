@@ -0,0 +1,58 @@
+/*
+ * Selection of mapping alignments to keep when loading.
+ */
+#include "mapAlnFilter.hh"
+#include "jkinclude.hh"
+#include "typeOps.hh"
+#include "featureIO.hh"
+
+/* constructor */
+MapAlnFilter::MapAlnFilter(int padding,
+                           int minScore,
+                           int minAlignedSize):
+    fSpans(NULL),
+    fPadding(padding),
+    fMinScore(minScore),
+    fMinAlignedSize(minAlignedSize) {
+}
+
+/* destructor */
+MapAlnFilter::~MapAlnFilter() {
+    if (fSpans != NULL) {
+        genomeRangeTreeFree(&fSpans);
+    }
+}
+
+/* add a span of the query sequences */
+void MapAlnFilter::addSpan(const string& seqid,
+                           int start,
+                           int end) {
+    if (fSpans == NULL) {
+        fSpans = genomeRangeTreeNew();
+    }
+    genomeRangeTreeAdd(fSpans, toCharStr(seqid), max(start - fPadding, 0), end + fPadding);
+}
+
+/* add the spans of the genes in a GxF file */
+void MapAlnFilter::addGxfGeneSpans(const string& gxfFile) {
+    vector<GxfGeneSpan> geneSpans = loadGxfGeneSpans(gxfFile);
+    for (size_t i = 0; i < geneSpans.size(); i++) {
+        addSpan(geneSpans[i].seqid, geneSpans[i].start - 1, geneSpans[i].end);
+    }
+}
+
+/* should a mapping alignment be kept based on its location and size? */
+bool MapAlnFilter::keepAlign(const struct psl* mapPsl) const {
+    if (fMinAlignedSize > 0) {
+        int alignedSize = 0;
+        for (unsigned iBlk = 0; iBlk < mapPsl->blockCount; iBlk++) {
+            alignedSize += mapPsl->blockSizes[iBlk];
+        }
+        if (alignedSize < fMinAlignedSize) {
+            return false;
+        }
+    }
+    // doesn't modify the tree, so it can be called from multiple threads
+    return (fSpans == NULL)
+        or genomeRangeTreeOverlaps(fSpans, mapPsl->qName, mapPsl->qStart, mapPsl->qEnd);
+}
@@ -0,0 +1,54 @@
+/*
+ * Selection of mapping alignments to keep when loading.
+ */
+#ifndef mapAlnFilter_hh
+#define mapAlnFilter_hh
+#include <string>
+using namespace std;
+
+struct genomeRangeTree;
+struct psl;
+
+/*
+ * Criteria for pruning mapping alignments as they are loaded.  Alignments
+ * can be restricted to those whose query overlaps the spans of the
+ * annotations being mapped, extended by a padding, and to those with a
+ * minimum score or number of aligned bases.  If no spans are added, the
+ * alignments are not restricted by location.  Once built, this may be used
+ * from multiple threads.
+ */
+class MapAlnFilter {
+    private:
+    struct genomeRangeTree* fSpans;  // NULL if not restricted by location
+    int fPadding;
+    int fMinScore;
+    int fMinAlignedSize;
+
+    public:
+    /* constructor */
+    MapAlnFilter(int padding,
+                 int minScore,
+                 int minAlignedSize);
+
+    /* destructor */
+    ~MapAlnFilter();
+
+    /* add a span of the query sequences, in zero-based, half-open
+     * coordinates.  The padding is added. */
+    void addSpan(const string& seqid,
+                 int start,
+                 int end);
+
+    /* add the spans of the genes in a GxF file */
+    void addGxfGeneSpans(const string& gxfFile);
+
+    /* does a score pass the minimum?  Only chains have scores. */
+    bool keepScore(double score) const {
+        return score >= fMinScore;
+    }
+
+    /* should a mapping alignment be kept based on its location and size? */
+    bool keepAlign(const struct psl* mapPsl) const;
+};
+
+#endif
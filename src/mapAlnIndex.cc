@@ -0,0 +1,95 @@
+/*
+ * Position-sorted index of mapping alignments for sweep lookups.
+ */
+#include "mapAlnIndex.hh"
+#include <stdexcept>
+
+/* destructor */
+MapAlnIndex::~MapAlnIndex() {
+    for (SeqIndexMap::iterator it = fSeqIndexes.begin(); it != fSeqIndexes.end(); it++) {
+        delete it->second;
+    }
+}
+
+/* Find the first range ending after start, galloping from the cursor and
+ * then doing a binary search in the bracketed ranges.  Range ends increase,
+ * all ranges before lo end at or before start and all ranges from hi on
+ * end after it. */
+size_t MapAlnIndex::findFirstRange(const SeqIndex* seqIndex,
+                                   int start) {
+    const vector<Range>& ranges = seqIndex->ranges;
+    size_t numRanges = ranges.size();
+    size_t cursor = seqIndex->cursor.load(memory_order_relaxed);
+    if (cursor > numRanges) {
+        cursor = numRanges;
+    }
+    size_t lo, hi;
+    size_t step = 1;
+    if ((cursor < numRanges) and (ranges[cursor].end <= start)) {
+        // forward
+        lo = cursor + 1;
+        hi = lo;
+        while ((hi < numRanges) and (ranges[hi].end <= start)) {
+            lo = hi + 1;
+            hi = lo + step;
+            step *= 2;
+        }
+        if (hi > numRanges) {
+            hi = numRanges;
+        }
+    } else {
+        // backward
+        hi = cursor;
+        lo = hi;
+        while ((lo > 0) and (ranges[lo - 1].end > start)) {
+            hi = lo - 1;
+            lo = (hi > step) ? hi - step : 0;
+            step *= 2;
+        }
+    }
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ranges[mid].end <= start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    seqIndex->cursor.store(lo, memory_order_relaxed);
+    return lo;
+}
+
+/* add a range of overlapping alignments */
+void MapAlnIndex::addRange(const string& seqName,
+                           int start,
+                           int end,
+                           const vector<unsigned>& alns) {
+    SeqIndex*& seqIndex = fSeqIndexes[seqName];
+    if (seqIndex == NULL) {
+        seqIndex = new SeqIndex();
+    }
+    if ((seqIndex->ranges.size() > 0) and (start < seqIndex->ranges.back().end)) {
+        throw logic_error("MapAlnIndex::addRange ranges not added in order for " + seqName);
+    }
+    Range range = {start, end, unsigned(seqIndex->alns.size()), unsigned(alns.size())};
+    seqIndex->ranges.push_back(range);
+    seqIndex->alns.insert(seqIndex->alns.end(), alns.begin(), alns.end());
+}
+
+/* get the indexes of the alignments overlapping a range */
+void MapAlnIndex::getOverlapping(const string& seqName,
+                                 int start,
+                                 int end,
+                                 vector<unsigned>& alns) const {
+    SeqIndexMap::const_iterator it = fSeqIndexes.find(seqName);
+    if (it == fSeqIndexes.end()) {
+        return;
+    }
+    const SeqIndex* seqIndex = it->second;
+    for (size_t iRange = findFirstRange(seqIndex, start);
+         (iRange < seqIndex->ranges.size()) and (seqIndex->ranges[iRange].start < end); iRange++) {
+        const Range& range = seqIndex->ranges[iRange];
+        alns.insert(alns.end(), seqIndex->alns.begin() + range.firstAln,
+                    seqIndex->alns.begin() + range.firstAln + range.alnCount);
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Position-sorted index of mapping alignments for sweep lookups.
+ */
+#ifndef mapAlnIndex_hh
+#define mapAlnIndex_hh
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+using namespace std;
+
+/*
+ * Index of mapping alignments on the query sequences.  Alignments that
+ * overlap are grouped into disjoint ranges, which are kept sorted by
+ * position in a flat array for each sequence, so both the starts and the
+ * ends of the ranges increase.  Lookups don't start from the root: each
+ * sequence has a cursor at the last range found, and the search gallops
+ * forward (or back) from it.  As source genes arrive in position order,
+ * this is a sweep over the ranges, with a lookup costing little more than
+ * stepping past the ranges between consecutive transcripts.
+ *
+ * The index is read-only once built, so it may be queried from multiple
+ * threads.  The cursor is only a hint; a lookup from a stale or
+ * concurrently updated cursor is slower, not wrong.
+ */
+class MapAlnIndex {
+    private:
+    /* range of overlapping alignments */
+    struct Range {
+        int start;
+        int end;
+        unsigned firstAln;  // index in alignment array
+        unsigned alnCount;
+    };
+
+    /* ranges on one sequence */
+    struct SeqIndex {
+        vector<Range> ranges;
+        vector<unsigned> alns;
+        mutable atomic<size_t> cursor;
+
+        SeqIndex():
+            cursor(0) {
+        }
+    };
+    typedef unordered_map<string, SeqIndex*> SeqIndexMap;
+
+    SeqIndexMap fSeqIndexes;
+
+    static size_t findFirstRange(const SeqIndex* seqIndex,
+                                 int start);
+
+    public:
+    /* constructor */
+    MapAlnIndex() {
+    }
+
+    /* destructor */
+    ~MapAlnIndex();
+
+    /* Add a range of overlapping alignments.  Ranges must be added in
+     * position order for each sequence and not overlap.  The alignment
+     * order is kept in the results. */
+    void addRange(const string& seqName,
+                  int start,
+                  int end,
+                  const vector<unsigned>& alns);
+
+    /* Get the indexes of the alignments in all ranges overlapping a range of
+     * a sequence, in position order. */
+    void getOverlapping(const string& seqName,
+                        int start,
+                        int end,
+                        vector<unsigned>& alns) const;
+};
+
+#endif
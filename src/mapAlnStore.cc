@@ -0,0 +1,79 @@
+/*
+ * Compact storage of mapping alignments.
+ */
+#include "mapAlnStore.hh"
+#include <stdexcept>
+
+/* get the id of a sequence name, adding it if needed */
+int MapAlnStore::getSeqId(const char* seqName) {
+    unordered_map<string, int>::const_iterator it = fSeqIds.find(seqName);
+    if (it != fSeqIds.end()) {
+        return it->second;
+    }
+    int seqId = fSeqNames.size();
+    fSeqNames.push_back(seqName);
+    fSeqIds[seqName] = seqId;
+    return seqId;
+}
+
+/* add an alignment */
+unsigned MapAlnStore::add(const struct psl* psl) {
+    if (psl->qSequence != NULL) {
+        throw invalid_argument(string("mapping alignments with sequences are not supported: ") + psl->qName);
+    }
+    MapAln mapAln;
+    mapAln.match = psl->match;
+    mapAln.misMatch = psl->misMatch;
+    mapAln.repMatch = psl->repMatch;
+    mapAln.nCount = psl->nCount;
+    mapAln.qNumInsert = psl->qNumInsert;
+    mapAln.qBaseInsert = psl->qBaseInsert;
+    mapAln.tNumInsert = psl->tNumInsert;
+    mapAln.tBaseInsert = psl->tBaseInsert;
+    mapAln.qSeqId = getSeqId(psl->qName);
+    mapAln.qSize = psl->qSize;
+    mapAln.qStart = psl->qStart;
+    mapAln.qEnd = psl->qEnd;
+    mapAln.tSeqId = getSeqId(psl->tName);
+    mapAln.tSize = psl->tSize;
+    mapAln.tStart = psl->tStart;
+    mapAln.tEnd = psl->tEnd;
+    mapAln.qStrand = strandToInt(psl->strand[0]);
+    mapAln.tStrand = strandToInt(psl->strand[1]);
+    mapAln.firstBlock = fBlockSizes.size();
+    mapAln.blockCount = psl->blockCount;
+    fBlockSizes.insert(fBlockSizes.end(), psl->blockSizes, psl->blockSizes + psl->blockCount);
+    fQStarts.insert(fQStarts.end(), psl->qStarts, psl->qStarts + psl->blockCount);
+    fTStarts.insert(fTStarts.end(), psl->tStarts, psl->tStarts + psl->blockCount);
+    fMapAlns.push_back(mapAln);
+    return fMapAlns.size() - 1;
+}
+
+/* Fill in a psl that references an alignment in the store. */
+void MapAlnStore::getPsl(unsigned iAln,
+                         struct psl* psl) const {
+    const MapAln& mapAln = fMapAlns[iAln];
+    memset(psl, 0, sizeof(struct psl));
+    psl->match = mapAln.match;
+    psl->misMatch = mapAln.misMatch;
+    psl->repMatch = mapAln.repMatch;
+    psl->nCount = mapAln.nCount;
+    psl->qNumInsert = mapAln.qNumInsert;
+    psl->qBaseInsert = mapAln.qBaseInsert;
+    psl->tNumInsert = mapAln.tNumInsert;
+    psl->tBaseInsert = mapAln.tBaseInsert;
+    psl->strand[0] = strandToChar(mapAln.qStrand);
+    psl->strand[1] = strandToChar(mapAln.tStrand);
+    psl->qName = const_cast<char*>(fSeqNames[mapAln.qSeqId].c_str());
+    psl->qSize = mapAln.qSize;
+    psl->qStart = mapAln.qStart;
+    psl->qEnd = mapAln.qEnd;
+    psl->tName = const_cast<char*>(fSeqNames[mapAln.tSeqId].c_str());
+    psl->tSize = mapAln.tSize;
+    psl->tStart = mapAln.tStart;
+    psl->tEnd = mapAln.tEnd;
+    psl->blockCount = mapAln.blockCount;
+    psl->blockSizes = const_cast<unsigned*>(fBlockSizes.data()) + mapAln.firstBlock;
+    psl->qStarts = const_cast<unsigned*>(fQStarts.data()) + mapAln.firstBlock;
+    psl->tStarts = const_cast<unsigned*>(fTStarts.data()) + mapAln.firstBlock;
+}
@@ -0,0 +1,80 @@
+/*
+ * Compact storage of mapping alignments.
+ */
+#ifndef mapAlnStore_hh
+#define mapAlnStore_hh
+#include "jkinclude.hh"
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+using namespace std;
+
+/*
+ * Mapping alignments stored as a structure of arrays rather than as
+ * individually allocated kent psl objects.  The blocks of all alignments
+ * are kept in contiguous arrays and sequence names are stored once.  A psl
+ * referencing the stored arrays can be obtained to pass to kent functions.
+ * Alignments can't be modified once added and the store may be read from
+ * multiple threads once it is complete.
+ */
+class MapAlnStore {
+    private:
+    /* fixed-size part of an alignment */
+    struct MapAln {
+        unsigned match;
+        unsigned misMatch;
+        unsigned repMatch;
+        unsigned nCount;
+        unsigned qNumInsert;
+        int qBaseInsert;
+        unsigned tNumInsert;
+        int tBaseInsert;
+        int qSeqId;
+        unsigned qSize;
+        int qStart;
+        int qEnd;
+        int tSeqId;
+        unsigned tSize;
+        int tStart;
+        int tEnd;
+        signed char qStrand;  // +1 or -1
+        signed char tStrand;  // +1, -1, or 0 if not specified
+        unsigned firstBlock;  // index in block arrays
+        unsigned blockCount;
+    };
+
+    vector<MapAln> fMapAlns;
+    vector<unsigned> fBlockSizes;
+    vector<unsigned> fQStarts;
+    vector<unsigned> fTStarts;
+    deque<string> fSeqNames;  // deque, so names don't move
+    unordered_map<string, int> fSeqIds;
+
+    int getSeqId(const char* seqName);
+
+    /* convert between strand characters and integers */
+    static signed char strandToInt(char strand) {
+        return (strand == '+') ? 1 : ((strand == '-') ? -1 : 0);
+    }
+    static char strandToChar(signed char strand) {
+        return (strand > 0) ? '+' : ((strand < 0) ? '-' : '\0');
+    }
+
+    public:
+    /* add an alignment, which is copied.  Returns the index of the
+     * alignment.  */
+    unsigned add(const struct psl* psl);
+
+    /* number of alignments */
+    unsigned size() const {
+        return fMapAlns.size();
+    }
+
+    /* Fill in a psl that references an alignment in the store.  It must not
+     * be modified or freed and is only valid while the store exists. */
+    void getPsl(unsigned iAln,
+                struct psl* psl) const;
+};
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Records describing the mapping of each gene and transcript.
+ */
+#include "mappingInfo.hh"
+#include "feature.hh"
+#include "typeOps.hh"
+#include <stdexcept>
+
+/*  mapinfo TSV headers, terminated by NULL */
+static const char* mappingInfoHeaders[] = {
+    "geneNum", "recType", "featType",
+    "featId", "featOttId", "featName", "featBiotype", "featChrom", "featStart", "featEnd", "featStrand",
+    "mappingStatus", "mappingCount", "targetStatus", NULL
+};
+
+/* constructor from a feature */
+MappingInfo::MappingInfo(int geneNum,
+                         const string& recType,
+                         const string& featType,
+                         const Feature* feature,
+                         RemapStatus mappingStatus,
+                         int mappingCount,
+                         TargetStatus targetStatus):
+    geneNum(geneNum),
+    recType(recType),
+    featType(featType),
+    featId(feature->getTypeId()),
+    featOttId(feature->getHavanaTypeId()),
+    featName(feature->getTypeName()),
+    featBiotype(feature->getTypeBiotype()),
+    featChrom(feature->getSeqid()),
+    featStart(feature->getStart()),
+    featEnd(feature->getEnd()),
+    featStrand(feature->getStrand()),
+    mappingStatus(mappingStatus),
+    mappingCount(mappingCount),
+    targetStatus(targetStatus) {
+}
+
+/* constructor, writes the header */
+MappingInfoTsvWriter::MappingInfoTsvWriter(ostream& out):
+    fOut(out) {
+    for (int i = 0; mappingInfoHeaders[i] != NULL; i++) {
+        if (i > 0) {
+            fOut << "\t";
+        }
+        fOut << mappingInfoHeaders[i];
+    }
+    fOut << endl;
+}
+
+/* write a record */
+void MappingInfoTsvWriter::write(const MappingInfo& mappingInfo) {
+    fOut << mappingInfo.geneNum << "\t"
+         << mappingInfo.recType << "\t"
+         << mappingInfo.featType << "\t"
+         << mappingInfo.featId << "\t"
+         << mappingInfo.featOttId << "\t"
+         << mappingInfo.featName << "\t"
+         << mappingInfo.featBiotype << "\t"
+         << mappingInfo.featChrom << "\t"
+         << mappingInfo.featStart << "\t"
+         << mappingInfo.featEnd << "\t"
+         << mappingInfo.featStrand << "\t"
+         << remapStatusToStr(mappingInfo.mappingStatus) << "\t"
+         << mappingInfo.mappingCount << "\t"
+         << targetStatusToStr(mappingInfo.targetStatus)
+         << endl;
+}
+
+/* parse an integer column */
+static int parseIntCol(const string& val,
+                       long lineNum) {
+    bool isOk;
+    int num = stringToInt(val, &isOk);
+    if (not isOk) {
+        throw invalid_argument("invalid integer \"" + val + "\" in mapping info TSV line " + toString(lineNum));
+    }
+    return num;
+}
+
+/* constructor, reads and validates the header */
+MappingInfoTsvReader::MappingInfoTsvReader(istream& in):
+    fIn(in), fLineNum(0) {
+    string line;
+    if (not getline(fIn, line)) {
+        throw invalid_argument("empty mapping info TSV");
+    }
+    checkHeader(line);
+}
+
+/* constructor when the header has already been read */
+MappingInfoTsvReader::MappingInfoTsvReader(istream& in,
+                                           const string& headerLine):
+    fIn(in), fLineNum(0) {
+    checkHeader(headerLine);
+}
+
+/* validate the header line */
+void MappingInfoTsvReader::checkHeader(const string& line) {
+    fLineNum++;
+    StringVector cols = stringSplit(line, '\t');
+    for (int i = 0; mappingInfoHeaders[i] != NULL; i++) {
+        if ((i >= cols.size()) or (cols[i] != mappingInfoHeaders[i])) {
+            throw invalid_argument("not a mapping info TSV, expected column " + toString(i)
+                                   + " to be " + mappingInfoHeaders[i]);
+        }
+    }
+}
+
+/* read the next record, returning false at the end */
+bool MappingInfoTsvReader::read(MappingInfo& mappingInfo) {
+    string line;
+    if (not getline(fIn, line)) {
+        return false;
+    }
+    fLineNum++;
+    StringVector cols = stringSplit(line, '\t');
+    if (cols.size() != 14) {
+        throw invalid_argument("expected 14 columns in mapping info TSV line " + toString(fLineNum)
+                               + ", got " + toString(int(cols.size())));
+    }
+    mappingInfo.geneNum = parseIntCol(cols[0], fLineNum);
+    mappingInfo.recType = cols[1];
+    mappingInfo.featType = cols[2];
+    mappingInfo.featId = cols[3];
+    mappingInfo.featOttId = cols[4];
+    mappingInfo.featName = cols[5];
+    mappingInfo.featBiotype = cols[6];
+    mappingInfo.featChrom = cols[7];
+    mappingInfo.featStart = parseIntCol(cols[8], fLineNum);
+    mappingInfo.featEnd = parseIntCol(cols[9], fLineNum);
+    mappingInfo.featStrand = cols[10];
+    mappingInfo.mappingStatus = strToRemapStatus(cols[11]);
+    mappingInfo.mappingCount = parseIntCol(cols[12], fLineNum);
+    mappingInfo.targetStatus = strToTargetStatus(cols[13]);
+    return true;
+}
@@ -0,0 +1,146 @@
+/*
+ * Records describing the mapping of each gene and transcript.
+ */
+#ifndef mappingInfo_hh
+#define mappingInfo_hh
+#include "remapStatus.hh"
+#include <string>
+#include <vector>
+#include <iostream>
+using namespace std;
+class Feature;
+
+/*
+ * Information about the mapping of one gene or transcript, one row of
+ * the map-info TSV.
+ */
+class MappingInfo {
+    public:
+    int geneNum;          // groups records of a gene together
+    string recType;       // mapSrc, map, unmap, targetSubst, targetCopy, ...
+    string featType;      // gene or trans
+    string featId;
+    string featOttId;
+    string featName;
+    string featBiotype;
+    string featChrom;
+    int featStart;
+    int featEnd;
+    string featStrand;
+    RemapStatus mappingStatus;
+    int mappingCount;
+    TargetStatus targetStatus;
+
+    /* constructor, for filling in when reading */
+    MappingInfo():
+        geneNum(0), featStart(0), featEnd(0),
+        mappingStatus(REMAP_STATUS_NONE), mappingCount(0),
+        targetStatus(TARGET_STATUS_NA) {
+    }
+
+    /* constructor from a feature */
+    MappingInfo(int geneNum,
+                const string& recType,
+                const string& featType,
+                const Feature* feature,
+                RemapStatus mappingStatus,
+                int mappingCount,
+                TargetStatus targetStatus);
+};
+
+/* vector of mapping info records */
+class MappingInfoVector: public vector<MappingInfo> {
+};
+
+/*
+ * Interface to receive mapping info records as they are produced.
+ */
+class MappingInfoWriter {
+    public:
+    /* destructor */
+    virtual ~MappingInfoWriter() {
+    }
+
+    /* write a record */
+    virtual void write(const MappingInfo& mappingInfo) = 0;
+};
+
+/*
+ * Write mapping info records as TSV, with a header.
+ */
+class MappingInfoTsvWriter: public MappingInfoWriter {
+    private:
+    ostream& fOut;
+
+    public:
+    /* constructor, writes the header */
+    MappingInfoTsvWriter(ostream& out);
+
+    /* write a record */
+    virtual void write(const MappingInfo& mappingInfo);
+};
+
+/*
+ * Read mapping info records from a TSV with a header.
+ */
+class MappingInfoTsvReader {
+    private:
+    istream& fIn;
+    long fLineNum;
+
+    void checkHeader(const string& line);
+
+    public:
+    /* constructor, reads and validates the header */
+    MappingInfoTsvReader(istream& in);
+
+    /* constructor when the header has already been read from in, it is
+     * validated */
+    MappingInfoTsvReader(istream& in,
+                         const string& headerLine);
+
+    /* read the next record, returning false at the end */
+    bool read(MappingInfo& mappingInfo);
+};
+
+/*
+ * Write mapping info records to multiple writers, which are not owned.
+ */
+class MappingInfoMultiWriter: public MappingInfoWriter {
+    private:
+    vector<MappingInfoWriter*> fWriters;
+
+    public:
+    /* add a writer */
+    void add(MappingInfoWriter* writer) {
+        fWriters.push_back(writer);
+    }
+
+    /* write a record */
+    virtual void write(const MappingInfo& mappingInfo) {
+        for (size_t i = 0; i < fWriters.size(); i++) {
+            fWriters[i]->write(mappingInfo);
+        }
+    }
+};
+
+/*
+ * Collect mapping info records in a vector.
+ */
+class MappingInfoCollector: public MappingInfoWriter {
+    private:
+    MappingInfoVector& fMappingInfos;
+
+    public:
+    /* constructor */
+    MappingInfoCollector(MappingInfoVector& mappingInfos):
+        fMappingInfos(mappingInfos) {
+    }
+
+    /* write a record */
+    virtual void write(const MappingInfo& mappingInfo) {
+        fMappingInfos.push_back(mappingInfo);
+    }
+};
+
+#endif
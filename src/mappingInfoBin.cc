@@ -0,0 +1,382 @@
+/*
+ * Columnar binary format for mapping info records.
+ */
+#include "mappingInfoBin.hh"
+#include "typeOps.hh"
+#include <stdexcept>
+
+const char MappingInfoBin::MAGIC[8] = {'G', 'B', 'M', 'A', 'P', 'I', 'N', 'F'};
+
+/* schema, in the same order as the TSV */
+const MappingInfoBin::ColumnSpec MappingInfoBin::COLUMNS[] = {
+    {"geneNum", INT_COLUMN},
+    {"recType", DICT_COLUMN},
+    {"featType", DICT_COLUMN},
+    {"featId", STRING_COLUMN},
+    {"featOttId", STRING_COLUMN},
+    {"featName", STRING_COLUMN},
+    {"featBiotype", DICT_COLUMN},
+    {"featChrom", DICT_COLUMN},
+    {"featStart", INT_COLUMN},
+    {"featEnd", INT_COLUMN},
+    {"featStrand", DICT_COLUMN},
+    {"mappingStatus", DICT_COLUMN},
+    {"mappingCount", INT_COLUMN},
+    {"targetStatus", DICT_COLUMN}
+};
+const int MappingInfoBin::NUM_COLUMNS = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+/* append a little-endian uint32 */
+void MappingInfoBin::putUInt32(string& buf,
+                               uint32_t val) {
+    char bytes[4] = {char(val & 0xff), char((val >> 8) & 0xff),
+                     char((val >> 16) & 0xff), char((val >> 24) & 0xff)};
+    buf.append(bytes, 4);
+}
+
+/* get a little-endian uint32, advancing offset */
+uint32_t MappingInfoBin::getUInt32(const string& buf,
+                                   size_t& off) {
+    if (off + 4 > buf.size()) {
+        throw invalid_argument("truncated mapping info binary block");
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(buf.data() + off);
+    off += 4;
+    return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8)
+        | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+}
+
+/* append a length and bytes */
+void MappingInfoBin::putBytes(string& buf,
+                              const string& val) {
+    putUInt32(buf, val.size());
+    buf.append(val);
+}
+
+/* get bytes of the specified length, advancing offset */
+string MappingInfoBin::getBytes(const string& buf,
+                                size_t& off,
+                                uint32_t len) {
+    if (off + len > buf.size()) {
+        throw invalid_argument("truncated mapping info binary block");
+    }
+    string val = buf.substr(off, len);
+    off += len;
+    return val;
+}
+
+/* encode int column */
+void MappingInfoBin::IntColumn::encode(string& buf) const {
+    for (size_t i = 0; i < size(); i++) {
+        putUInt32(buf, uint32_t((*this)[i]));
+    }
+}
+
+/* decode int column */
+void MappingInfoBin::IntColumn::decode(const string& buf,
+                                       size_t& off,
+                                       uint32_t numRows) {
+    clear();
+    for (uint32_t i = 0; i < numRows; i++) {
+        push_back(int32_t(getUInt32(buf, off)));
+    }
+}
+
+/* add a value to a dictionary column */
+void MappingInfoBin::DictColumn::add(const string& val) {
+    map<string, uint32_t>::const_iterator it = fCodes.find(val);
+    if (it != fCodes.end()) {
+        codes.push_back(it->second);
+    } else {
+        uint32_t code = fCodes.size();
+        fCodes[val] = code;
+        fNewEntries.push_back(val);
+        codes.push_back(code);
+    }
+}
+
+/* get a decoded value */
+const string& MappingInfoBin::DictColumn::get(size_t iRow) const {
+    return fEntries[codes[iRow]];
+}
+
+/* clear codes, keeping the dictionary */
+void MappingInfoBin::DictColumn::clear() {
+    codes.clear();
+    fNewEntries.clear();
+}
+
+/* encode dictionary column with the entries added since the last block */
+void MappingInfoBin::DictColumn::encode(string& buf) {
+    putUInt32(buf, fNewEntries.size());
+    for (size_t i = 0; i < fNewEntries.size(); i++) {
+        putBytes(buf, fNewEntries[i]);
+    }
+    for (size_t i = 0; i < codes.size(); i++) {
+        putUInt32(buf, codes[i]);
+    }
+}
+
+/* decode dictionary column */
+void MappingInfoBin::DictColumn::decode(const string& buf,
+                                        size_t& off,
+                                        uint32_t numRows) {
+    uint32_t numNewEntries = getUInt32(buf, off);
+    for (uint32_t i = 0; i < numNewEntries; i++) {
+        uint32_t len = getUInt32(buf, off);
+        fEntries.push_back(getBytes(buf, off, len));
+    }
+    codes.clear();
+    for (uint32_t i = 0; i < numRows; i++) {
+        uint32_t code = getUInt32(buf, off);
+        if (code >= fEntries.size()) {
+            throw invalid_argument("invalid dictionary code in mapping info binary block");
+        }
+        codes.push_back(code);
+    }
+}
+
+/* encode string column */
+void MappingInfoBin::StringColumn::encode(string& buf) const {
+    for (size_t i = 0; i < size(); i++) {
+        putUInt32(buf, (*this)[i].size());
+    }
+    for (size_t i = 0; i < size(); i++) {
+        buf.append((*this)[i]);
+    }
+}
+
+/* decode string column */
+void MappingInfoBin::StringColumn::decode(const string& buf,
+                                          size_t& off,
+                                          uint32_t numRows) {
+    vector<uint32_t> lens;
+    for (uint32_t i = 0; i < numRows; i++) {
+        lens.push_back(getUInt32(buf, off));
+    }
+    clear();
+    for (uint32_t i = 0; i < numRows; i++) {
+        push_back(getBytes(buf, off, lens[i]));
+    }
+}
+
+/* add a record to a block */
+void MappingInfoBin::Block::add(const MappingInfo& mappingInfo) {
+    geneNum.push_back(mappingInfo.geneNum);
+    recType.add(mappingInfo.recType);
+    featType.add(mappingInfo.featType);
+    featId.push_back(mappingInfo.featId);
+    featOttId.push_back(mappingInfo.featOttId);
+    featName.push_back(mappingInfo.featName);
+    featBiotype.add(mappingInfo.featBiotype);
+    featChrom.add(mappingInfo.featChrom);
+    featStart.push_back(mappingInfo.featStart);
+    featEnd.push_back(mappingInfo.featEnd);
+    featStrand.add(mappingInfo.featStrand);
+    mappingStatus.add(remapStatusToStr(mappingInfo.mappingStatus));
+    mappingCount.push_back(mappingInfo.mappingCount);
+    targetStatus.add(targetStatusToStr(mappingInfo.targetStatus));
+}
+
+/* get a record from a block */
+void MappingInfoBin::Block::get(size_t iRow,
+                                MappingInfo& mappingInfo) const {
+    mappingInfo.geneNum = geneNum[iRow];
+    mappingInfo.recType = recType.get(iRow);
+    mappingInfo.featType = featType.get(iRow);
+    mappingInfo.featId = featId[iRow];
+    mappingInfo.featOttId = featOttId[iRow];
+    mappingInfo.featName = featName[iRow];
+    mappingInfo.featBiotype = featBiotype.get(iRow);
+    mappingInfo.featChrom = featChrom.get(iRow);
+    mappingInfo.featStart = featStart[iRow];
+    mappingInfo.featEnd = featEnd[iRow];
+    mappingInfo.featStrand = featStrand.get(iRow);
+    mappingInfo.mappingStatus = strToRemapStatus(mappingStatus.get(iRow));
+    mappingInfo.mappingCount = mappingCount[iRow];
+    mappingInfo.targetStatus = strToTargetStatus(targetStatus.get(iRow));
+}
+
+/* clear rows, keeping dictionaries */
+void MappingInfoBin::Block::clear() {
+    geneNum.clear();
+    recType.clear();
+    featType.clear();
+    featId.clear();
+    featOttId.clear();
+    featName.clear();
+    featBiotype.clear();
+    featChrom.clear();
+    featStart.clear();
+    featEnd.clear();
+    featStrand.clear();
+    mappingStatus.clear();
+    mappingCount.clear();
+    targetStatus.clear();
+}
+
+/* encode all columns, in schema order */
+void MappingInfoBin::Block::encode(string& buf) {
+    geneNum.encode(buf);
+    recType.encode(buf);
+    featType.encode(buf);
+    featId.encode(buf);
+    featOttId.encode(buf);
+    featName.encode(buf);
+    featBiotype.encode(buf);
+    featChrom.encode(buf);
+    featStart.encode(buf);
+    featEnd.encode(buf);
+    featStrand.encode(buf);
+    mappingStatus.encode(buf);
+    mappingCount.encode(buf);
+    targetStatus.encode(buf);
+}
+
+/* decode all columns */
+void MappingInfoBin::Block::decode(const string& buf,
+                                   uint32_t numRows) {
+    size_t off = 0;
+    geneNum.decode(buf, off, numRows);
+    recType.decode(buf, off, numRows);
+    featType.decode(buf, off, numRows);
+    featId.decode(buf, off, numRows);
+    featOttId.decode(buf, off, numRows);
+    featName.decode(buf, off, numRows);
+    featBiotype.decode(buf, off, numRows);
+    featChrom.decode(buf, off, numRows);
+    featStart.decode(buf, off, numRows);
+    featEnd.decode(buf, off, numRows);
+    featStrand.decode(buf, off, numRows);
+    mappingStatus.decode(buf, off, numRows);
+    mappingCount.decode(buf, off, numRows);
+    targetStatus.decode(buf, off, numRows);
+    if (off != buf.size()) {
+        throw invalid_argument("mapping info binary block size doesn't match contents");
+    }
+}
+
+/* constructor, writes the header */
+MappingInfoBinWriter::MappingInfoBinWriter(ostream& out,
+                                           int blockRows):
+    fOut(out),
+    fBlockRows(blockRows),
+    fClosed(false) {
+    writeHeader();
+}
+
+/* destructor, closes if not already closed */
+MappingInfoBinWriter::~MappingInfoBinWriter() {
+    if (not fClosed) {
+        close();
+    }
+}
+
+/* write the file header */
+void MappingInfoBinWriter::writeHeader() {
+    string buf(MappingInfoBin::MAGIC, sizeof(MappingInfoBin::MAGIC));
+    MappingInfoBin::putUInt32(buf, MappingInfoBin::VERSION);
+    MappingInfoBin::putUInt32(buf, MappingInfoBin::NUM_COLUMNS);
+    for (int i = 0; i < MappingInfoBin::NUM_COLUMNS; i++) {
+        MappingInfoBin::putBytes(buf, MappingInfoBin::COLUMNS[i].name);
+        buf += char(MappingInfoBin::COLUMNS[i].type);
+    }
+    fOut.write(buf.data(), buf.size());
+}
+
+/* write buffered records as a block, an empty block terminates the file */
+void MappingInfoBinWriter::writeBlock() {
+    string data;
+    fBlock.encode(data);
+    string buf;
+    MappingInfoBin::putUInt32(buf, fBlock.size());
+    MappingInfoBin::putUInt32(buf, data.size());
+    fOut.write(buf.data(), buf.size());
+    fOut.write(data.data(), data.size());
+    fBlock.clear();
+}
+
+/* write a record */
+void MappingInfoBinWriter::write(const MappingInfo& mappingInfo) {
+    fBlock.add(mappingInfo);
+    if (fBlock.size() >= fBlockRows) {
+        writeBlock();
+    }
+}
+
+/* write the remaining records and the terminating block */
+void MappingInfoBinWriter::close() {
+    if (fBlock.size() > 0) {
+        writeBlock();
+    }
+    writeBlock();
+    fOut.flush();
+    fClosed = true;
+}
+
+/* constructor, reads and validates the header */
+MappingInfoBinReader::MappingInfoBinReader(istream& in):
+    fIn(in),
+    fNextRow(0),
+    fAtEnd(false) {
+    readHeader();
+}
+
+/* read bytes, error if not available */
+string MappingInfoBinReader::readBytes(size_t len) {
+    string buf(len, '\0');
+    fIn.read(&buf[0], len);
+    if (fIn.gcount() != len) {
+        throw invalid_argument("unexpected EOF reading mapping info binary file");
+    }
+    return buf;
+}
+
+/* read and validate the header */
+void MappingInfoBinReader::readHeader() {
+    if (readBytes(sizeof(MappingInfoBin::MAGIC)) != string(MappingInfoBin::MAGIC, sizeof(MappingInfoBin::MAGIC))) {
+        throw invalid_argument("not a mapping info binary file");
+    }
+    size_t off = 0;
+    string buf = readBytes(8);
+    uint32_t version = MappingInfoBin::getUInt32(buf, off);
+    uint32_t numColumns = MappingInfoBin::getUInt32(buf, off);
+    if (version != MappingInfoBin::VERSION) {
+        throw invalid_argument("unsupported mapping info binary file version: " + toString(version));
+    }
+    if (numColumns != MappingInfoBin::NUM_COLUMNS) {
+        throw invalid_argument("mapping info binary file has unexpected number of columns");
+    }
+    for (int i = 0; i < MappingInfoBin::NUM_COLUMNS; i++) {
+        off = 0;
+        buf = readBytes(4);
+        string name = readBytes(MappingInfoBin::getUInt32(buf, off));
+        char type = readBytes(1)[0];
+        if ((name != MappingInfoBin::COLUMNS[i].name) or (type != MappingInfoBin::COLUMNS[i].type)) {
+            throw invalid_argument("mapping info binary file has unexpected column: " + name);
+        }
+    }
+}
+
+/* read the next block, returning false on the terminating block */
+bool MappingInfoBinReader::readBlock() {
+    size_t off = 0;
+    string buf = readBytes(8);
+    uint32_t numRows = MappingInfoBin::getUInt32(buf, off);
+    uint32_t numBytes = MappingInfoBin::getUInt32(buf, off);
+    fBlock.decode(readBytes(numBytes), numRows);
+    fNextRow = 0;
+    return numRows > 0;
+}
+
+/* read the next record, returning false at the end */
+bool MappingInfoBinReader::read(MappingInfo& mappingInfo) {
+    while ((not fAtEnd) and (fNextRow >= fBlock.size())) {
+        fAtEnd = not readBlock();
+    }
+    if (fAtEnd) {
+        return false;
+    }
+    fBlock.get(fNextRow++, mappingInfo);
+    return true;
+}
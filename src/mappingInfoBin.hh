@@ -0,0 +1,179 @@
+/*
+ * Columnar binary format for mapping info records.
+ */
+#ifndef mappingInfoBin_hh
+#define mappingInfoBin_hh
+#include "mappingInfo.hh"
+#include <map>
+#include <stdint.h>
+
+/*
+ * Mapping info records are stored in a columnar binary format that is much
+ * faster to read than the TSV.  The file starts with a header:
+ *   magic: 8 bytes "GBMAPINF"
+ *   version: uint32
+ *   numColumns: uint32
+ *   for each column: name length uint32, name bytes, column type uint8
+ * This is followed by blocks of up to a fixed number of rows:
+ *   numRows: uint32, zero for the terminating block
+ *   numBytes: uint32, size of the rest of the block
+ *   the data for each column, in header order
+ * Column data is stored depending on type:
+ *   int - numRows int32 values
+ *   dict - number of new dictionary entries uint32, each as length uint32
+ *          and bytes, followed by numRows uint32 codes.  Codes index a
+ *          dictionary that accumulates over the whole file.
+ *   string - numRows lengths uint32, followed by the concatenated bytes.
+ * All integers are little-endian.
+ */
+class MappingInfoBin {
+    public:
+    /* column types */
+    typedef enum {
+        INT_COLUMN = 0,
+        DICT_COLUMN = 1,
+        STRING_COLUMN = 2
+    } ColumnType;
+
+    /* column in schema */
+    struct ColumnSpec {
+        const char* name;
+        ColumnType type;
+    };
+
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+    static const ColumnSpec COLUMNS[];
+    static const int NUM_COLUMNS;
+
+    /* int column buffer */
+    class IntColumn: public vector<int32_t> {
+        public:
+        void encode(string& buf) const;
+        void decode(const string& buf,
+                    size_t& off,
+                    uint32_t numRows);
+    };
+
+    /* dictionary-encoded column buffer */
+    class DictColumn {
+        private:
+        map<string, uint32_t> fCodes;  // writer: dictionary
+        vector<string> fNewEntries;    // writer: added since last block
+        vector<string> fEntries;       // reader: dictionary
+
+        public:
+        vector<uint32_t> codes;
+        void add(const string& val);
+        const string& get(size_t iRow) const;
+        void clear();
+        void encode(string& buf);
+        void decode(const string& buf,
+                    size_t& off,
+                    uint32_t numRows);
+    };
+
+    /* string column buffer */
+    class StringColumn: public vector<string> {
+        public:
+        void encode(string& buf) const;
+        void decode(const string& buf,
+                    size_t& off,
+                    uint32_t numRows);
+    };
+
+    /* buffers for all columns of a block */
+    class Block {
+        public:
+        IntColumn geneNum;
+        DictColumn recType;
+        DictColumn featType;
+        StringColumn featId;
+        StringColumn featOttId;
+        StringColumn featName;
+        DictColumn featBiotype;
+        DictColumn featChrom;
+        IntColumn featStart;
+        IntColumn featEnd;
+        DictColumn featStrand;
+        DictColumn mappingStatus;
+        IntColumn mappingCount;
+        DictColumn targetStatus;
+
+        size_t size() const {
+            return geneNum.size();
+        }
+        void add(const MappingInfo& mappingInfo);
+        void get(size_t iRow,
+                 MappingInfo& mappingInfo) const;
+        void clear();
+        void encode(string& buf);
+        void decode(const string& buf,
+                    uint32_t numRows);
+    };
+
+    static void putUInt32(string& buf,
+                          uint32_t val);
+    static uint32_t getUInt32(const string& buf,
+                              size_t& off);
+    static void putBytes(string& buf,
+                         const string& val);
+    static string getBytes(const string& buf,
+                           size_t& off,
+                           uint32_t len);
+};
+
+/*
+ * Write mapping info records in columnar binary format.
+ */
+class MappingInfoBinWriter: public MappingInfoWriter {
+    private:
+    ostream& fOut;
+    int fBlockRows;
+    MappingInfoBin::Block fBlock;
+    bool fClosed;
+
+    void writeHeader();
+    void writeBlock();
+
+    public:
+    /* default number of rows in a block */
+    static const int DEFAULT_BLOCK_ROWS = 65536;
+
+    /* constructor, writes the header */
+    MappingInfoBinWriter(ostream& out,
+                         int blockRows = DEFAULT_BLOCK_ROWS);
+
+    /* destructor, closes if not already closed */
+    virtual ~MappingInfoBinWriter();
+
+    /* write a record */
+    virtual void write(const MappingInfo& mappingInfo);
+
+    /* write the remaining records and the terminating block */
+    void close();
+};
+
+/*
+ * Read mapping info records in columnar binary format.
+ */
+class MappingInfoBinReader {
+    private:
+    istream& fIn;
+    MappingInfoBin::Block fBlock;
+    size_t fNextRow;
+    bool fAtEnd;
+
+    string readBytes(size_t len);
+    void readHeader();
+    bool readBlock();
+
+    public:
+    /* constructor, reads and validates the header */
+    MappingInfoBinReader(istream& in);
+
+    /* read the next record, returning false at the end */
+    bool read(MappingInfo& mappingInfo);
+};
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * Resident mapping server, accepting requests on a Unix domain socket.
+ */
+#include "mappingServer.hh"
+#include "mappingSession.hh"
+#include "annotationSet.hh"
+#include "gxfIO.hh"
+#include "mappingInfo.hh"
+#include "globals.hh"
+#include "asyncOutput.hh"
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <iostream>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* constructor */
+MappingServer::MappingServer(const string& socketPath,
+                             const MappingSession* mappingSession,
+                             ParIdHackMethod parIdHackMethod,
+                             int numWorkers):
+    fSocketPath(socketPath),
+    fMappingSession(mappingSession),
+    fParIdHackMethod(parIdHackMethod),
+    fNumWorkers((numWorkers < 1) ? 1 : numWorkers) {
+}
+
+/* Remove an existing socket file at the path, so a server can be restarted.
+ * Anything else is not removed, so a file given by mistake isn't lost. */
+void MappingServer::removeOldSocket() const {
+    struct stat st;
+    if (lstat(fSocketPath.c_str(), &st) < 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        throw ios_base::failure("can't stat socket path \"" + fSocketPath + "\": " + strerror(errno));
+    }
+    if (not S_ISSOCK(st.st_mode)) {
+        throw invalid_argument("socket path exists and is not a socket: " + fSocketPath);
+    }
+    if (unlink(fSocketPath.c_str()) < 0) {
+        throw ios_base::failure("can't remove old socket \"" + fSocketPath + "\": " + strerror(errno));
+    }
+}
+
+/* create, bind, and listen on the socket.  An existing socket file is
+ * removed. */
+int MappingServer::openSocket() const {
+    struct sockaddr_un addr;
+    if (fSocketPath.size() >= sizeof(addr.sun_path)) {
+        throw invalid_argument("socket path too long: " + fSocketPath);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, fSocketPath.c_str());
+
+    removeOldSocket();
+    int sockFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sockFd < 0) {
+        throw ios_base::failure(string("can't create socket: ") + strerror(errno));
+    }
+    if (bind(sockFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        throw ios_base::failure("can't bind socket \"" + fSocketPath + "\": " + strerror(errno));
+    }
+    if (listen(sockFd, SOMAXCONN) < 0) {
+        throw ios_base::failure("can't listen on socket \"" + fSocketPath + "\": " + strerror(errno));
+    }
+    return sockFd;
+}
+
+/* read a request until the client closes its side */
+string MappingServer::readRequest(int connFd) const {
+    string request;
+    char buf[65536];
+    ssize_t len;
+    while ((len = read(connFd, buf, sizeof(buf))) != 0) {
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw ios_base::failure(string("error reading request: ") + strerror(errno));
+        }
+        request.append(buf, len);
+    }
+    return request;
+}
+
+/* write the complete response */
+void MappingServer::writeResponse(int connFd,
+                                  const string& response) const {
+    size_t off = 0;
+    while (off < response.size()) {
+        ssize_t len = send(connFd, response.c_str() + off, response.size() - off, MSG_NOSIGNAL);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw ios_base::failure(string("error writing response: ") + strerror(errno));
+        }
+        off += len;
+    }
+}
+
+/* map the genes in a request, returning the response */
+string MappingServer::mapRequest(const string& request) const {
+    GxfFormat gxfFormat = stringStartsWith(request, "##gff-version 3") ? GFF3_FORMAT : GTF_FORMAT;
+    istringstream requestIn(request);
+    AnnotationSet srcAnnotations(requestIn, gxfFormat);
+
+    ostringstream mappedOut, unmappedOut, mappingInfoOut;
+    MappingInfoTsvWriter mappingInfoWriter(mappingInfoOut);
+    GxfWriter* mappedGxfFh = GxfWriter::factory(mappedOut, gxfFormat, fParIdHackMethod);
+    GxfWriter* unmappedGxfFh = GxfWriter::factory(unmappedOut, gxfFormat, fParIdHackMethod);
+    fMappingSession->mapGxf(srcAnnotations, *mappedGxfFh, unmappedGxfFh, mappingInfoWriter);
+    delete mappedGxfFh;
+    delete unmappedGxfFh;
+    return "##mapped\n" + mappedOut.str()
+        + "##unmapped\n" + unmappedOut.str()
+        + "##map-info\n" + mappingInfoOut.str();
+}
+
+/* process one connection, errors are returned to the client */
+void MappingServer::handleConnection(int connFd) const {
+    try {
+        string response;
+        try {
+            response = mapRequest(readRequest(connFd));
+        } catch (const exception& ex) {
+            response = string("##error\t") + ex.what() + "\n";
+        }
+        writeResponse(connFd, response + "##end\n");
+    } catch (const exception& ex) {
+        cerr << "Warning: " << ex.what() << endl;
+    }
+    close(connFd);
+}
+
+/* is an accept() error specific to one connection attempt */
+bool MappingServer::isTransientAcceptError(int err) {
+    return (err == EINTR) or (err == ECONNABORTED) or (err == EPROTO);
+}
+
+/* is an accept() error due to running out of a resource, which will
+ * hopefully be released as connections finish */
+bool MappingServer::isResourceAcceptError(int err) {
+    return (err == EMFILE) or (err == ENFILE) or (err == ENOBUFS) or (err == ENOMEM);
+}
+
+/* Accept the next connection.  Transient and resource errors are reported
+ * and accept is retried, backing off after resource errors.  Other errors
+ * throw an exception. */
+int MappingServer::acceptConnection(int sockFd) const {
+    static const std::chrono::milliseconds RESOURCE_BACKOFF(100);
+    while (true) {
+        int connFd = accept(sockFd, NULL, NULL);
+        if (connFd >= 0) {
+            return connFd;
+        }
+        int err = errno;
+        if (isResourceAcceptError(err)) {
+            cerr << "Warning: accept failed, retrying: " << strerror(err) << endl;
+            std::this_thread::sleep_for(RESOURCE_BACKOFF);
+        } else if (isTransientAcceptError(err)) {
+            if (err != EINTR) {
+                cerr << "Warning: accept failed: " << strerror(err) << endl;
+            }
+        } else {
+            throw ios_base::failure(string("accept failed: ") + strerror(err));
+        }
+    }
+}
+
+/* Accept and process connections.  Accepted connections are passed to the
+ * workers through a queue with one entry per worker, so accept waits when the
+ * workers are busy, leaving connections in the listen backlog. */
+void MappingServer::serve() const {
+    int sockFd = openSocket();
+    if (gVerbose) {
+        cerr << "serving on " << fSocketPath << " with " << fNumWorkers << " workers" << endl;
+    }
+    BoundedQueue<int> connections(fNumWorkers);
+    vector<std::thread> workers;
+    for (int iWorker = 0; iWorker < fNumWorkers; iWorker++) {
+        workers.push_back(std::thread([this, &connections]() {
+            int connFd;
+            while (connections.pop(connFd)) {
+                handleConnection(connFd);
+            }
+        }));
+    }
+    try {
+        while (true) {
+            connections.push(acceptConnection(sockFd));
+        }
+    } catch (...) {
+        connections.close();
+        for (int iWorker = 0; iWorker < fNumWorkers; iWorker++) {
+            workers[iWorker].join();
+        }
+        close(sockFd);
+        throw;
+    }
+}
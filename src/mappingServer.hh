@@ -0,0 +1,64 @@
+/*
+ * Resident mapping server, accepting requests on a Unix domain socket.
+ */
+#ifndef mappingServer_hh
+#define mappingServer_hh
+#include "gxfRecord.hh"
+class MappingSession;
+
+/*
+ * Server that keeps the mapping alignments and annotation sets loaded and
+ * maps GxF gene blocks sent over a Unix domain socket.
+ *
+ * Protocol: the client connects, sends one or more complete genes in GFF3
+ * or GTF format and shuts down its side of the connection.  GFF3 is
+ * identified by a `##gff-version 3' first line, otherwise GTF is assumed.
+ * The server responds with sections, each starting with a line of:
+ *   ##mapped - mapped GxF records
+ *   ##unmapped - unmapped GxF records
+ *   ##map-info - mapping information TSV
+ *   ##error<tab>message - if the request failed
+ * followed by a ##end line.  Target genes are not copied into the results.
+ *
+ * Connections are handled by a fixed pool of worker threads, so up to the
+ * number of workers requests are mapped concurrently and further connections
+ * wait to be accepted.  The loaded data in the MappingSession is only read,
+ * and each request has its own mapping state.  Errors from accept() caused
+ * by load, such as running out of file descriptors, are reported and the
+ * server continues.
+ *
+ * An existing socket at the path, such as one left by a previous server, is
+ * replaced.  Any other type of file at the path is an error.
+ */
+class MappingServer {
+    private:
+    const string fSocketPath;
+    const MappingSession* fMappingSession;
+    ParIdHackMethod fParIdHackMethod;
+    int fNumWorkers;
+
+    void removeOldSocket() const;
+    int openSocket() const;
+    string readRequest(int connFd) const;
+    void writeResponse(int connFd,
+                       const string& response) const;
+    string mapRequest(const string& request) const;
+    void handleConnection(int connFd) const;
+    static bool isTransientAcceptError(int err);
+    static bool isResourceAcceptError(int err);
+    int acceptConnection(int sockFd) const;
+
+    public:
+    /* constructor, mappingSession holds the loaded data and is not
+     * owned.  Connections are handled by numWorkers threads. */
+    MappingServer(const string& socketPath,
+                  const MappingSession* mappingSession,
+                  ParIdHackMethod parIdHackMethod,
+                  int numWorkers);
+
+    /* Accept and process connections, only returns by throwing an exception
+     * on a non-recoverable error, after the workers have finished. */
+    void serve() const;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * In-process API for mapping annotations, for use from libgencodebackmap.
+ */
+#include "mappingSession.hh"
+#include "geneMapper.hh"
+#include "annotationSet.hh"
+#include "transMap.hh"
+#include "bedMap.hh"
+#include "resultFeaturesCache.hh"
+#include "featureTreePolish.hh"
+
+/* constructor, loads alignments and annotations */
+MappingSession::MappingSession(const string& mappingAligns,
+                               bool swapMap,
+                               const string& targetGxf,
+                               const string& targetPatchBed,
+                               const string& previousMappedGxf,
+                               const string& cacheDir,
+                               const string& substituteTargetVersion,
+                               unsigned useTargetFlags,
+                               bool onlyManualForTargetSubstituteOverlap):
+    MappingSession(TransMap::factoryFromFile(mappingAligns, swapMap), targetGxf, targetPatchBed,
+                   previousMappedGxf, cacheDir, substituteTargetVersion, useTargetFlags,
+                   onlyManualForTargetSubstituteOverlap) {
+}
+
+/* constructor with mapping alignments that have already been loaded */
+MappingSession::MappingSession(TransMap* genomeTransMap,
+                               const string& targetGxf,
+                               const string& targetPatchBed,
+                               const string& previousMappedGxf,
+                               const string& cacheDir,
+                               const string& substituteTargetVersion,
+                               unsigned useTargetFlags,
+                               bool onlyManualForTargetSubstituteOverlap):
+    fGenomeTransMap(genomeTransMap),
+    fTargetAnnotations(NULL),
+    fPreviousMappedAnnotations(NULL),
+    fTargetPatchMap(NULL),
+    fResultCache(NULL),
+    fFeatureTreePolish(NULL),
+    fSubstituteTargetVersion(substituteTargetVersion),
+    fUseTargetFlags(useTargetFlags),
+    fOnlyManualForTargetSubstituteOverlap(onlyManualForTargetSubstituteOverlap) {
+    try {
+        load(targetGxf, targetPatchBed, previousMappedGxf, cacheDir);
+    } catch (...) {
+        free();
+        throw;
+    }
+}
+
+/* load annotations and other data, the destructor isn't called if this
+ * fails, so the constructor must free anything loaded */
+void MappingSession::load(const string& targetGxf,
+                          const string& targetPatchBed,
+                          const string& previousMappedGxf,
+                          const string& cacheDir) {
+    if (targetGxf.size() > 0) {
+        fTargetAnnotations = new AnnotationSet(targetGxf);
+    }
+    if (previousMappedGxf.size() > 0) {
+        fPreviousMappedAnnotations = new AnnotationSet(previousMappedGxf);
+    }
+    if (targetPatchBed.size() > 0) {
+        fTargetPatchMap = new BedMap(targetPatchBed);
+    }
+    if (cacheDir.size() > 0) {
+        fResultCache = new ResultFeaturesCache(cacheDir);
+    }
+    fFeatureTreePolish = new FeatureTreePolish(fPreviousMappedAnnotations);
+}
+
+/* free all loaded data */
+void MappingSession::free() {
+    delete fFeatureTreePolish;
+    fFeatureTreePolish = NULL;
+    delete fResultCache;
+    fResultCache = NULL;
+    delete fTargetPatchMap;
+    fTargetPatchMap = NULL;
+    delete fPreviousMappedAnnotations;
+    fPreviousMappedAnnotations = NULL;
+    delete fTargetAnnotations;
+    fTargetAnnotations = NULL;
+    delete fGenomeTransMap;
+    fGenomeTransMap = NULL;
+}
+
+/* destructor */
+MappingSession::~MappingSession() {
+    free();
+}
+
+/* map a batch of genes from a source annotation set, adding them to
+ * results */
+void MappingSession::mapGenes(const AnnotationSet& srcAnnotations,
+                              const FeatureVector& srcGenes,
+                              MappingResults& results,
+                              ostream* transcriptPslFh) const {
+    GeneMapper geneMapper(&srcAnnotations, fGenomeTransMap, fTargetAnnotations,
+                          fPreviousMappedAnnotations, NULL, fTargetPatchMap, fResultCache,
+                          fSubstituteTargetVersion, fUseTargetFlags,
+                          fOnlyManualForTargetSubstituteOverlap);
+    MappingInfoCollector mappingInfoCollector(results.mappingInfos);
+    for (int i = 0; i < srcGenes.size(); i++) {
+        results.genes.push_back(geneMapper.mapSrcGene(srcGenes[i], *fFeatureTreePolish,
+                                                      mappingInfoCollector, transcriptPslFh));
+        // later genes in the batch may need to know this one was mapped
+        geneMapper.recordSrcGeneMapped(results.genes.back());
+    }
+}
+
+/* map a single gene from a source annotation set, adding it to results */
+void MappingSession::mapGene(const AnnotationSet& srcAnnotations,
+                             const Feature* srcGene,
+                             MappingResults& results,
+                             ostream* transcriptPslFh) const {
+    FeatureVector srcGenes;
+    srcGenes.push_back(const_cast<Feature*>(srcGene));
+    mapGenes(srcAnnotations, srcGenes, results, transcriptPslFh);
+}
+
+/* map all genes in a source annotation set, adding them to results */
+void MappingSession::mapAnnotations(const AnnotationSet& srcAnnotations,
+                                    MappingResults& results,
+                                    ostream* transcriptPslFh) const {
+    mapGenes(srcAnnotations, srcAnnotations.getGenes(), results, transcriptPslFh);
+}
+
+/* map all genes in a source annotation set, writing the results */
+void MappingSession::mapGxf(const AnnotationSet& srcAnnotations,
+                            GxfWriter& mappedGxfFh,
+                            GxfWriter* unmappedGxfFh,
+                            MappingInfoWriter& mappingInfoFh,
+                            ostream* transcriptPslFh) const {
+    GeneMapper geneMapper(&srcAnnotations, fGenomeTransMap, fTargetAnnotations,
+                          fPreviousMappedAnnotations, NULL, fTargetPatchMap, fResultCache,
+                          fSubstituteTargetVersion, fUseTargetFlags,
+                          fOnlyManualForTargetSubstituteOverlap);
+    geneMapper.mapGxf(*fFeatureTreePolish, false, mappedGxfFh, unmappedGxfFh, mappingInfoFh, transcriptPslFh);
+}
@@ -0,0 +1,147 @@
+/*
+ * In-process API for mapping annotations, for use from libgencodebackmap.
+ */
+#ifndef mappingSession_hh
+#define mappingSession_hh
+#include "resultFeatures.hh"
+#include "mappingInfo.hh"
+class TransMap;
+class AnnotationSet;
+class BedMap;
+class ResultFeaturesCache;
+class FeatureTreePolish;
+class GxfWriter;
+
+/*
+ * Results of mapping a batch of genes.  There is one ResultFeatures per
+ * source gene, with the mapped, unmapped, or substituted target trees.
+ * These trees are owned by this object.  Source genes of types that are not
+ * mapped have no trees.  The mapping info records for the batch are in
+ * mappingInfos.
+ */
+class MappingResults {
+    public:
+    ResultFeaturesVector genes;
+    MappingInfoVector mappingInfos;
+
+    /* constructor */
+    MappingResults() {
+    }
+
+    /* destructor */
+    ~MappingResults() {
+        clear();
+    }
+
+    /* free all results */
+    void clear() {
+        for (int i = 0; i < genes.size(); i++) {
+            genes[i].free();
+        }
+        genes.clear();
+        mappingInfos.clear();
+    }
+
+    private:
+    // owns the features, so no copying
+    MappingResults(const MappingResults&) = delete;
+    MappingResults& operator=(const MappingResults&) = delete;
+};
+
+/*
+ * Holds the mapping alignments and the target and previous mapping
+ * annotation sets, which are loaded once, so that any number of source
+ * annotation sets or genes can be mapped in-process.  The arguments
+ * correspond to the gencode-backmap command line options, with empty strings
+ * for files not used.  Target genes are not copied into the results.
+ * Gene numbers in mapping info records are relative to each batch.
+ *
+ * Within a batch, genes are recorded as mapped as they are finished, so
+ * target substitution decisions are the same as the command line makes for
+ * the same source genes.  Batches are independent of each other.
+ *
+ * The loaded data is not modified by mapping and each call has its own
+ * mapping state, so the mapping functions may be called from multiple
+ * threads.
+ */
+class MappingSession {
+    private:
+    TransMap* fGenomeTransMap;
+    AnnotationSet* fTargetAnnotations;
+    AnnotationSet* fPreviousMappedAnnotations;
+    BedMap* fTargetPatchMap;
+    ResultFeaturesCache* fResultCache;
+    FeatureTreePolish* fFeatureTreePolish;
+    const string fSubstituteTargetVersion;
+    unsigned fUseTargetFlags;
+    bool fOnlyManualForTargetSubstituteOverlap;
+
+    void load(const string& targetGxf,
+              const string& targetPatchBed,
+              const string& previousMappedGxf,
+              const string& cacheDir);
+    void free();
+    MappingSession(const MappingSession&) = delete;
+    MappingSession& operator=(const MappingSession&) = delete;
+
+    public:
+    /* constructor, loads alignments and annotations */
+    MappingSession(const string& mappingAligns,
+                   bool swapMap,
+                   const string& targetGxf = "",
+                   const string& targetPatchBed = "",
+                   const string& previousMappedGxf = "",
+                   const string& cacheDir = "",
+                   const string& substituteTargetVersion = "",
+                   unsigned useTargetFlags = 0,
+                   bool onlyManualForTargetSubstituteOverlap = false);
+
+    /* constructor with mapping alignments that have already been loaded,
+     * such as composed alignments.  Takes ownership of genomeTransMap, it
+     * is freed even if loading the annotations fails. */
+    MappingSession(TransMap* genomeTransMap,
+                   const string& targetGxf = "",
+                   const string& targetPatchBed = "",
+                   const string& previousMappedGxf = "",
+                   const string& cacheDir = "",
+                   const string& substituteTargetVersion = "",
+                   unsigned useTargetFlags = 0,
+                   bool onlyManualForTargetSubstituteOverlap = false);
+
+    /* destructor */
+    ~MappingSession();
+
+    /* get the mapping alignments */
+    const TransMap* getGenomeTransMap() const {
+        return fGenomeTransMap;
+    }
+
+    /* map a batch of genes from a source annotation set, adding them to
+     * results */
+    void mapGenes(const AnnotationSet& srcAnnotations,
+                  const FeatureVector& srcGenes,
+                  MappingResults& results,
+                  ostream* transcriptPslFh = NULL) const;
+
+    /* map a single gene from a source annotation set, adding it to
+     * results */
+    void mapGene(const AnnotationSet& srcAnnotations,
+                 const Feature* srcGene,
+                 MappingResults& results,
+                 ostream* transcriptPslFh = NULL) const;
+
+    /* map all genes in a source annotation set, adding them to results */
+    void mapAnnotations(const AnnotationSet& srcAnnotations,
+                        MappingResults& results,
+                        ostream* transcriptPslFh = NULL) const;
+
+    /* map all genes in a source annotation set, writing the sorted mapped
+     * and unmapped genes and the mapping info as the command line does */
+    void mapGxf(const AnnotationSet& srcAnnotations,
+                GxfWriter& mappedGxfFh,
+                GxfWriter* unmappedGxfFh,
+                MappingInfoWriter& mappingInfoFh,
+                ostream* transcriptPslFh = NULL) const;
+};
+
+#endif
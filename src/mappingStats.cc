@@ -0,0 +1,361 @@
+/*
+ * Summary statistics of mapping info and lifted attrs files.
+ */
+#include "mappingStats.hh"
+#include "mappingInfoBin.hh"
+#include "FIOStream.hh"
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <unordered_set>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* Biotypes in each category, terminated by NULL.  These are the sets in
+ * lib/gencode/gencodeGenes.py used by gencodeAttrsStats, with the names used
+ * by later releases added at the end of a list.  As in gencodeGenes.py, some
+ * non-coding biotypes are also small non-coding, which is checked first.
+ * Pseudogenes from later releases are also identified by name. */
+static const char* codingBiotypes[] = {
+    "IG_C_gene", "IG_D_gene", "IG_J_gene", "IG_V_gene", "IG_LV_gene",
+    "polymorphic_pseudogene", "protein_coding", "nonsense_mediated_decay",
+    "TR_gene", "TR_C_gene", "TR_D_gene", "TR_J_gene", "TR_V_gene", "non_stop_decay",
+    "protein_coding_LoF", NULL
+};
+static const char* problemBiotypes[] = {
+    "retained_intron", "TEC", "disrupted_domain", "ambiguous_orf",
+    "artifact", NULL
+};
+static const char* smallNonCodingBiotypes[] = {
+    "miRNA", "misc_RNA", "Mt_rRNA", "Mt_tRNA", "ribozyme", "rRNA", "snoRNA",
+    "scRNA", "snRNA", "sRNA", NULL
+};
+static const char* nonCodingBiotypes[] = {
+    "antisense", "lincRNA", "miRNA", "misc_RNA", "ncrna_host", "Mt_rRNA", "Mt_tRNA",
+    "non_coding", "processed_transcript", "rRNA", "snoRNA", "scRNA", "snRNA",
+    "3prime_overlapping_ncrna", "3prime_overlapping_ncRNA", "sense_intronic",
+    "sense_overlapping", "known_ncrna", "macro_lncRNA", "ribozyme", "scaRNA", "sRNA",
+    "vaultRNA", "bidirectional_promoter_lncrna", "bidirectional_promoter_lncRNA",
+    "antisense_RNA", "lncRNA", "vault_RNA", NULL
+};
+static const char* pseudoBiotypes[] = {
+    "IG_J_pseudogene", "IG_pseudogene", "IG_V_pseudogene", "miRNA_pseudogene",
+    "misc_RNA_pseudogene", "Mt_tRNA_pseudogene", "processed_pseudogene", "pseudogene",
+    "rRNA_pseudogene", "scRNA_pseudogene", "snoRNA_pseudogene", "snRNA_pseudogene",
+    "transcribed_processed_pseudogene", "transcribed_unprocessed_pseudogene",
+    "tRNA_pseudogene", "TR_pseudogene", "unitary_pseudogene",
+    "transcribed_unitary_pseudogene", "unprocessed_pseudogene", "IG_C_pseudogene",
+    "IG_D_pseudogene", "TR_J_pseudogene", "TR_V_pseudogene", "retrotransposed",
+    "translated_processed_pseudogene", "translated_unprocessed_pseudogene", NULL
+};
+
+/* category names, in enum order */
+static const string biotypeCategoryStrs[] = {
+    "coding", "nonCoding", "smallNonCode", "pseudo", "problem"
+};
+
+/* row and column name for totals */
+static const string TOTAL_STR = "total";
+
+/* mapping type names, in enum order */
+static const string mappingTypeStrs[] = {
+    "mapped", "target"
+};
+
+/* is a biotype in a NULL terminated list */
+static bool inBiotypes(const char** biotypes,
+                       const string& biotype) {
+    for (int i = 0; biotypes[i] != NULL; i++) {
+        if (biotype == biotypes[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* get the category for a biotype, throwing an exception if unknown.  Small
+ * non-coding must be check before non-coding. */
+BiotypeCategory biotypeToCategory(const string& biotype) {
+    if (inBiotypes(codingBiotypes, biotype)) {
+        return BIOTYPE_CATEGORY_CODING;
+    } else if (inBiotypes(problemBiotypes, biotype)) {
+        return BIOTYPE_CATEGORY_PROBLEM;
+    } else if (inBiotypes(smallNonCodingBiotypes, biotype)) {
+        return BIOTYPE_CATEGORY_SMALL_NON_CODING;
+    } else if (inBiotypes(nonCodingBiotypes, biotype)) {
+        return BIOTYPE_CATEGORY_NON_CODING;
+    } else if (inBiotypes(pseudoBiotypes, biotype) or (biotype.find("pseudogene") != biotype.npos)) {
+        return BIOTYPE_CATEGORY_PSEUDO;
+    } else {
+        throw invalid_argument("unknown biotype: \"" + biotype + "\"");
+    }
+}
+
+/* convert a biotype category to a string */
+const string& biotypeCategoryToStr(BiotypeCategory category) {
+    return biotypeCategoryStrs[category];
+}
+
+/* format a fraction */
+static string formatFreq(long count,
+                         long total) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%0.2f", (total > 0) ? double(count) / double(total) : 0.0);
+    return buf;
+}
+
+/* write with the fraction of each biotype with a status */
+void BiotypeStatusMatrix::write(ostream& out) const {
+    out << "biotype";
+    for (set<string>::const_iterator it = fStatuses.begin(); it != fStatuses.end(); it++) {
+        out << "\t" << *it;
+    }
+    out << "\t" << TOTAL_STR << endl;
+    for (map<string, map<string, long> >::const_iterator rowIt = fCounts.begin(); rowIt != fCounts.end(); rowIt++) {
+        const map<string, long>& row = rowIt->second;
+        long total = 0;
+        for (map<string, long>::const_iterator it = row.begin(); it != row.end(); it++) {
+            total += it->second;
+        }
+        out << rowIt->first;
+        for (set<string>::const_iterator it = fStatuses.begin(); it != fStatuses.end(); it++) {
+            map<string, long>::const_iterator cnt = row.find(*it);
+            out << "\t" << formatFreq((cnt == row.end()) ? 0 : cnt->second, total);
+        }
+        out << "\t" << formatFreq(total, total) << endl;
+    }
+}
+
+/* constructor */
+MappingStats::MappingStats():
+    fHaveMappingInfo(false) {
+    for (int featType = 0; featType < NUM_FEAT_TYPES; featType++) {
+        for (int category = 0; category < BIOTYPE_CATEGORY_NUM; category++) {
+            for (int mappingType = 0; mappingType < NUM_MAPPING_TYPES; mappingType++) {
+                fCounts[featType][category][mappingType] = 0;
+            }
+        }
+    }
+}
+
+/* get a count, where category or mapping type of -1 is the total */
+long MappingStats::getCount(FeatType featType,
+                            int category,
+                            int mappingType) const {
+    long count = 0;
+    for (int iCat = 0; iCat < BIOTYPE_CATEGORY_NUM; iCat++) {
+        for (int iMap = 0; iMap < NUM_MAPPING_TYPES; iMap++) {
+            if (((category < 0) or (category == iCat)) and ((mappingType < 0) or (mappingType == iMap))) {
+                count += fCounts[featType][iCat][iMap];
+            }
+        }
+    }
+    return count;
+}
+
+/* Count a lift attrs TSV, with the header already read.  Each row is a
+ * transcript, genes are counted once.  Ids of mapped features have a mapping
+ * version suffix. */
+void MappingStats::countAttrs(istream& in,
+                              const string& headerLine) {
+    StringVector header = stringSplit(headerLine, '\t');
+    int geneIdCol = -1, geneTypeCol = -1, transIdCol = -1, transTypeCol = -1;
+    for (int i = 0; i < header.size(); i++) {
+        if (header[i] == "geneId") {
+            geneIdCol = i;
+        } else if (header[i] == "geneType") {
+            geneTypeCol = i;
+        } else if (header[i] == "transcriptId") {
+            transIdCol = i;
+        } else if (header[i] == "transcriptType") {
+            transTypeCol = i;
+        }
+    }
+    if ((geneIdCol < 0) or (geneTypeCol < 0) or (transIdCol < 0) or (transTypeCol < 0)) {
+        throw invalid_argument("attrs TSV must have geneId, geneType, transcriptId, and transcriptType columns");
+    }
+    unordered_set<string> geneIds;
+    long lineNum = 1;
+    string line;
+    while (getline(in, line)) {
+        lineNum++;
+        StringVector cols = stringSplit(line, '\t');
+        if (cols.size() != header.size()) {
+            throw invalid_argument("expected " + toString(int(header.size())) + " columns in attrs TSV line "
+                                   + toString(lineNum) + ", got " + toString(int(cols.size())));
+        }
+        const string& geneId = cols[geneIdCol];
+        if (geneIds.insert(geneId).second) {
+            count(GENE_FEAT, cols[geneTypeCol], (geneId.find('_') != geneId.npos) ? MAPPED_TYPE : TARGET_TYPE);
+        }
+        const string& transId = cols[transIdCol];
+        count(TRANS_FEAT, cols[transTypeCol], (transId.find('_') != transId.npos) ? MAPPED_TYPE : TARGET_TYPE);
+    }
+}
+
+/* Count a mapping info record.  Features in the output are mapped or
+ * copied or substituted from the target.  The status matrices are built
+ * from the mapped and unmapped records. */
+void MappingStats::countMappingInfo(const MappingInfo& mappingInfo) {
+    FeatType featType = (mappingInfo.featType == "gene") ? GENE_FEAT : TRANS_FEAT;
+    if (mappingInfo.recType == "map") {
+        count(featType, mappingInfo.featBiotype, MAPPED_TYPE);
+    } else if (stringStartsWith(mappingInfo.recType, "target")) {
+        count(featType, mappingInfo.featBiotype, TARGET_TYPE);
+    }
+    if ((mappingInfo.recType == "map") or (mappingInfo.recType == "unmap")) {
+        fMappingStatusMatrices[featType].add(mappingInfo.featBiotype, remapStatusToStr(mappingInfo.mappingStatus));
+        fTargetStatusMatrices[featType].add(mappingInfo.featBiotype, targetStatusToStr(mappingInfo.targetStatus));
+    }
+}
+
+/* count a mapping info TSV, with the header already read */
+void MappingStats::countMappingInfoTsv(istream& in,
+                                       const string& headerLine) {
+    MappingInfoTsvReader reader(in, headerLine);
+    MappingInfo mappingInfo;
+    while (reader.read(mappingInfo)) {
+        countMappingInfo(mappingInfo);
+    }
+    fHaveMappingInfo = true;
+}
+
+/* count a binary mapping info file */
+void MappingStats::countMappingInfoBin(istream& in) {
+    MappingInfoBinReader reader(in);
+    MappingInfo mappingInfo;
+    while (reader.read(mappingInfo)) {
+        countMappingInfo(mappingInfo);
+    }
+    fHaveMappingInfo = true;
+}
+
+/* Count a file, determining the type from the contents.  The TSV headers
+ * start with a lower-case column name, so the first character identifies the
+ * binary mapping info magic number without consuming it; the binary reader
+ * validates the rest of the magic.  The first line of a TSV is read once and
+ * passed to the parser. */
+void MappingStats::countFile(const string& inFile) {
+    FIOStream in(inFile);
+    if (in.peek() == MappingInfoBin::MAGIC[0]) {
+        countMappingInfoBin(in);
+        return;
+    }
+    string headerLine;
+    getline(in, headerLine);
+    string firstCol = headerLine.substr(0, headerLine.find('\t'));
+    if (firstCol == "geneNum") {
+        countMappingInfoTsv(in, headerLine);
+    } else if (firstCol == "geneId") {
+        countAttrs(in, headerLine);
+    } else {
+        throw invalid_argument("can't determine type of \"" + inFile + "\", expected mapping info or lift attrs file");
+    }
+}
+
+/* write rows for a feature type */
+void MappingStats::writeCounts(const string& desc,
+                               FeatType featType,
+                               ostream& out) const {
+    for (int mappingType = -1; mappingType < NUM_MAPPING_TYPES; mappingType++) {
+        out << desc << "\t" << ((mappingType < 0) ? TOTAL_STR : mappingTypeStrs[mappingType]);
+        for (int category = -1; category < BIOTYPE_CATEGORY_NUM; category++) {
+            out << "\t" << getCount(featType, category, mappingType);
+        }
+        out << endl;
+    }
+}
+
+/* write the category by mapping type counts */
+void MappingStats::writeCategoryCounts(ostream& out) const {
+    out << "\t\t" << TOTAL_STR;
+    for (int category = 0; category < BIOTYPE_CATEGORY_NUM; category++) {
+        out << "\t" << biotypeCategoryStrs[category];
+    }
+    out << endl;
+    writeCounts("gene", GENE_FEAT, out);
+    writeCounts("trans", TRANS_FEAT, out);
+}
+
+/* get the base name of an input file for naming output */
+static string getStatsBaseName(const string& inFile) {
+    string base = inFile.substr(inFile.rfind('/') + 1);
+    if (stringEndsWith(base, ".gz")) {
+        base = base.substr(0, base.size() - 3);
+    }
+    if (stringEndsWith(base, ".bin")) {
+        base = base.substr(0, base.size() - 4);
+    }
+    size_t dot = base.rfind('.');
+    if ((dot != string::npos) and (dot > 0)) {
+        base = base.substr(0, dot);
+    }
+    return base;
+}
+
+/* compute and write statistics for one file */
+static void mappingStatsFile(const string& inFile,
+                             const string& outBase) {
+    MappingStats stats;
+    stats.countFile(inFile);
+    {
+        FIOStream out(outBase + ".stats", ios::out);
+        stats.writeCategoryCounts(out);
+    }
+    if (stats.haveMappingInfo()) {
+        static const string featDescs[] = {"gene", "trans"};
+        for (int featType = 0; featType < MappingStats::NUM_FEAT_TYPES; featType++) {
+            FIOStream mapOut(outBase + "." + featDescs[featType] + ".biotype-mapstatus.matrix", ios::out);
+            stats.writeMappingStatusMatrix(MappingStats::FeatType(featType), mapOut);
+            FIOStream targetOut(outBase + "." + featDescs[featType] + ".biotype-targetstatus.matrix", ios::out);
+            stats.writeTargetStatusMatrix(MappingStats::FeatType(featType), targetOut);
+        }
+    }
+}
+
+/* Compute statistics on a set of files in parallel.  Each thread takes the
+ * next unprocessed file. */
+void mappingStatsFiles(const StringVector& inFiles,
+                       const string& outDir,
+                       int numThreads) {
+    StringVector outBases;
+    set<string> seenBases;
+    for (size_t i = 0; i < inFiles.size(); i++) {
+        string base = getStatsBaseName(inFiles[i]);
+        if (not seenBases.insert(base).second) {
+            throw invalid_argument("input files must have unique base names, duplicate: \"" + base + "\"");
+        }
+        outBases.push_back(outDir + "/" + base);
+    }
+    if ((mkdir(outDir.c_str(), 0777) < 0) and (errno != EEXIST)) {
+        throw ios_base::failure("can't create output directory \"" + outDir + "\": " + strerror(errno));
+    }
+
+    size_t numWorkers = min(size_t((numThreads < 1) ? 1 : numThreads), inFiles.size());
+    atomic<size_t> nextFile(0);
+    vector<exception_ptr> errors(inFiles.size());
+    vector<std::thread> threads;
+    for (size_t iWorker = 0; iWorker < numWorkers; iWorker++) {
+        threads.push_back(std::thread([&]() {
+            size_t iFile;
+            while ((iFile = nextFile++) < inFiles.size()) {
+                try {
+                    mappingStatsFile(inFiles[iFile], outBases[iFile]);
+                } catch (...) {
+                    errors[iFile] = current_exception();
+                }
+            }
+        }));
+    }
+    for (size_t iWorker = 0; iWorker < numWorkers; iWorker++) {
+        threads[iWorker].join();
+    }
+    for (size_t iFile = 0; iFile < inFiles.size(); iFile++) {
+        if (errors[iFile] != NULL) {
+            rethrow_exception(errors[iFile]);
+        }
+    }
+}
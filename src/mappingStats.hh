@@ -0,0 +1,134 @@
+/*
+ * Summary statistics of mapping info and lifted attrs files.
+ */
+#ifndef mappingStats_hh
+#define mappingStats_hh
+#include "mappingInfo.hh"
+#include "typeOps.hh"
+#include <map>
+#include <set>
+
+/* biotype categories used in reports */
+typedef enum {
+    BIOTYPE_CATEGORY_CODING,
+    BIOTYPE_CATEGORY_NON_CODING,
+    BIOTYPE_CATEGORY_SMALL_NON_CODING,
+    BIOTYPE_CATEGORY_PSEUDO,
+    BIOTYPE_CATEGORY_PROBLEM,
+    BIOTYPE_CATEGORY_NUM
+} BiotypeCategory;
+
+/* get the category for a biotype, throwing an exception if unknown */
+BiotypeCategory biotypeToCategory(const string& biotype);
+
+/* convert a biotype category to a string */
+const string& biotypeCategoryToStr(BiotypeCategory category);
+
+/*
+ * Matrix of counts of biotype by a status.
+ */
+class BiotypeStatusMatrix {
+    private:
+    map<string, map<string, long> > fCounts;  // biotype, status
+    set<string> fStatuses;
+
+    public:
+    /* count a record */
+    void add(const string& biotype,
+             const string& status) {
+        fCounts[biotype][status]++;
+        fStatuses.insert(status);
+    }
+
+    /* write with the fraction of each biotype with a status */
+    void write(ostream& out) const;
+};
+
+/*
+ * Counts of genes and transcripts by biotype category and mapping type,
+ * along with biotype by status matrices.  These are collected from either
+ * a mapping info file (TSV or binary) or a lift attrs TSV.
+ */
+class MappingStats {
+    public:
+    /* mapping types */
+    typedef enum {
+        MAPPED_TYPE,   // mapped from source
+        TARGET_TYPE,   // from target annotations
+        NUM_MAPPING_TYPES
+    } MappingType;
+
+    /* feature types */
+    typedef enum {
+        GENE_FEAT,
+        TRANS_FEAT,
+        NUM_FEAT_TYPES
+    } FeatType;
+
+    private:
+    bool fHaveMappingInfo;
+    long fCounts[NUM_FEAT_TYPES][BIOTYPE_CATEGORY_NUM][NUM_MAPPING_TYPES];
+    BiotypeStatusMatrix fMappingStatusMatrices[NUM_FEAT_TYPES];
+    BiotypeStatusMatrix fTargetStatusMatrices[NUM_FEAT_TYPES];
+
+    void count(FeatType featType,
+               const string& biotype,
+               MappingType mappingType) {
+        fCounts[featType][biotypeToCategory(biotype)][mappingType]++;
+    }
+    long getCount(FeatType featType,
+                  int category,
+                  int mappingType) const;
+    void countAttrs(istream& in,
+                    const string& headerLine);
+    void countMappingInfoTsv(istream& in,
+                             const string& headerLine);
+    void countMappingInfoBin(istream& in);
+    void writeCounts(const string& desc,
+                     FeatType featType,
+                     ostream& out) const;
+
+    public:
+    /* constructor */
+    MappingStats();
+
+    /* count a mapping info record */
+    void countMappingInfo(const MappingInfo& mappingInfo);
+
+    /* Count a file, determining the type from the contents.  The file is
+     * only read once, so it maybe a pipe. */
+    void countFile(const string& inFile);
+
+    /* have the mapping info matrices been collected */
+    bool haveMappingInfo() const {
+        return fHaveMappingInfo;
+    }
+
+    /* write the category by mapping type counts */
+    void writeCategoryCounts(ostream& out) const;
+
+    /* write biotype by mapping status matrix for a feature type */
+    void writeMappingStatusMatrix(FeatType featType,
+                                  ostream& out) const {
+        fMappingStatusMatrices[featType].write(out);
+    }
+
+    /* write biotype by target status matrix for a feature type */
+    void writeTargetStatusMatrix(FeatType featType,
+                                 ostream& out) const {
+        fTargetStatusMatrices[featType].write(out);
+    }
+};
+
+/*
+ * Compute statistics on a set of files in parallel, writing results to
+ * outDir.  For each input, outDir/base.stats is created, where base is the
+ * file name without directory and extensions.  For mapping info input, the
+ * biotype by status matrices are written to
+ * outDir/base.{gene,trans}.biotype-{mapstatus,targetstatus}.matrix.
+ */
+void mappingStatsFiles(const StringVector& inFiles,
+                       const string& outDir,
+                       int numThreads);
+
+#endif
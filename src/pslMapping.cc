@@ -7,8 +7,7 @@
 #include <iostream>
 
 // FIXME: passing down features to this level in simple container is annoying.
-// It would be better to have a sort function passed it, but we had all the
-// core dump issues with sort, put algorithm here for now.
+// It would be better to have a sort function passed it, put algorithm here for now.
 
 /* constructor, sort mapped PSLs */
 PslMapping::PslMapping(struct psl* srcPsl,
@@ -65,45 +64,6 @@ void PslMapping::dump(ostream& fh,
     }
 }
 
-/* comparison functor based on lowest store. */
-class ScoreCmp {
-    public:
-    struct psl* fSrcPsl;
-    
-    ScoreCmp(struct psl* srcPsl):
-        fSrcPsl(srcPsl) {
-    }
-
-    int operator()(struct psl* mappedPsl1,
-                   struct psl* mappedPsl2) const {
-        return -(PslMapping::calcPslMappingScore(fSrcPsl, mappedPsl1)
-                 - PslMapping::calcPslMappingScore(fSrcPsl, mappedPsl2));
-    }
-};
-
-
-#if 0
-// FIXME: with this seemingly correct sort, the C++ library goes of the end of the vector and SEGVs
-// this happens on g++ 4.8.2 on Linux and 4.9 on OS/X (Mac ports).  It doesn't happen with
-// clang on OS/X.
-/* sort with best (lowest score) first */
-void PslMapping::sortMappedPsls() {
-    //sort(fMappedPsls.begin(), fMappedPsls.end(), ScoreCmp(fSrcPsl));
-    std::sort(fMappedPsls.begin(), fMappedPsls.end(),
-              [this](const struct psl* a, const struct psl* b) -> bool {
-                  return (PslMapping::calcPslMappingScore(this->fSrcPsl, a)
-                          - PslMapping::calcPslMappingScore(this->fSrcPsl, b));
-              });
-    if (fMappedPsls.size() > 0) {
-        fMappedPsl = fMappedPsls[0];
-    }
-}
-#else
-/* globals for use in comparison because qsort doesn't have a client data */
-static struct psl* gSrcPsl = NULL;
-static const GxfFeature* gPrimaryTarget = NULL;
-static const GxfFeature* gSecondaryTarget = NULL;
-
 /* compute fraction of overlap similarity for a psl and a target feature. */
 static float targetSimilarity(const struct psl *mappedPsl,
                               const GxfFeature* targetFeature) {
@@ -136,9 +96,10 @@ static int targetSimilarityCmp(const struct psl *mappedPsl1,
 }
 
 /* compare by span similarity */
-static int spanSimilarityCmp(const struct psl *mappedPsl1,
+static int spanSimilarityCmp(const struct psl *srcPsl,
+                             const struct psl *mappedPsl1,
                              const struct psl *mappedPsl2) {
-    int srcSpan = (gSrcPsl->tEnd - gSrcPsl->tStart);
+    int srcSpan = (srcPsl->tEnd - srcPsl->tStart);
     int span1Diff = abs(srcSpan - (mappedPsl1->tEnd - mappedPsl1->tStart));
     int span2Diff = abs(srcSpan - (mappedPsl2->tEnd - mappedPsl2->tStart));
     // rank smallest span change best (reverse sort)
@@ -151,45 +112,64 @@ static int spanSimilarityCmp(const struct psl *mappedPsl1,
     }
 }
 
-/* compare two psl to see which is better mapped. */
-static int mapScoreCmp(const void *va, const void *vb) {
-    const struct psl *mappedPsl1 = *static_cast<const struct psl *const*>(va);
-    const struct psl *mappedPsl2 = *static_cast<const struct psl *const*>(vb);
-    if (gPrimaryTarget != NULL) {
-        int diff = targetSimilarityCmp(mappedPsl1, mappedPsl2, gPrimaryTarget);
-        if (diff != 0) {
-            return -diff; // inverse sort
-        }
+/* Comparison functor to order mapped psls with the best mapped first.  This
+ * holds the source psl and targets rather than using globals, so sorts can
+ * happen in multiple threads. */
+class MapScoreCmp {
+    private:
+    const struct psl* fSrcPsl;
+    const GxfFeature* fPrimaryTarget;
+    const GxfFeature* fSecondaryTarget;
+
+    public:
+    MapScoreCmp(const struct psl* srcPsl,
+                const GxfFeature* primaryTarget,
+                const GxfFeature* secondaryTarget):
+        fSrcPsl(srcPsl),
+        fPrimaryTarget(primaryTarget),
+        fSecondaryTarget(secondaryTarget) {
     }
-    if (gSecondaryTarget != NULL) {
-        int diff = targetSimilarityCmp(mappedPsl1, mappedPsl2, gSecondaryTarget);
+
+    /* compare two psl to see which is better mapped. */
+    int compare(const struct psl *mappedPsl1,
+                const struct psl *mappedPsl2) const {
+        if (fPrimaryTarget != NULL) {
+            int diff = targetSimilarityCmp(mappedPsl1, mappedPsl2, fPrimaryTarget);
+            if (diff != 0) {
+                return -diff; // inverse sort
+            }
+        }
+        if (fSecondaryTarget != NULL) {
+            int diff = targetSimilarityCmp(mappedPsl1, mappedPsl2, fSecondaryTarget);
+            if (diff != 0) {
+                return -diff; // inverse sort
+            }
+        }
+        int diff = spanSimilarityCmp(fSrcPsl, mappedPsl1, mappedPsl2);
         if (diff != 0) {
-            return -diff; // inverse sort
+            return diff;
         }
+        // FIXME: this maybe silly
+        return (PslMapping::calcPslMappingScore(fSrcPsl, mappedPsl1)
+                - PslMapping::calcPslMappingScore(fSrcPsl, mappedPsl2));
     }
-    int diff = spanSimilarityCmp(mappedPsl1, mappedPsl2);
-    if (diff != 0) {
-        return diff;
+
+    /* less-than for use with sort.  N.B. the original attempt to use
+     * std::sort SEGVed because the comparison returned the int difference
+     * rather than less-than, which is not a strict weak ordering */
+    bool operator()(const struct psl *mappedPsl1,
+                    const struct psl *mappedPsl2) const {
+        return compare(mappedPsl1, mappedPsl2) < 0;
     }
-    // FIXME: this maybe silly
-    return (PslMapping::calcPslMappingScore(gSrcPsl, mappedPsl1)
-            - PslMapping::calcPslMappingScore(gSrcPsl, mappedPsl2));
-}
+};
 
-/* sort with best (lowest score) first */
+/* sort with best (lowest score) first.  A stable sort keeps ties in
+ * the order returned by the mapping. */
 void PslMapping::sortMappedPsls(const GxfFeature* primaryTarget,
                                 const GxfFeature* secondaryTarget) {
-    gSrcPsl = fSrcPsl;
-    gPrimaryTarget = primaryTarget;
-    gSecondaryTarget = secondaryTarget;
-    qsort(static_cast<struct psl**>(&(fMappedPsls[0])), fMappedPsls.size(), sizeof(struct psl*), mapScoreCmp);
-    gSrcPsl = NULL;
-    gPrimaryTarget = gSecondaryTarget = NULL;
+    std::stable_sort(fMappedPsls.begin(), fMappedPsls.end(),
+                     MapScoreCmp(fSrcPsl, primaryTarget, secondaryTarget));
     if (fMappedPsls.size() > 0) {
         fMappedPsl = fMappedPsls[0];
     }
 }
-#endif
-
-
-
@@ -6,6 +6,7 @@
 #include "jkinclude.hh"
 #include "typeOps.hh"
 #include <vector>
+#include <algorithm>
 
 /*
  * Vector of psls; doesn't own PSLs.
@@ -95,6 +96,34 @@ static inline bool pslQueryFullyMapped(struct psl* psl) {
     return true;
 }
 
+/* Find the block containing a range of the query, in query strand
+ * coordinates, with a binary search.  Returns -1 if the range is not
+ * contained in a single block. */
+static inline int pslFindQBlock(const struct psl* psl, int qStart, int qEnd) {
+    if (qStart < 0) {
+        return -1;
+    }
+    int iBlk = (upper_bound(psl->qStarts, psl->qStarts + psl->blockCount, unsigned(qStart)) - psl->qStarts) - 1;
+    if ((iBlk < 0) or (qEnd > psl->qStarts[iBlk] + psl->blockSizes[iBlk])) {
+        return -1;
+    }
+    return iBlk;
+}
+
+/* Find the block containing a range of the target, in target strand
+ * coordinates, with a binary search.  Returns -1 if the range is not
+ * contained in a single block. */
+static inline int pslFindTBlock(const struct psl* psl, int tStart, int tEnd) {
+    if (tStart < 0) {
+        return -1;
+    }
+    int iBlk = (upper_bound(psl->tStarts, psl->tStarts + psl->blockCount, unsigned(tStart)) - psl->tStarts) - 1;
+    if ((iBlk < 0) or (tEnd > psl->tStarts[iBlk] + psl->blockSizes[iBlk])) {
+        return -1;
+    }
+    return iBlk;
+}
+
 /* add a psl block to a psl being constructed, updating counts */
 static inline void pslAddBlock(struct psl* psl, unsigned qStart, unsigned tStart, int blockSize) {
     int iBlk = psl->blockCount;
@@ -0,0 +1,215 @@
+/*
+ * Projection of alignments through mapping alignments.
+ */
+#include "pslProjector.hh"
+#include "pslOps.hh"
+#include "exonProjectionCache.hh"
+#include <algorithm>
+
+/* Find the first mapping block at or after iStart that ends after pos.  The
+ * search gallops forward from iStart, then does a binary search, as input
+ * blocks are usually close to the previous one.  Returns blockCount if there
+ * is no such block. */
+unsigned PslProjector::findMapBlock(const struct psl* mapPsl,
+                                    unsigned iStart,
+                                    unsigned pos) {
+    unsigned blockCount = mapPsl->blockCount;
+    if ((iStart >= blockCount) or (mapQEnd(mapPsl, iStart) > pos)) {
+        return iStart;
+    }
+    // find a range (lo, hi] containing the block, where lo ends at or before pos
+    unsigned lo = iStart;
+    unsigned step = 1;
+    unsigned hi = lo + step;
+    while ((hi < blockCount) and (mapQEnd(mapPsl, hi) <= pos)) {
+        lo = hi;
+        step *= 2;
+        hi = lo + step;
+    }
+    hi = min(hi, blockCount);
+    while ((hi - lo) > 1) {
+        unsigned mid = lo + ((hi - lo) / 2);
+        if (mapQEnd(mapPsl, mid) > pos) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+    return hi;
+}
+
+/* Project one input block, with the target in the orientation of the
+ * mapping query.  The parts of the block in gaps in the mapping alignment
+ * are dropped.  Returns the mapping block index to start the next search
+ * from. */
+unsigned PslProjector::projectBlock(const struct psl* mapPsl,
+                                    unsigned iMapBlk,
+                                    unsigned qStart,
+                                    unsigned tStart,
+                                    unsigned size,
+                                    BlockVector& blocks) {
+    unsigned tEnd = tStart + size;
+    while (tStart < tEnd) {
+        iMapBlk = findMapBlock(mapPsl, iMapBlk, tStart);
+        if (iMapBlk >= mapPsl->blockCount) {
+            break;  // past the end of the mapping alignment
+        }
+        unsigned mqStart = mapPsl->qStarts[iMapBlk];
+        unsigned partSize;
+        if (tStart < mqStart) {
+            // gap before the mapping block
+            partSize = min(tEnd, mqStart) - tStart;
+        } else {
+            partSize = min(tEnd, mapQEnd(mapPsl, iMapBlk)) - tStart;
+            blocks.push_back(Block(qStart, mapPsl->tStarts[iMapBlk] + (tStart - mqStart), partSize));
+        }
+        qStart += partSize;
+        tStart += partSize;
+    }
+    return iMapBlk;
+}
+
+/* Project the blocks of an input alignment.  If rcInPsl is set, the input is
+ * traversed as if reverse-complemented, so that its target is in the same
+ * orientation as the mapping query. */
+void PslProjector::projectBlocks(const struct psl* inPsl,
+                                 bool rcInPsl,
+                                 const struct psl* mapPsl,
+                                 BlockVector& blocks) {
+    unsigned iMapBlk = 0;
+    for (unsigned i = 0; (i < inPsl->blockCount) and (iMapBlk < mapPsl->blockCount); i++) {
+        unsigned iBlk = rcInPsl ? (inPsl->blockCount - 1) - i : i;
+        unsigned size = inPsl->blockSizes[iBlk];
+        unsigned qStart = inPsl->qStarts[iBlk];
+        unsigned tStart = inPsl->tStarts[iBlk];
+        if (rcInPsl) {
+            qStart = inPsl->qSize - (qStart + size);
+            tStart = inPsl->tSize - (tStart + size);
+        }
+        iMapBlk = projectBlock(mapPsl, iMapBlk, qStart, tStart, size, blocks);
+    }
+}
+
+/* reverse-complement projected blocks */
+void PslProjector::reverseBlocks(unsigned qSize,
+                                 unsigned tSize,
+                                 BlockVector& blocks) {
+    reverse(blocks.begin(), blocks.end());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].qStart = qSize - (blocks[i].qStart + blocks[i].size);
+        blocks[i].tStart = tSize - (blocks[i].tStart + blocks[i].size);
+    }
+}
+
+/* create the mapped psl from the projected blocks, which are in the
+ * orientation of the input query */
+struct psl* PslProjector::makeMappedPsl(const struct psl* inPsl,
+                                        bool rcInPsl,
+                                        const struct psl* mapPsl,
+                                        const BlockVector& blocks) {
+    char mapTStrand = normStrand(mapPsl->strand[1]);
+    char strand[3] = {inPsl->strand[0],
+                      (rcInPsl ? ((mapTStrand == '-') ? '+' : '-') : mapTStrand),
+                      '\0'};
+    struct psl* mappedPsl = pslNew(inPsl->qName, inPsl->qSize, 0, 0,
+                                   mapPsl->tName, mapPsl->tSize, 0, 0,
+                                   strand, blocks.size(), 0);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        pslAddBlock(mappedPsl, blocks[i].qStart, blocks[i].tStart, blocks[i].size);
+    }
+    unsigned lastBlk = mappedPsl->blockCount - 1;
+    mappedPsl->qStart = mappedPsl->qStarts[0];
+    mappedPsl->qEnd = pslQEnd(mappedPsl, lastBlk);
+    if (strand[0] == '-') {
+        reverseIntRange(&mappedPsl->qStart, &mappedPsl->qEnd, mappedPsl->qSize);
+    }
+    mappedPsl->tStart = mappedPsl->tStarts[0];
+    mappedPsl->tEnd = pslTEnd(mappedPsl, lastBlk);
+    if (strand[1] == '-') {
+        reverseIntRange(&mappedPsl->tStart, &mappedPsl->tEnd, mappedPsl->tSize);
+    }
+    return mappedPsl;
+}
+
+/* Project the blocks of an input alignment, using the cache for blocks that
+ * have already been projected through the mapping alignment.  The search
+ * hint is only advanced by blocks that are projected, which is correct as
+ * it only increases. */
+void PslProjector::projectCachedBlocks(const struct psl* inPsl,
+                                       bool rcInPsl,
+                                       const struct psl* mapPsl,
+                                       unsigned mapAlnId,
+                                       ExonProjectionCache& cache,
+                                       BlockVector& blocks) {
+    unsigned iMapBlk = 0;
+    for (unsigned i = 0; (i < inPsl->blockCount) and (iMapBlk < mapPsl->blockCount); i++) {
+        unsigned iBlk = rcInPsl ? (inPsl->blockCount - 1) - i : i;
+        unsigned size = inPsl->blockSizes[iBlk];
+        unsigned qStart = inPsl->qStarts[iBlk];
+        unsigned tStart = inPsl->tStarts[iBlk];
+        if (rcInPsl) {
+            qStart = inPsl->qSize - (qStart + size);
+            tStart = inPsl->tSize - (tStart + size);
+        }
+        if (not cache.get(mapAlnId, rcInPsl, qStart, tStart, size, blocks)) {
+            size_t firstBlock = blocks.size();
+            iMapBlk = projectBlock(mapPsl, iMapBlk, qStart, tStart, size, blocks);
+            cache.add(mapAlnId, rcInPsl, qStart, tStart, size, blocks, firstBlock);
+        }
+    }
+}
+
+/* create the mapped psl from blocks projected in the orientation of the
+ * mapping query, or NULL if there are none */
+struct psl* PslProjector::finishProject(const struct psl* inPsl,
+                                        bool rcInPsl,
+                                        const struct psl* mapPsl,
+                                        BlockVector& blocks) {
+    if (blocks.size() == 0) {
+        return NULL;
+    }
+    if (rcInPsl) {
+        reverseBlocks(inPsl->qSize, mapPsl->tSize, blocks);
+    }
+    return makeMappedPsl(inPsl, rcInPsl, mapPsl, blocks);
+}
+
+/* Project an alignment through a mapping alignment. */
+struct psl* PslProjector::project(const struct psl* inPsl,
+                                  const struct psl* mapPsl,
+                                  BlockVector& blocks) {
+    bool rcInPsl = normStrand(inPsl->strand[1]) != normStrand(mapPsl->strand[0]);
+    blocks.clear();
+    projectBlocks(inPsl, rcInPsl, mapPsl, blocks);
+    return finishProject(inPsl, rcInPsl, mapPsl, blocks);
+}
+
+/* Project an alignment through a mapping alignment using a cache of block
+ * projections. */
+struct psl* PslProjector::project(const struct psl* inPsl,
+                                  const struct psl* mapPsl,
+                                  unsigned mapAlnId,
+                                  ExonProjectionCache& cache,
+                                  BlockVector& blocks) {
+    bool rcInPsl = normStrand(inPsl->strand[1]) != normStrand(mapPsl->strand[0]);
+    blocks.clear();
+    projectCachedBlocks(inPsl, rcInPsl, mapPsl, mapAlnId, cache, blocks);
+    return finishProject(inPsl, rcInPsl, mapPsl, blocks);
+}
+
+/* Project an alignment through an identity mapping alignment. */
+struct psl* PslProjector::projectIdentity(const struct psl* inPsl,
+                                          const struct psl* mapPsl,
+                                          BlockVector& blocks) {
+    bool rcInPsl = normStrand(inPsl->strand[1]) != normStrand(mapPsl->strand[0]);
+    blocks.clear();
+    for (unsigned iBlk = 0; iBlk < inPsl->blockCount; iBlk++) {
+        if (inPsl->blockSizes[iBlk] > 0) {
+            blocks.push_back(Block(inPsl->qStarts[iBlk], inPsl->tStarts[iBlk], inPsl->blockSizes[iBlk]));
+        }
+    }
+    if (blocks.size() == 0) {
+        return NULL;
+    }
+    return makeMappedPsl(inPsl, rcInPsl, mapPsl, blocks);
+}
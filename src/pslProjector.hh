@@ -0,0 +1,112 @@
+/*
+ * Projection of alignments through mapping alignments.
+ */
+#ifndef pslProjector_hh
+#define pslProjector_hh
+#include "jkinclude.hh"
+#include <vector>
+using namespace std;
+class ExonProjectionCache;
+
+/*
+ * Projects an alignment through a mapping alignment whose query is the
+ * target of the alignment (transmap).  This produces the same result as
+ * kent pslTransMap with pslTransMapKeepTrans for nucleotide alignments with
+ * an explicit target strand, followed by reverse-complementing the result
+ * if needed to keep the query strand of the input.  The strands are handled
+ * by transforming coordinates rather than reverse-complementing the
+ * alignments, and the first mapping block overlapping each input block is
+ * found with a galloping search, so long mapping alignments are not
+ * scanned block by block.
+ */
+class PslProjector {
+    public:
+    /* block of a projected alignment */
+    struct Block {
+        unsigned qStart;
+        unsigned tStart;
+        unsigned size;
+
+        Block(unsigned qStart,
+              unsigned tStart,
+              unsigned size):
+            qStart(qStart),
+            tStart(tStart),
+            size(size) {
+        }
+    };
+    typedef vector<Block> BlockVector;
+
+    private:
+    /* end of a mapping block in the mapping query */
+    static unsigned mapQEnd(const struct psl* mapPsl,
+                            unsigned iBlk) {
+        return mapPsl->qStarts[iBlk] + mapPsl->blockSizes[iBlk];
+    }
+    static unsigned findMapBlock(const struct psl* mapPsl,
+                                 unsigned iStart,
+                                 unsigned pos);
+    static unsigned projectBlock(const struct psl* mapPsl,
+                                 unsigned iMapBlk,
+                                 unsigned qStart,
+                                 unsigned tStart,
+                                 unsigned size,
+                                 BlockVector& blocks);
+    static void projectBlocks(const struct psl* inPsl,
+                              bool rcInPsl,
+                              const struct psl* mapPsl,
+                              BlockVector& blocks);
+    static void projectCachedBlocks(const struct psl* inPsl,
+                                    bool rcInPsl,
+                                    const struct psl* mapPsl,
+                                    unsigned mapAlnId,
+                                    ExonProjectionCache& cache,
+                                    BlockVector& blocks);
+    static void reverseBlocks(unsigned qSize,
+                              unsigned tSize,
+                              BlockVector& blocks);
+    static struct psl* makeMappedPsl(const struct psl* inPsl,
+                                     bool rcInPsl,
+                                     const struct psl* mapPsl,
+                                     const BlockVector& blocks);
+    static struct psl* finishProject(const struct psl* inPsl,
+                                     bool rcInPsl,
+                                     const struct psl* mapPsl,
+                                     BlockVector& blocks);
+
+    public:
+    /* Project an alignment through a mapping alignment, returning a new
+     * psl, or NULL if no part of it projects.  The sequence sizes must have
+     * been checked.  Blocks are collected in a buffer supplied by the
+     * caller, so it can be reused between calls. */
+    static struct psl* project(const struct psl* inPsl,
+                               const struct psl* mapPsl,
+                               BlockVector& blocks);
+
+    /* Project an alignment, with the projections of its blocks through the
+     * mapping alignment looked up in, or saved to, a cache.  mapAlnId
+     * identifies the mapping alignment in the cache.  The result is the
+     * same as project. */
+    static struct psl* project(const struct psl* inPsl,
+                               const struct psl* mapPsl,
+                               unsigned mapAlnId,
+                               ExonProjectionCache& cache,
+                               BlockVector& blocks);
+
+    /* Project an alignment through an identity mapping alignment, a single
+     * block covering all of both sequences, so the blocks are copied
+     * unchanged.  The result is the same as project. */
+    static struct psl* projectIdentity(const struct psl* inPsl,
+                                       const struct psl* mapPsl,
+                                       BlockVector& blocks);
+
+    /* is a mapping alignment an identity alignment? */
+    static bool isIdentity(const struct psl* mapPsl) {
+        return (mapPsl->blockCount == 1) and (mapPsl->qSize == mapPsl->tSize)
+            and (mapPsl->qStarts[0] == 0) and (mapPsl->tStarts[0] == 0)
+            and (mapPsl->blockSizes[0] == mapPsl->qSize)
+            and (mapPsl->strand[0] == '+') and (mapPsl->strand[1] != '-');
+    }
+};
+
+#endif
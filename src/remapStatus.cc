@@ -46,6 +46,23 @@ const string& remapStatusToStr(RemapStatus remapStatus) {
     return emptyString;
 }
 
+/* convert a string to a remap status  */
+RemapStatus strToRemapStatus(const string& str) {
+    static const RemapStatus remapStatuses[] = {
+        REMAP_STATUS_NONE, REMAP_STATUS_FULL_CONTIG, REMAP_STATUS_FULL_FRAGMENT,
+        REMAP_STATUS_PARTIAL, REMAP_STATUS_DELETED, REMAP_STATUS_NO_SEQ_MAP,
+        REMAP_STATUS_GENE_CONFLICT, REMAP_STATUS_GENE_SIZE_CHANGE,
+        REMAP_STATUS_AUTO_SMALL_NCRNA, REMAP_STATUS_AUTOMATIC_GENE,
+        REMAP_STATUS_PSEUDOGENE, REMAP_STATUS_INELIGIBLE
+    };
+    for (int i = 0; i < sizeof(remapStatuses)/sizeof(remapStatuses[0]); i++) {
+        if (remapStatusToStr(remapStatuses[i]) == str) {
+            return remapStatuses[i];
+        }
+    }
+    throw invalid_argument("unknown remap status: \"" + str + "\"");
+}
+
 /* target status strings */
 static const string TARGET_STATUS_NA_STR = "na";
 static const string TARGET_STATUS_NEW_STR = "new";
@@ -70,3 +87,17 @@ const string& targetStatusToStr(TargetStatus targetStatus) {
     }
     return emptyString;
 }
+
+/* convert a string to a target status  */
+TargetStatus strToTargetStatus(const string& str) {
+    static const TargetStatus targetStatuses[] = {
+        TARGET_STATUS_NA, TARGET_STATUS_NEW, TARGET_STATUS_LOST,
+        TARGET_STATUS_OVERLAP, TARGET_STATUS_NONOVERLAP
+    };
+    for (int i = 0; i < sizeof(targetStatuses)/sizeof(targetStatuses[0]); i++) {
+        if (targetStatusToStr(targetStatuses[i]) == str) {
+            return targetStatuses[i];
+        }
+    }
+    throw invalid_argument("unknown target status: \"" + str + "\"");
+}
@@ -26,6 +26,9 @@ typedef enum {
 /* Convert a remap status to a string  */
 const string& remapStatusToStr(RemapStatus remapStatus);
 
+/* Convert a string to a remap status  */
+RemapStatus strToRemapStatus(const string& str);
+
 
 /* target status */
 typedef enum {
@@ -39,5 +42,8 @@ typedef enum {
 /* convert a target status to a string  */
 const string& targetStatusToStr(TargetStatus targetStatus);
 
+/* convert a string to a target status  */
+TargetStatus strToTargetStatus(const string& str);
+
 #endif
 
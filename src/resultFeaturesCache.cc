@@ -0,0 +1,298 @@
+/*
+ * On-disk cache of per-gene transcript mapping results.
+ */
+#include "resultFeaturesCache.hh"
+#include "typeOps.hh"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <atomic>
+
+/* header identifying cache files, change version if format or mapping
+ * algorithm changes */
+static const string CACHE_FILE_HEADER = "#gencode-backmap-cache\t2";
+
+/* constructor, creates the directory if needed */
+ResultFeaturesCache::ResultFeaturesCache(const string& cacheDir):
+    fCacheDir(cacheDir) {
+    if ((mkdir(fCacheDir.c_str(), 0777) < 0) and (errno != EEXIST)) {
+        throw ios_base::failure("can't create cache directory \"" + fCacheDir + "\": " + strerror(errno));
+    }
+}
+
+/* get path to cache file for an entry */
+string ResultFeaturesCache::getEntryPath(HashVal key) const {
+    char keyStr[17];
+    snprintf(keyStr, sizeof(keyStr), "%016llx", static_cast<unsigned long long>(key));
+    return fCacheDir + "/" + keyStr + ".rfc";
+}
+
+/* escape tabs, newlines, and backslashes */
+string ResultFeaturesCache::escape(const string& str) {
+    string escaped;
+    for (size_t i = 0; i < str.size(); i++) {
+        switch (str[i]) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                escaped += str[i];
+        }
+    }
+    return escaped;
+}
+
+/* undo escape() */
+string ResultFeaturesCache::unescape(const string& str) {
+    string unescaped;
+    for (size_t i = 0; i < str.size(); i++) {
+        if ((str[i] == '\\') and (i+1 < str.size())) {
+            i++;
+            unescaped += (str[i] == 't') ? '\t' : ((str[i] == 'n') ? '\n' : str[i]);
+        } else {
+            unescaped += str[i];
+        }
+    }
+    return unescaped;
+}
+
+/* write one feature as a row */
+void ResultFeaturesCache::writeFeature(ostream& fh,
+                                       const Feature* feature,
+                                       int depth) const {
+    fh << "node\t" << depth << "\t"
+       << remapStatusToStr(feature->getRemapStatus()) << "\t"
+       << targetStatusToStr(feature->getTargetStatus()) << "\t"
+       << feature->getNumMappings() << "\t"
+       << escape(feature->getSeqid()) << "\t"
+       << escape(feature->getSource()) << "\t"
+       << escape(feature->getType()) << "\t"
+       << feature->getStart() << "\t"
+       << feature->getEnd() << "\t"
+       << escape(feature->getScore()) << "\t"
+       << escape(feature->getStrand()) << "\t"
+       << escape(feature->getPhase()) << "\t"
+       << feature->getAttrs().size();
+    for (size_t i = 0; i < feature->getAttrs().size(); i++) {
+        const AttrVal* attr = feature->getAttrs()[i];
+        fh << "\t" << escape(attr->getName()) << "\t" << attr->getVals().size();
+        for (size_t j = 0; j < attr->getVals().size(); j++) {
+            fh << "\t" << escape(attr->getVal(j));
+        }
+    }
+    fh << endl;
+    for (size_t i = 0; i < feature->getChildren().size(); i++) {
+        writeFeature(fh, feature->getChild(i), depth+1);
+    }
+}
+
+/* count the features in a tree */
+int ResultFeaturesCache::countFeatures(const Feature* root) const {
+    int count = 1;
+    for (size_t i = 0; i < root->getChildren().size(); i++) {
+        count += countFeatures(root->getChild(i));
+    }
+    return count;
+}
+
+/* write a possibly NULL tree, preceded by a label row with number of
+ * features */
+void ResultFeaturesCache::writeTree(ostream& fh,
+                                    const string& label,
+                                    const Feature* root) const {
+    fh << label << "\t" << ((root == NULL) ? 0 : countFeatures(root)) << endl;
+    if (root != NULL) {
+        writeFeature(fh, root, 0);
+    }
+}
+
+/* read and split a row */
+StringVector ResultFeaturesCache::readRow(istream& fh,
+                                          const string& entryPath) const {
+    string line;
+    if (not getline(fh, line)) {
+        throw invalid_argument("unexpected EOF in cache file: " + entryPath);
+    }
+    return stringSplit(line, '\t');
+}
+
+/* parse a feature row, returning depth */
+Feature* ResultFeaturesCache::parseFeature(const StringVector& row,
+                                           int& depth) const {
+    depth = stringToInt(row[1]);
+    // parse everything that can fail before creating the feature
+    RemapStatus remapStatus = strToRemapStatus(row[2]);
+    TargetStatus targetStatus = strToTargetStatus(row[3]);
+    int numMappings = stringToInt(row[4]);
+    int start = stringToInt(row[8]);
+    int end = stringToInt(row[9]);
+    AttrVals attrs;
+    int iCol = 14;
+    int numAttrs = stringToInt(row[13]);
+    for (int iAttr = 0; iAttr < numAttrs; iAttr++) {
+        int numVals = stringToInt(row.at(iCol+1));
+        StringVector vals;
+        for (int iVal = 0; iVal < numVals; iVal++) {
+            vals.push_back(unescape(row.at(iCol+2+iVal)));
+        }
+        attrs.add(new AttrVal(unescape(row.at(iCol)), vals));
+        iCol += 2 + numVals;
+    }
+    Feature* feature = featureFactory(unescape(row[5]), unescape(row[6]), unescape(row[7]),
+                                      start, end, unescape(row[10]),
+                                      unescape(row[11]), unescape(row[12]), attrs);
+    feature->setRemapStatus(remapStatus);
+    feature->setTargetStatus(targetStatus);
+    feature->setNumMappings(numMappings);
+    return feature;
+}
+
+/* get the row identifying the source gene of an entry: the gene id followed
+ * by the transcript ids, which include the versions */
+StringVector ResultFeaturesCache::getSrcIds(const Feature* srcGene) {
+    StringVector srcIds;
+    srcIds.push_back("gene");
+    srcIds.push_back(escape(srcGene->getTypeId()));
+    for (size_t i = 0; i < srcGene->getChildren().size(); i++) {
+        srcIds.push_back(escape(srcGene->getChild(i)->getTypeId()));
+    }
+    return srcIds;
+}
+
+/* read a possibly NULL tree, a partially read tree is freed on error */
+Feature* ResultFeaturesCache::readTree(istream& fh,
+                                       const string& label,
+                                       const string& entryPath) const {
+    StringVector row = readRow(fh, entryPath);
+    if ((row.size() != 2) or (row[0] != label)) {
+        throw invalid_argument("expected " + label + " row in cache file: " + entryPath);
+    }
+    int numFeatures = stringToInt(row[1]);
+    Feature* root = NULL;
+    FeatureVector parents;  // stack indexed by depth
+    try {
+        for (int i = 0; i < numFeatures; i++) {
+            row = readRow(fh, entryPath);
+            if ((row.size() < 14) or (row[0] != "node")) {
+                throw invalid_argument("invalid node row in cache file: " + entryPath);
+            }
+            int depth;
+            Feature* feature = parseFeature(row, depth);
+            if ((depth == 0) and (root == NULL)) {
+                root = feature;
+            } else if ((depth > 0) and (depth <= parents.size())) {
+                parents[depth-1]->addChild(feature);
+            } else {
+                delete feature;
+                throw invalid_argument("invalid node depth in cache file: " + entryPath);
+            }
+            parents.resize(depth);
+            parents.push_back(feature);
+        }
+    } catch (...) {
+        delete root;
+        throw;
+    }
+    return root;
+}
+
+/* Load the transcript results for a gene if they are in the cache. */
+bool ResultFeaturesCache::load(HashVal key,
+                               const Feature* srcGene,
+                               ResultFeaturesVector& mappedTranscripts,
+                               string& transcriptPsls) const {
+    string entryPath = getEntryPath(key);
+    ifstream fh(entryPath.c_str());
+    if (not fh.is_open()) {
+        return false;
+    }
+    string line;
+    if ((not getline(fh, line)) or (line != CACHE_FILE_HEADER)) {
+        return false;  // different version, will be replaced
+    }
+    size_t numPrevTranscripts = mappedTranscripts.size();
+    try {
+        if (readRow(fh, entryPath) != getSrcIds(srcGene)) {
+            return false;  // key collision with another gene, will be replaced
+        }
+        readEntry(fh, entryPath, srcGene, mappedTranscripts, transcriptPsls);
+    } catch (const exception& ex) {
+        for (size_t i = numPrevTranscripts; i < mappedTranscripts.size(); i++) {
+            mappedTranscripts[i].free();
+        }
+        mappedTranscripts.resize(numPrevTranscripts);
+        transcriptPsls.clear();
+        cerr << "Warning: ignoring invalid result cache entry: " << ex.what() << endl;
+        return false;
+    }
+    return true;
+}
+
+/* read the body of an entry following the source ids row.  Results are
+ * added to mappedTranscripts as they are read, so they can be freed by
+ * the caller on error. */
+void ResultFeaturesCache::readEntry(istream& fh,
+                                    const string& entryPath,
+                                    const Feature* srcGene,
+                                    ResultFeaturesVector& mappedTranscripts,
+                                    string& transcriptPsls) const {
+    StringVector row = readRow(fh, entryPath);
+    if ((row.size() != 2) or (row[0] != "psl")) {
+        throw invalid_argument("expected psl row in cache file: " + entryPath);
+    }
+    transcriptPsls = unescape(row[1]);
+    for (size_t i = 0; i < srcGene->getChildren().size(); i++) {
+        mappedTranscripts.push_back(ResultFeatures(srcGene->getChild(i), readTree(fh, "mapped", entryPath)));
+        mappedTranscripts.back().unmapped = readTree(fh, "unmapped", entryPath);
+    }
+    string line;
+    if ((not getline(fh, line)) or (line != "end")) {
+        throw invalid_argument("expected end row in cache file: " + entryPath);
+    }
+}
+
+/* sequence number for temporary file names, so threads in a process
+ * saving the same entry don't collide */
+static atomic<unsigned> gTmpFileSeq(0);
+
+/* save the transcript results for a gene.  Written to a temporary file and
+ * renamed so concurrent runs or threads don't see partial entries. */
+void ResultFeaturesCache::save(HashVal key,
+                               const Feature* srcGene,
+                               const ResultFeaturesVector& mappedTranscripts,
+                               const string& transcriptPsls) const {
+    string entryPath = getEntryPath(key);
+    string tmpPath = entryPath + "." + toString(getpid()) + "." + toString(int(gTmpFileSeq++)) + ".tmp";
+    {
+        ofstream fh(tmpPath.c_str());
+        if (not fh.is_open()) {
+            throw ios_base::failure("can't open \"" + tmpPath + "\" for write access");
+        }
+        fh << CACHE_FILE_HEADER << endl;
+        fh << stringJoin(getSrcIds(srcGene), '\t') << endl;
+        fh << "psl\t" << escape(transcriptPsls) << endl;
+        for (size_t i = 0; i < mappedTranscripts.size(); i++) {
+            writeTree(fh, "mapped", mappedTranscripts[i].mapped);
+            writeTree(fh, "unmapped", mappedTranscripts[i].unmapped);
+        }
+        fh << "end" << endl;
+        if (not fh.good()) {
+            throw ios_base::failure("I/O error on " + tmpPath);
+        }
+    }
+    if (rename(tmpPath.c_str(), entryPath.c_str()) < 0) {
+        throw ios_base::failure("can't rename \"" + tmpPath + "\" to \"" + entryPath + "\": " + strerror(errno));
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * On-disk cache of per-gene transcript mapping results.
+ */
+#ifndef resultFeaturesCache_hh
+#define resultFeaturesCache_hh
+#include "resultFeatures.hh"
+#include "hashOps.hh"
+#include <iostream>
+
+/*
+ * Cache of the ResultFeatures of the transcripts of a source gene, before
+ * gene-level decisions are made.  Entries are stored as files in a directory,
+ * named by a key that must be a hash of all of the inputs that affect the
+ * transcript mappings.  The transcript PSLs are saved with the results so
+ * they can be reproduced.  The ids of the source gene and transcripts are
+ * saved and checked on load, so a key collision is a miss rather than
+ * returning the results of another gene.
+ */
+class ResultFeaturesCache {
+    private:
+    const string fCacheDir;
+
+    string getEntryPath(HashVal key) const;
+    static string escape(const string& str);
+    static string unescape(const string& str);
+    void writeFeature(ostream& fh,
+                      const Feature* feature,
+                      int depth) const;
+    int countFeatures(const Feature* root) const;
+    void writeTree(ostream& fh,
+                   const string& label,
+                   const Feature* root) const;
+    Feature* parseFeature(const StringVector& row,
+                          int& depth) const;
+    Feature* readTree(istream& fh,
+                      const string& label,
+                      const string& entryPath) const;
+    StringVector readRow(istream& fh,
+                         const string& entryPath) const;
+    void readEntry(istream& fh,
+                   const string& entryPath,
+                   const Feature* srcGene,
+                   ResultFeaturesVector& mappedTranscripts,
+                   string& transcriptPsls) const;
+    static StringVector getSrcIds(const Feature* srcGene);
+
+    public:
+    /* constructor, creates the directory if needed */
+    ResultFeaturesCache(const string& cacheDir);
+
+    /* Load the transcript results for a gene if they are in the cache.
+     * Returns false if not cached, the entry is for a different gene, or the
+     * entry can't be parsed, in which case a warning is printed.  An invalid
+     * entry is replaced when the results are saved. */
+    bool load(HashVal key,
+              const Feature* srcGene,
+              ResultFeaturesVector& mappedTranscripts,
+              string& transcriptPsls) const;
+
+    /* save the transcript results for a gene */
+    void save(HashVal key,
+              const Feature* srcGene,
+              const ResultFeaturesVector& mappedTranscripts,
+              const string& transcriptPsls) const;
+};
+
+#endif
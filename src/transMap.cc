@@ -4,7 +4,11 @@
 #include "transMap.hh"
 #include "jkinclude.hh"
 #include "typeOps.hh"
+#include "FIOStream.hh"
 #include <iostream>
+#include <string.h>
+#include <thread>
+#include <exception>
 
 /* slCat that reverses parameter order, as the first list in rangeTreeAddVal
  * mergeVals function tends to be larger in degenerate cases of a huge number
@@ -26,13 +30,55 @@ bool TransMap::isChainMappingAlign(const string& fileName) {
     
 }
 
-/* add a map align object to the genomeRangeTree */
-void TransMap::mapAlnsAdd(struct psl *mapPsl) {
-    genomeRangeTreeAddVal(fMapAlns, mapPsl->qName, mapPsl->qStart, mapPsl->qEnd, mapPsl, slCatReversed);
+/* add a copy of a mapping alignment to the store and the genomeRangeTree */
+void TransMap::mapAlnsAdd(const struct psl *mapPsl) {
+    MapAlnRef mapAlnRef = {NULL, fMapAlnStore.add(mapPsl)};
+    fMapAlnRefs.push_back(mapAlnRef);
+    genomeRangeTreeAddVal(fMapAlns, mapPsl->qName, mapPsl->qStart, mapPsl->qEnd, &fMapAlnRefs.back(), slCatReversed);
+    seqSizesAdd(mapPsl);
+}
+
+/* Record the sizes of the sequences of a mapping alignment.  This is also
+ * done for pruned alignments, so a sequence is still known to be in the
+ * mapping if all of its alignments were pruned. */
+void TransMap::seqSizesAdd(const struct psl *mapPsl) {
     fQuerySizes.add(mapPsl->qName, mapPsl->qSize);
     fTargetSizes.add(mapPsl->tName, mapPsl->tSize);
 }
 
+/* Build the index of mapping alignments once all have been added.  The
+ * range tree has merged overlapping alignments into disjoint ranges, which
+ * are copied to the index in position order, keeping the order of the
+ * alignments within each range.  Query sequences whose only alignment is
+ * an identity alignment, as with patch releases of an assembly, are
+ * recorded so they can be mapped without a lookup.  The range tree is then
+ * freed, as it is only used for loading. */
+void TransMap::buildMapAlnIndex() {
+    struct hashCookie seqCookie = hashFirst(fMapAlns->jkhash);
+    struct hashEl *seqEl;
+    vector<unsigned> rangeMapAlns;
+    struct psl mapPsl;
+    while ((seqEl = hashNext(&seqCookie)) != NULL) {
+        int rangeCount = 0;
+        for (struct range *rng = genomeRangeTreeList(fMapAlns, seqEl->name); rng != NULL; rng = rng->next) {
+            rangeMapAlns.clear();
+            for (const MapAlnRef *mapAlnRef = static_cast<const MapAlnRef*>(rng->val); mapAlnRef != NULL; mapAlnRef = mapAlnRef->next) {
+                rangeMapAlns.push_back(mapAlnRef->iAln);
+            }
+            fMapAlnIndex.addRange(seqEl->name, rng->start, rng->end, rangeMapAlns);
+            rangeCount++;
+        }
+        if ((rangeCount == 1) and (rangeMapAlns.size() == 1)) {
+            fMapAlnStore.getPsl(rangeMapAlns[0], &mapPsl);
+            if (PslProjector::isIdentity(&mapPsl)) {
+                fIdentityMapAlns[seqEl->name] = rangeMapAlns[0];
+            }
+        }
+    }
+    genomeRangeTreeFree(&fMapAlns);
+    fMapAlnRefs.clear();
+}
+
 /* convert a chain to a psl, ignoring match counts, etc */
 struct psl* TransMap::chainToPsl(struct chain *ch,
                                  bool swapMap) {
@@ -55,16 +101,144 @@ struct psl* TransMap::chainToPsl(struct chain *ch,
 
 /* read a chain file, convert to mapAln object and genomeRangeTree by query locations. */
 void TransMap::loadMapChains(const string& chainFile,
-                             bool swapMap) {
+                             bool swapMap,
+                             const MapAlnFilter* filter) {
     struct chain *ch;
     struct lineFile *chLf = lineFileOpen(toCharStr(chainFile), TRUE);
     while ((ch = chainRead(chLf)) != NULL) {
-        mapAlnsAdd(chainToPsl(ch, swapMap));
+        struct psl* mapPsl = chainToPsl(ch, swapMap);
+        if ((filter == NULL) or (filter->keepScore(ch->score) and filter->keepAlign(mapPsl))) {
+            mapAlnsAdd(mapPsl);
+        } else {
+            seqSizesAdd(mapPsl);
+        }
+        pslFree(&mapPsl);
+        chainFree(&ch);
+    }
+    lineFileClose(&chLf);
+}
+
+/* is the line starting at a position a chain header? */
+static bool isChainHeaderLine(const string& text,
+                              size_t lineStart) {
+    return (text.compare(lineStart, 6, "chain ") == 0)
+        or (text.compare(lineStart, 6, "chain\t") == 0);
+}
+
+/* Split chain text into about numChunks ranges, each starting with a chain
+ * header, except the first one.  Chunks are only split at a header preceded
+ * by a blank line, as written after each chain by chainWrite, so the newline
+ * of the blank line can be replaced by a string terminator without
+ * unterminating the last line of the chunk.  A file without blank lines
+ * results in fewer chunks.  Returns the offsets of the chunk boundaries,
+ * including zero and the end of the text. */
+static vector<size_t> splitAtChains(const string& text,
+                                    int numChunks) {
+    vector<size_t> bounds;
+    bounds.push_back(0);
+    for (int iChunk = 1; iChunk < numChunks; iChunk++) {
+        size_t pos = (text.size() * iChunk) / numChunks;
+        if (pos <= bounds.back()) {
+            continue;
+        }
+        // find next header line following a blank line
+        size_t blankLine = text.find("\n\n", pos - 1);
+        while ((blankLine != string::npos) and not isChainHeaderLine(text, blankLine + 2)) {
+            blankLine = text.find("\n\n", blankLine + 1);
+        }
+        if (blankLine == string::npos) {
+            break;
+        }
+        bounds.push_back(blankLine + 2);
+    }
+    bounds.push_back(text.size());
+    return bounds;
+}
+
+/* parse the chains in a chunk of a chain file, converting them to mapping
+ * PSLs.  The chunk is modified by lineFile. */
+void TransMap::loadChainChunk(const string& chainFile,
+                              char* chunk,
+                              bool swapMap,
+                              const MapAlnFilter* filter,
+                              ChainChunk& chainChunk) {
+    struct chain *ch;
+    struct lineFile *chLf = lineFileOnString(toCharStr(chainFile), TRUE, chunk);
+    while ((ch = chainRead(chLf)) != NULL) {
+        struct psl* mapPsl = chainToPsl(ch, swapMap);
+        if ((filter == NULL) or (filter->keepScore(ch->score) and filter->keepAlign(mapPsl))) {
+            chainChunk.mapPsls.push_back(mapPsl);
+        } else {
+            chainChunk.prunedQuerySizes.add(mapPsl->qName, mapPsl->qSize);
+            chainChunk.prunedTargetSizes.add(mapPsl->tName, mapPsl->tSize);
+            pslFree(&mapPsl);
+        }
         chainFree(&ch);
     }
     lineFileClose(&chLf);
 }
 
+/* Read a chain file into memory, split it at chain headers and parse the
+ * chunks in parallel.  The chunks are parsed in place, each terminated by
+ * overwriting the newline before the next chunk, so the file is only held in
+ * memory once.  The range tree is then built in a single pass in file order,
+ * as it shares an allocator between sequences and the order of alignments in
+ * merged ranges depends on the order they are added. */
+void TransMap::loadMapChainsParallel(const string& chainFile,
+                                     bool swapMap,
+                                     int numThreads,
+                                     const MapAlnFilter* filter) {
+    string text;
+    FIOStream(chainFile).readAll(text);
+    // lineFile expects the last line to be terminated
+    if ((text.size() > 0) and (text[text.size() - 1] != '\n')) {
+        text.push_back('\n');
+    }
+    vector<size_t> bounds = splitAtChains(text, numThreads);
+    for (size_t iChunk = 1; iChunk < bounds.size() - 1; iChunk++) {
+        text[bounds[iChunk] - 1] = '\0';  // newline of blank line
+    }
+    size_t numChunks = bounds.size() - 1;
+    vector<ChainChunk> chainChunks(numChunks);
+    vector<exception_ptr> errors(numChunks);
+    vector<std::thread> threads;
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        char* chunk = &(text[0]) + bounds[iChunk];
+        ChainChunk* chainChunk = &chainChunks[iChunk];
+        exception_ptr* error = &errors[iChunk];
+        threads.push_back(std::thread([=, &chainFile]() {
+            try {
+                loadChainChunk(chainFile, chunk, swapMap, filter, *chainChunk);
+            } catch (...) {
+                *error = current_exception();
+            }
+        }));
+    }
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        threads[iChunk].join();
+    }
+    exception_ptr error;
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        if ((error == NULL) and (errors[iChunk] != NULL)) {
+            error = errors[iChunk];
+        }
+    }
+    for (size_t iChunk = 0; iChunk < numChunks; iChunk++) {
+        PslVector& mapPsls = chainChunks[iChunk].mapPsls;
+        if (error == NULL) {
+            for (size_t i = 0; i < mapPsls.size(); i++) {
+                mapAlnsAdd(mapPsls[i]);
+            }
+            fQuerySizes.addAll(chainChunks[iChunk].prunedQuerySizes);
+            fTargetSizes.addAll(chainChunks[iChunk].prunedTargetSizes);
+        }
+        mapPsls.free();
+    }
+    if (error != NULL) {
+        rethrow_exception(error);
+    }
+}
+
 /* constructor */
 TransMap::TransMap():
     fMapAlns(genomeRangeTreeNew()) {
@@ -72,28 +246,48 @@ TransMap::TransMap():
 
 /* destructor */
 TransMap::~TransMap() {
-    struct hashCookie cookie = hashFirst(fMapAlns->jkhash);
-    struct hashEl* chromEl;
-    while ((chromEl = hashNext(&cookie)) != NULL) {
-        for (struct range* range = genomeRangeTreeList(fMapAlns, chromEl->name);
-             range != NULL; range = range->next) {
-            struct psl* head = static_cast<struct psl*>(range->val);
-            pslFreeList(&head);
-        }
+    if (fMapAlns != NULL) {
+        genomeRangeTreeFree(&fMapAlns);
     }
-    
-    genomeRangeTreeFree(&fMapAlns);
 }
 
+/* Get the indexes of the mapping alignments overlapping a range of a query
+ * sequence.  These are in the same order as a range tree query, which
+ * breaks ties between equally scored mappings. */
+void TransMap::getOverlappingMapAlns(const string& qName,
+                                     int qStart,
+                                     int qEnd,
+                                     vector<unsigned>& overMapAlns) const {
+    fMapAlnIndex.getOverlapping(qName, qStart, qEnd, overMapAlns);
+}
 
-
-/* map one pair of query and mapping PSL */
+/* map one pair of query and mapping PSL.  Input PSLs with an implicit
+ * target strand are mapped with kent pslTransMap, which has different
+ * strand rules for them. */
 void TransMap::mapPslPair(struct psl *inPsl,
                           struct psl *mapPsl,
+                          unsigned iMapAln,
+                          bool identity,
+                          ExonProjectionCache* exonProjectionCache,
+                          PslProjector::BlockVector& blocks,
                           PslVector& allMappedPsls) const {
     if (inPsl->tSize != mapPsl->qSize)
         errAbort(toCharStr("Error: inPsl %s tSize (%d) != mapping alignment %s qSize (%d) (perhaps you need to specify -swapMap?)"),
                  inPsl->tName, inPsl->tSize, mapPsl->qName, mapPsl->qSize);
+    if (inPsl->strand[1] != '\0') {
+        struct psl* mappedPsl;
+        if (identity) {
+            mappedPsl = PslProjector::projectIdentity(inPsl, mapPsl, blocks);
+        } else if (exonProjectionCache != NULL) {
+            mappedPsl = PslProjector::project(inPsl, mapPsl, iMapAln, *exonProjectionCache, blocks);
+        } else {
+            mappedPsl = PslProjector::project(inPsl, mapPsl, blocks);
+        }
+        if (mappedPsl != NULL) {
+            allMappedPsls.push_back(mappedPsl);
+        }
+        return;
+    }
     struct psl* mappedPsls = pslTransMap(pslTransMapKeepTrans, inPsl, mapPsl);
     struct psl* mappedPsl;
     while ((mappedPsl = static_cast<struct psl*>(slPopHead(&mappedPsls))) != NULL) {
@@ -105,44 +299,142 @@ void TransMap::mapPslPair(struct psl *inPsl,
 }
 
 /* Map a single input PSL and return a list of resulting mappings.  * Keep PSL
-in the same query order, even if it creates a `-' on the target. */
-PslVector TransMap::mapPsl(struct psl* inPsl) const {
+in the same query order, even if it creates a `-' on the target.  PSLs on a
+sequence with an identity alignment have their blocks copied. */
+PslVector TransMap::mapPsl(struct psl* inPsl,
+                           ExonProjectionCache* exonProjectionCache) const {
+    string qName(inPsl->tName);
+    vector<unsigned> overMapAlns;
+    unordered_map<string, unsigned>::const_iterator identityIt = fIdentityMapAlns.find(qName);
+    bool identity = (identityIt != fIdentityMapAlns.end());
+    if (identity) {
+        overMapAlns.push_back(identityIt->second);
+    } else {
+        getOverlappingMapAlns(qName, inPsl->tStart, inPsl->tEnd, overMapAlns);
+    }
     PslVector mappedPsls;
-    struct range *overMapAlns = genomeRangeTreeAllOverlapping(fMapAlns, inPsl->tName, inPsl->tStart, inPsl->tEnd);
-    for (struct range *overMapAln = overMapAlns; overMapAln != NULL; overMapAln = overMapAln->next) {
-        for (struct psl *overMapPsl = static_cast<struct psl*>(overMapAln->val); overMapPsl != NULL; overMapPsl = overMapPsl->next) {
-            mapPslPair(inPsl, overMapPsl, mappedPsls);
-        }
+    struct psl mapPsl;
+    PslProjector::BlockVector blocks;
+    for (int i = 0; i < overMapAlns.size(); i++) {
+        fMapAlnStore.getPsl(overMapAlns[i], &mapPsl);
+        mapPslPair(inPsl, &mapPsl, overMapAlns[i], identity, exonProjectionCache, blocks, mappedPsls);
     }
     return mappedPsls;
 }
 
+/* Count the mapping alignments overlapping a range of a query sequence. */
+int TransMap::countMapAlns(const string& qName,
+                           int qStart,
+                           int qEnd) const {
+    vector<unsigned> overMapAlns;
+    getOverlappingMapAlns(qName, qStart, qEnd, overMapAlns);
+    return overMapAlns.size();
+}
+
+/* fingerprint of the coordinates and blocks of a mapping alignment */
+HashVal TransMap::pslFingerprint(const struct psl* psl) {
+    HashVal hv = hashBytes(psl->strand, strlen(psl->strand));
+    hv = hashBytes(psl->qName, strlen(psl->qName), hv);
+    hv = hashInt(psl->qSize, hv);
+    hv = hashInt(psl->qStart, hv);
+    hv = hashInt(psl->qEnd, hv);
+    hv = hashBytes(psl->tName, strlen(psl->tName), hv);
+    hv = hashInt(psl->tSize, hv);
+    hv = hashInt(psl->tStart, hv);
+    hv = hashInt(psl->tEnd, hv);
+    hv = hashInt(psl->blockCount, hv);
+    for (unsigned iBlk = 0; iBlk < psl->blockCount; iBlk++) {
+        hv = hashInt(psl->qStarts[iBlk], hv);
+        hv = hashInt(psl->tStarts[iBlk], hv);
+        hv = hashInt(psl->blockSizes[iBlk], hv);
+    }
+    return hv;
+}
+
+/* Get a fingerprint of all mapping alignments overlapping a range of a query
+ * sequence.  Order-independent, as the range tree order is not defined. */
+HashVal TransMap::getMapAlnsFingerprint(const string& qName,
+                                        int qStart,
+                                        int qEnd) const {
+    vector<unsigned> overMapAlns;
+    getOverlappingMapAlns(qName, qStart, qEnd, overMapAlns);
+    HashVal sum = 0;
+    struct psl mapPsl;
+    for (int i = 0; i < overMapAlns.size(); i++) {
+        fMapAlnStore.getPsl(overMapAlns[i], &mapPsl);
+        sum += hashMix(pslFingerprint(&mapPsl));
+    }
+    return hashCombine(hashInt(overMapAlns.size()), sum);
+}
+
 /* factory from a chain file */
 TransMap* TransMap::factoryFromChainFile(const string& chainFile,
-                                         bool swapMap) {
+                                         bool swapMap,
+                                         int numThreads,
+                                         const MapAlnFilter* filter) {
     TransMap* transMap = new TransMap();
-    transMap->loadMapChains(chainFile, swapMap);
+    if (numThreads > 1) {
+        transMap->loadMapChainsParallel(chainFile, swapMap, numThreads, filter);
+    } else {
+        transMap->loadMapChains(chainFile, swapMap, filter);
+    }
+    transMap->buildMapAlnIndex();
     return transMap;
 }
 
 /* factory from a list of psls */
 TransMap* TransMap::factoryFromPsls(struct psl* psls,
-                                    bool swapMap) {
+                                    bool swapMap,
+                                    const MapAlnFilter* filter) {
     TransMap* transMap = new TransMap();
     for (struct psl* psl = psls; psl != NULL; psl = psl->next) {
-        struct psl* pslCp = pslClone(psl);
-        if (swapMap)
-            pslSwap(pslCp, FALSE);
-        transMap->mapAlnsAdd(pslCp);
+        struct psl* mapPsl = psl;
+        if (swapMap) {
+            mapPsl = pslClone(psl);
+            pslSwap(mapPsl, FALSE);
+        }
+        if ((filter == NULL) or filter->keepAlign(mapPsl)) {
+            transMap->mapAlnsAdd(mapPsl);
+        } else {
+            transMap->seqSizesAdd(mapPsl);
+        }
+        if (swapMap) {
+            pslFree(&mapPsl);
+        }
     }
+    transMap->buildMapAlnIndex();
     return transMap;
 }
     
+/* factory that composes two sets of mapping alignments */
+TransMap* TransMap::factoryFromComposed(const TransMap* transMap1,
+                                        const TransMap* transMap2) {
+    TransMap* transMap = new TransMap();
+    struct psl mapPsl;
+    for (unsigned iAln = 0; iAln < transMap1->fMapAlnStore.size(); iAln++) {
+        transMap1->fMapAlnStore.getPsl(iAln, &mapPsl);
+        mapPsl.strand[1] = normStrand(mapPsl.strand[1]);  // explicit target strand for mapping
+        PslVector composedPsls = transMap2->mapPsl(&mapPsl);
+        for (size_t i = 0; i < composedPsls.size(); i++) {
+            transMap->mapAlnsAdd(composedPsls[i]);
+        }
+        composedPsls.free();
+    }
+    transMap->buildMapAlnIndex();
+    // sequences that don't compose are still known, so features on them
+    // are reported as not mapping rather than not being in the mapping
+    for (GenomeSizeMap::const_iterator it = transMap1->fQuerySizes.begin(); it != transMap1->fQuerySizes.end(); it++) {
+        transMap->fQuerySizes.add(it->first, it->second);
+    }
+    return transMap;
+}
+
 /* factory from a psl file */
 TransMap* TransMap::factoryFromPslFile(const string& pslFile,
-                                       bool swapMap) {
+                                       bool swapMap,
+                                       const MapAlnFilter* filter) {
     struct psl* psls = pslLoadAll(toCharStr(pslFile));
-    TransMap* transMap = factoryFromPsls(psls, swapMap);
+    TransMap* transMap = factoryFromPsls(psls, swapMap, filter);
     pslFreeList(&psls);
     return transMap;
 }
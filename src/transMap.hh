@@ -6,8 +6,15 @@
 #include "jkinclude.hh"
 #include <string>
 #include <map>
+#include <unordered_map>
 #include "pslOps.hh"
+#include "hashOps.hh"
+#include "mapAlnStore.hh"
+#include "mapAlnIndex.hh"
+#include "pslProjector.hh"
+#include "mapAlnFilter.hh"
 using namespace std;
+class ExonProjectionCache;
 
 
 class GenomeSizeMap: public map<const string, int> {
@@ -29,6 +36,13 @@ class GenomeSizeMap: public map<const string, int> {
     int get(const string& name) const {
         return at(name);
     }
+
+    /* add sizes from another map that we don't have */
+    void addAll(const GenomeSizeMap& other) {
+        for (const_iterator it = other.begin(); it != other.end(); it++) {
+            add(it->first, it->second);
+        }
+    }
 };
 
 /*
@@ -36,20 +50,59 @@ class GenomeSizeMap: public map<const string, int> {
  */
 class TransMap {
     private:
-    struct genomeRangeTree* fMapAlns;  // mapping alingments
+    /* mapping alignments parsed from part of a chain file, and the sizes of
+     * the sequences of alignments that were pruned */
+    struct ChainChunk {
+        PslVector mapPsls;
+        GenomeSizeMap prunedQuerySizes;
+        GenomeSizeMap prunedTargetSizes;
+    };
+
+    /* range tree value, a list of indexes of alignments in the store */
+    struct MapAlnRef {
+        struct MapAlnRef* next;
+        unsigned iAln;
+    };
+
+    MapAlnStore fMapAlnStore;          // mapping alignments
+    deque<MapAlnRef> fMapAlnRefs;      // range tree values
+    struct genomeRangeTree* fMapAlns;  // groups mapping alignments while loading
+    MapAlnIndex fMapAlnIndex;          // index of mapping alignments by query
+    unordered_map<string, unsigned> fIdentityMapAlns;  // query sequences with only an identity alignment
 
     public:
     GenomeSizeMap fQuerySizes;   // query sequence sizes
     GenomeSizeMap fTargetSizes;  // target sequence sizes
    
     private:
-    void mapAlnsAdd(struct psl *mapPsl);
-    struct psl* chainToPsl(struct chain *ch,
-                           bool swapMap);
+    void mapAlnsAdd(const struct psl *mapPsl);
+    void seqSizesAdd(const struct psl *mapPsl);
+    void buildMapAlnIndex();
+    static struct psl* chainToPsl(struct chain *ch,
+                                  bool swapMap);
     void loadMapChains(const string& chainFile,
-                       bool swapMap);
+                       bool swapMap,
+                       const MapAlnFilter* filter);
+    static void loadChainChunk(const string& chainFile,
+                               char* chunk,
+                               bool swapMap,
+                               const MapAlnFilter* filter,
+                               ChainChunk& chainChunk);
+    void loadMapChainsParallel(const string& chainFile,
+                               bool swapMap,
+                               int numThreads,
+                               const MapAlnFilter* filter);
+    void getOverlappingMapAlns(const string& qName,
+                               int qStart,
+                               int qEnd,
+                               vector<unsigned>& overMapAlns) const;
+    static HashVal pslFingerprint(const struct psl* psl);
     void mapPslPair(struct psl *inPsl,
                     struct psl *mapPsl,
+                    unsigned iMapAln,
+                    bool identity,
+                    ExonProjectionCache* exonProjectionCache,
+                    PslProjector::BlockVector& blocks,
                     PslVector& allMappedPsls) const;
 
     /* constructor */
@@ -59,23 +112,38 @@ class TransMap {
     /* is a mapping alignment file a chain or psl? */
     static bool isChainMappingAlign(const string& fileName);
 
-    /* factory from a chain file */
+    /* factory from a chain file.  If numThreads is greater than one, the
+     * chains are parsed in parallel.  If filter is not NULL, only chains it
+     * selects are kept, however the sizes of all sequences are recorded. */
     static TransMap* factoryFromChainFile(const string& chainFile,
-                                      bool swapMap);
-    /* factory from a list of psls */
+                                          bool swapMap,
+                                          int numThreads=1,
+                                          const MapAlnFilter* filter=NULL);
+    /* factory from a list of psls, optionally filtered */
     static TransMap* factoryFromPsls(struct psl* psls,
-                                     bool swapMap);
-    /* factory from a  psl file */
+                                     bool swapMap,
+                                     const MapAlnFilter* filter=NULL);
+    /* factory from a  psl file, optionally filtered */
     static TransMap* factoryFromPslFile(const string& pslFile,
-                                        bool swapMap);
+                                        bool swapMap,
+                                        const MapAlnFilter* filter=NULL);
     
+    /* factory that composes two sets of mapping alignments, where the
+     * target of the first is the query of the second.  The alignments of
+     * the first are mapped through the second, so features can be mapped
+     * through both in one step. */
+    static TransMap* factoryFromComposed(const TransMap* transMap1,
+                                         const TransMap* transMap2);
+
     /* factory from a chain or psl file */
     static TransMap* factoryFromFile(const string& fileName,
-                                     bool swapMap) {
+                                     bool swapMap,
+                                     int numThreads=1,
+                                     const MapAlnFilter* filter=NULL) {
         if (isChainMappingAlign(fileName)) {
-            return factoryFromChainFile(fileName, swapMap);
+            return factoryFromChainFile(fileName, swapMap, numThreads, filter);
         } else {
-            return factoryFromPslFile(fileName, swapMap);
+            return factoryFromPslFile(fileName, swapMap, filter);
         }
     }
     
@@ -103,8 +171,26 @@ class TransMap {
     }
     
     /* Map a single input PSL and return a list of resulting mappings.  Keep
-     * PSL in the same query order, even if it creates a `-' on the target. */
-    PslVector mapPsl(struct psl* inPsl) const;
+     * PSL in the same query order, even if it creates a `-' on the target.
+     * This may be called from multiple threads.  If exonProjectionCache is
+     * not NULL, the projections of the blocks are shared with other PSLs
+     * mapped with the same cache, which must only be used with this
+     * object. */
+    PslVector mapPsl(struct psl* inPsl,
+                     ExonProjectionCache* exonProjectionCache=NULL) const;
+
+    /* Count the mapping alignments overlapping a range of a query
+     * sequence. */
+    int countMapAlns(const string& qName,
+                     int qStart,
+                     int qEnd) const;
+
+    /* Get a fingerprint of the identity and contents of all mapping
+     * alignments overlapping a range of a query sequence.  Used to detect if
+     * the alignments used to map a feature have changed. */
+    HashVal getMapAlnsFingerprint(const string& qName,
+                                  int qStart,
+                                  int qEnd) const;
 };
 
 /* Vector of transmap objects.  Doesn't own them. */
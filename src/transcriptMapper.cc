@@ -22,11 +22,12 @@ FeatureVector TranscriptMapper::getExons(const Feature* transcript) {
 
 /* build transcript exons PSL to query and mapping to target genome.
  * Return NULL if no mappings for whatever reason.*/
-PslMapping* TranscriptMapper::allExonsTransMap(const Feature* transcript) const {
+PslMapping* TranscriptMapper::allExonsTransMap(const Feature* transcript,
+                                               ExonProjectionCache* exonProjectionCache) const {
     const string& qName(transcript->getAttr(GxfFeature::TRANSCRIPT_ID_ATTR)->getVal());
     FeatureVector exons = getExons(transcript);
     // get alignment of exons to srcGenome and to targetGenome
-    PslMapping* exonsMapping = FeatureTransMap(fGenomeTransMap).mapFeatures(qName, exons);
+    PslMapping* exonsMapping = FeatureTransMap(fGenomeTransMap, exonProjectionCache).mapFeatures(qName, exons);
     if (exonsMapping == NULL) {
         return NULL;  // source sequence not in map
     }
@@ -58,12 +59,19 @@ PslMapping* TranscriptMapper::featurePslMap(const Feature* feature) {
     return fViaExonsFeatureTransMap->mapFeature(featureId, feature);
 }
 
-/* map one feature, linking in a child feature. */
+/* map one feature, linking in a child feature.  Features inside a single
+ * block of the exon alignments are mapped directly; only those crossing a
+ * gap or block boundary are converted to a PSL and mapped via the exons. */
 TransMappedFeature TranscriptMapper::mapFeature(const Feature* feature) {
-    PslMapping* pslMapping = (fViaExonsFeatureTransMap != NULL) ? featurePslMap(feature) : NULL;
-    TransMappedFeature transMappedFeature = FeatureMapper::map(feature, pslMapping);
+    TransMappedFeature transMappedFeature(feature);
+    if ((fExonsMapping == NULL)
+        or not FeatureMapper::mapUngapped(feature, fExonsMapping->getSrcPsl(), fExonsMapping->getMappedPsl(),
+                                          transMappedFeature)) {
+        PslMapping* pslMapping = (fViaExonsFeatureTransMap != NULL) ? featurePslMap(feature) : NULL;
+        transMappedFeature = FeatureMapper::map(feature, pslMapping);
+        delete pslMapping;
+    }
     transMappedFeature.setRemapStatus(fSrcSeqInMapping);
-    delete pslMapping;
     return transMappedFeature;
 }
 
@@ -103,6 +111,7 @@ TranscriptMapper::TranscriptMapper(const TransMap* genomeTransMap,
                                    const Feature* transcript,
                                    const AnnotationSet* targetAnnotations,
                                    bool srcSeqInMapping,
+                                   ExonProjectionCache* exonProjectionCache,
                                    ostream* transcriptPslFh):
     fGenomeTransMap(genomeTransMap), 
     fSrcSeqInMapping(srcSeqInMapping),
@@ -122,7 +131,7 @@ TranscriptMapper::TranscriptMapper(const TransMap* genomeTransMap,
     }
 
     // map all exons together, this will be used to project the other exons
-    fExonsMapping = allExonsTransMap(transcript);
+    fExonsMapping = allExonsTransMap(transcript, exonProjectionCache);
     if (fExonsMapping != NULL) {
         if (transcriptPslFh != NULL) {
             fExonsMapping->writeMapped(*transcriptPslFh);
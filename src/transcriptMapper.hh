@@ -8,6 +8,7 @@ class PslMapping;
 class FeatureTransMap;
 class Feature;
 class AnnotationSet;
+class ExonProjectionCache;
 #include "feature.hh"
 #include "resultFeatures.hh"
 #include "transMap.hh"
@@ -34,7 +35,8 @@ class TranscriptMapper {
     static const bool debug = 0;
     
     static FeatureVector getExons(const Feature* transcript);
-    PslMapping* allExonsTransMap(const Feature* transcript) const;
+    PslMapping* allExonsTransMap(const Feature* transcript,
+                                 ExonProjectionCache* exonProjectionCache) const;
     static const TransMapVector makeViaExonsTransMap(const PslMapping* exonsMapping);
     PslMapping* featurePslMap(const Feature* feature);
     TransMappedFeature mapFeature(const Feature* feature);
@@ -42,11 +44,14 @@ class TranscriptMapper {
     ResultFeatures mapTranscriptFeature(const Feature* transcript);
 
     public:
-    /* constructor, targetAnnotations can be NULL */
+    /* constructor, targetAnnotations can be NULL.  If exonProjectionCache
+     * is not NULL, it holds exon projections through genomeTransMap shared
+     * with the other transcripts of the gene. */
     TranscriptMapper(const TransMap* genomeTransMap,
                      const Feature* transcript,
                      const AnnotationSet* targetAnnotations,
                      bool srcSeqInMapping,
+                     ExonProjectionCache* exonProjectionCache,
                      ostream* transcriptPslFh);
 
     /* destructor */
@@ -0,0 +1,155 @@
+/*
+ * Scheduling of work with skewed costs between threads.
+ */
+#ifndef workScheduler_hh
+#define workScheduler_hh
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+/*
+ * Schedules entries with an estimated cost to a fixed set of worker
+ * threads, so that expensive entries don't leave a long tail with one
+ * thread running.  Entries are added to a pending batch, which is limited
+ * in size.  When a worker runs out of work, the pending batch is
+ * distributed to the worker queues, heaviest first, each entry going to the
+ * worker with the lowest total cost (longest processing time first).
+ * Workers take their heaviest entry and a worker with an empty queue steals
+ * the heaviest entry from the worker with the highest remaining cost.
+ * Entries from a batch are all dispatched before the next batch, so an
+ * entry can't be starved by newer, heavier ones.  All queues are protected
+ * by a single mutex, as the entries are expected to be much more expensive
+ * than the locking.
+ */
+template<class T> class WorkScheduler {
+    private:
+    /* entry and cost */
+    struct CostEntry {
+        T entry;
+        long cost;
+
+        CostEntry(const T& entry,
+                  long cost):
+            entry(entry),
+            cost(cost) {
+        }
+
+        /* order with heaviest first */
+        bool operator<(const CostEntry& other) const {
+            return cost > other.cost;
+        }
+    };
+    typedef deque<CostEntry> CostEntryQueue;
+
+    size_t fMaxPending;
+    vector<CostEntry> fPending;            // batch being collected
+    vector<CostEntryQueue> fWorkerQueues;  // heaviest first
+    vector<long> fWorkerCosts;             // total cost in each queue
+    bool fClosed;
+    mutex fMutex;
+    condition_variable fNotFull;
+    condition_variable fHaveWork;
+
+    /* index of worker with the lowest total cost */
+    int leastLoadedWorker() const {
+        int best = 0;
+        for (int i = 1; i < fWorkerCosts.size(); i++) {
+            if (fWorkerCosts[i] < fWorkerCosts[best]) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    /* index of worker with the highest total cost that has entries, or -1 */
+    int mostLoadedWorker() const {
+        int best = -1;
+        for (int i = 0; i < fWorkerQueues.size(); i++) {
+            if ((fWorkerQueues[i].size() > 0)
+                and ((best < 0) or (fWorkerCosts[i] > fWorkerCosts[best]))) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    /* distribute the pending batch to the worker queues.  The stable sort
+     * keeps entries of equal cost in the order added. */
+    void distributeBatch() {
+        stable_sort(fPending.begin(), fPending.end());
+        for (size_t i = 0; i < fPending.size(); i++) {
+            int worker = leastLoadedWorker();
+            fWorkerQueues[worker].push_back(fPending[i]);
+            fWorkerCosts[worker] += fPending[i].cost;
+        }
+        fPending.clear();
+    }
+
+    /* take the heaviest entry from a worker's queue, or steal one from the
+     * most loaded worker if the queue is empty */
+    bool takeEntry(int worker,
+                   T& entry) {
+        int victim = (fWorkerQueues[worker].size() > 0) ? worker : mostLoadedWorker();
+        if (victim < 0) {
+            return false;
+        }
+        const CostEntry& costEntry = fWorkerQueues[victim].front();
+        entry = costEntry.entry;
+        fWorkerCosts[victim] -= costEntry.cost;
+        fWorkerQueues[victim].pop_front();
+        return true;
+    }
+
+    public:
+    /* constructor */
+    WorkScheduler(int numWorkers,
+                  size_t maxPending):
+        fMaxPending((maxPending < 1) ? 1 : maxPending),
+        fWorkerQueues((numWorkers < 1) ? 1 : numWorkers),
+        fWorkerCosts((numWorkers < 1) ? 1 : numWorkers, 0),
+        fClosed(false) {
+    }
+
+    /* add an entry with an estimated cost, waiting if the pending batch is
+     * full */
+    void push(const T& entry,
+              long cost) {
+        unique_lock<mutex> lock(fMutex);
+        fNotFull.wait(lock, [this]() {return fPending.size() < fMaxPending;});
+        fPending.push_back(CostEntry(entry, cost));
+        fHaveWork.notify_one();
+    }
+
+    /* get the next entry for a worker, waiting if there is no work.  Returns
+     * false when closed and all entries have been removed. */
+    bool pop(int worker,
+             T& entry) {
+        unique_lock<mutex> lock(fMutex);
+        while (true) {
+            if (takeEntry(worker, entry)) {
+                return true;
+            }
+            if (fPending.size() > 0) {
+                distributeBatch();
+                fNotFull.notify_all();
+                fHaveWork.notify_all();
+            } else if (fClosed) {
+                return false;
+            } else {
+                fHaveWork.wait(lock);
+            }
+        }
+    }
+
+    /* indicate that no more entries will be added */
+    void close() {
+        lock_guard<mutex> lock(fMutex);
+        fClosed = true;
+        fHaveWork.notify_all();
+    }
+};
+
+#endif